@@ -0,0 +1,293 @@
+/*** Benchmark harness for the generator.
+ ***
+ *** Reads problems in the manifest format of the generator (seed, problem
+ *** number, then the 13 generation parameters) and generates each of them at
+ *** every requested scale.  Generation and output are timed separately, and
+ *** each run is made in its own process so that its peak memory is its own.
+ *** One JSON object is printed per run and problem, one per line.
+ ***/
+
+/*** System Interfaces ***/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+/*** NETGEN Interfaces ***/
+#include "netgen.h"
+#include "dimacs.h"
+#include "batch.h"
+#include "index.h"
+
+/*** Local Constants ***/
+#define MAX_SCALES 16
+
+#define USAGE "Usage: ./bench [-s SCALE,...] [-r REPEATS] [-w THREADS] [-l tree|fenwick] [-d DIRECTORY] MANIFEST\n"
+
+/*** Type Definitions ***/
+typedef struct result {
+	long arcs;						/* arcs generated, or an error indicator  */
+	double generation;				/* seconds spent in netgen()              */
+	double output;					/* seconds spent writing the DIMACS file  */
+	long bytes;						/* size of the DIMACS file                */
+	long generation_rss;			/* peak resident set after generation, KB */
+	long peak_rss;					/* peak resident set of the run, KB       */
+} RESULT;
+
+typedef struct settings {
+	int threads;					/* threads formatting the output, 0 if serial */
+	int engine;						/* index engine, or zero for the default      */
+	const char* directory;			/* where the output files are written         */
+} SETTINGS;
+
+/*** Private Function Prototypes ***/
+static double now(void);
+static void scale_problem(BATCH_JOB*, long);
+static void run_problem(BATCH_JOB*, const SETTINGS*, RESULT*);
+static int measure(BATCH_JOB*, const SETTINGS*, RESULT*);
+static void print_result(BATCH_JOB*, long, const SETTINGS*, RESULT*);
+
+
+int
+main(int argc, char **argv)
+{
+	long scales[MAX_SCALES] = { 1 };
+	int scale_count = 1;
+	int repeats = 1;
+	SETTINGS settings = { 0, 0, "." };
+	BATCH_JOB problem, job;
+	RESULT best, result;
+	FILE* fin;
+	char* next;
+	int i, k, c, status;
+
+	while((c = getopt(argc, argv, "s:r:w:l:d:")) != -1) {
+		switch(c) {
+			case 's':
+				scale_count = 0;
+				next = optarg;
+				do {
+					if(scale_count == MAX_SCALES || (scales[scale_count++] = strtol(next, &next, 10)) <= 0 || (*next && *next != ',')) {
+						fprintf(stderr, USAGE);
+						return 1;
+					}
+				} while(*next++);
+				break;
+			case 'r':
+				repeats = atoi(optarg);
+				break;
+			case 'w':
+				settings.threads = atoi(optarg);
+				if(settings.threads <= 0) {
+					settings.threads = sysconf(_SC_NPROCESSORS_ONLN);
+				}
+				break;
+			case 'l':
+				if(!strcmp(optarg, "tree")) {
+					settings.engine = INDEX_TREE;
+				} else if(!strcmp(optarg, "fenwick")) {
+					settings.engine = INDEX_FENWICK;
+				} else {
+					fprintf(stderr, USAGE);
+					return 1;
+				}
+				break;
+			case 'd':
+				settings.directory = optarg;
+				break;
+			default:
+				fprintf(stderr, USAGE);
+				return 1;
+		}
+	}
+	if(optind != argc - 1 || repeats <= 0) {
+		fprintf(stderr, USAGE);
+		return 1;
+	}
+	if((fin = fopen(argv[optind], "r")) == NULL) {
+		perror(argv[optind]);
+		return 1;
+	}
+
+	while((status = read_problem(fin, &problem)) > 0) {
+		for(k = 0; k < scale_count; k++) {
+			/* keep the fastest of the repeated runs */
+			memset(&best, 0, sizeof(best));
+			for(i = 0; i < repeats; i++) {
+				job = problem;
+				scale_problem(&job, scales[k]);
+				if(measure(&job, &settings, &result)) {
+					fclose(fin);
+					return 1;
+				}
+				if(i == 0 || result.arcs < 0 || result.generation + result.output < best.generation + best.output) {
+					best = result;
+				}
+				if(result.arcs < 0) {
+					break;
+				}
+			}
+			print_result(&problem, scales[k], &settings, &best);
+		}
+	}
+	fclose(fin);
+
+	if(status < 0) {
+		fprintf(stderr, "%s: malformed manifest\n", argv[optind]);
+		return 1;
+	}
+	return 0;
+}
+
+
+/*** Wall clock time in seconds. ***/
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+/*** Scale a problem up: its node counts, arcs and supplies are multiplied,
+ *** its costs and capacities are kept.  Assignment problems stay assignment
+ *** problems since their supply grows with their sources.
+ ***/
+static void scale_problem(BATCH_JOB* job, long scale)
+{
+	long* parms = job->parms;
+
+	NODES *= scale;
+	SOURCES *= scale;
+	SINKS *= scale;
+	DENSITY *= scale;
+	SUPPLY *= scale;
+	TSOURCES *= scale;
+	TSINKS *= scale;
+}
+
+
+/*** Generate and write one problem, timing both steps.  Runs in the
+ *** child process of measure().
+ ***/
+static void run_problem(BATCH_JOB* job, const SETTINGS* settings, RESULT* result)
+{
+	NETGEN_CONTEXT* ctx;
+	struct rusage usage;
+	struct stat info;
+	char filename[4096];
+	FILE* fout;
+	double start;
+
+	memset(result, 0, sizeof(*result));
+	if((ctx = make_netgen_context()) == NULL) {
+		result->arcs = ALLOCATION_FAILURE;
+		return;
+	}
+	if(settings->engine) {
+		set_index_engine(ctx, settings->engine);
+	}
+
+	start = now();
+	result->arcs = netgen(ctx, job->seed, job->parms);
+	result->generation = now() - start;
+	getrusage(RUSAGE_SELF, &usage);
+	result->generation_rss = usage.ru_maxrss;
+	if(result->arcs < 0) {
+		free_netgen_context(ctx);
+		return;
+	}
+
+	snprintf(filename, sizeof(filename), "%s/bench.%ld.%d", settings->directory, job->problem, (int) getpid());
+	start = now();
+	if(settings->threads) {
+		if(write_dimacs_mapped(filename, ctx, job->seed, job->problem, settings->threads)) {
+			result->arcs = OUTPUT_FAILURE;
+		}
+	} else if((fout = fopen(filename, "w")) == NULL) {
+		result->arcs = OUTPUT_FAILURE;
+	} else {
+		if(write_dimacs(fout, ctx, job->seed, job->problem)) {
+			result->arcs = OUTPUT_FAILURE;
+		}
+		if(fclose(fout)) {
+			result->arcs = OUTPUT_FAILURE;
+		}
+	}
+	result->output = now() - start;
+	if(stat(filename, &info) == 0) {
+		result->bytes = info.st_size;
+	}
+	unlink(filename);
+
+	free_netgen_context(ctx);
+}
+
+
+/*** Run one problem in a child process.  Returns 0, or 1 if the child could
+ *** not be run; failures of the generator itself are left in the result.
+ ***/
+static int measure(BATCH_JOB* job, const SETTINGS* settings, RESULT* result)
+{
+	struct rusage usage;
+	int channel[2];
+	int received, status;
+	pid_t child;
+
+	if(pipe(channel)) {
+		perror("pipe");
+		return 1;
+	}
+	fflush(stdout);
+	if((child = fork()) < 0) {
+		perror("fork");
+		return 1;
+	}
+	if(child == 0) {
+		close(channel[0]);
+		run_problem(job, settings, result);
+		_exit(write(channel[1], result, sizeof(*result)) != sizeof(*result));
+	}
+
+	close(channel[1]);
+	received = read(channel[0], result, sizeof(*result)) == sizeof(*result);
+	close(channel[0]);
+	if(wait4(child, &status, 0, &usage) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) || !received) {
+		fprintf(stderr, "problem %ld: run failed\n", job->problem);
+		return 1;
+	}
+	result->peak_rss = usage.ru_maxrss;
+	return 0;
+}
+
+
+/*** Print the result of a problem as one JSON object. ***/
+static void print_result(BATCH_JOB* job, long scale, const SETTINGS* settings, RESULT* result)
+{
+	long* parms = job->parms;
+
+	printf("{\"problem\": %ld, \"scale\": %ld, \"nodes\": %ld, \"requested_arcs\": %ld, ",
+		job->problem, scale, NODES * scale, DENSITY * scale);
+	printf("\"engine\": \"%s\", \"output_threads\": %d, ",
+		settings->engine == INDEX_FENWICK ? "fenwick" : settings->engine == INDEX_TREE ? "tree" : "default",
+		settings->threads);
+	if(result->arcs < 0) {
+		printf("\"error\": %ld}\n", result->arcs);
+		return;
+	}
+	printf("\"arcs\": %ld, \"generation_seconds\": %.6f, \"arcs_per_second\": %.0f, \"generation_peak_rss_kb\": %ld, ",
+		result->arcs, result->generation,
+		result->generation > 0 ? result->arcs / result->generation : 0.0,
+		result->generation_rss);
+	printf("\"output_seconds\": %.6f, \"bytes\": %ld, \"bytes_per_second\": %.0f, \"peak_rss_kb\": %ld, ",
+		result->output, result->bytes,
+		result->output > 0 ? result->bytes / result->output : 0.0,
+		result->peak_rss);
+	printf("\"wall_seconds\": %.6f}\n", result->generation + result->output);
+}
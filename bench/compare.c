@@ -0,0 +1,495 @@
+/*** Differential check of a generator against a reference build.
+ ***
+ *** Draws random valid parameter vectors, runs the reference generator
+ *** once on each and the candidate once per output mode, and compares
+ *** hashes of the problem files.  Both are run as separate programs, fed
+ *** the problem on their standard input in the order of the prompts, in
+ *** a scratch directory, so that any two builds can be compared, down to
+ *** the original generator.  A problem the reference refuses, being over
+ *** its size limits, is checked against the candidate's plain output
+ *** instead, so that large problems still exercise the modes whose paths
+ *** only differ for large arrays, such as -p.
+ ***
+ *** The parameters are drawn from several families, so that the unusual
+ *** paths of the generator are taken regularly:
+ ***
+ ***	assignment   sources and sinks only, one unit of supply each
+ ***	sparse       fewer than two arcs per node, so pick_head adds nothing
+ ***	             for most tails
+ ***	moderate     a few arcs per node: the limits of pick_head come from
+ ***	             its rejection loop, the last one from the nodes_left == 0
+ ***	             case
+ ***	dense        up to a complete network, where the limit is the number
+ ***	             of candidate heads and pseudo_size runs below index_size
+ ***	             once transshipment sources and tails are removed from the
+ ***	             lists
+ ***
+ *** with small and large lists (either side of FLAG_LIMIT), networks with
+ *** no transshipment nodes, single sources or sinks, all sources or sinks
+ *** transshipment ones, and the extreme percentages and equal bounds of
+ *** costs and capacities.  Every mismatch is printed with the manifest line
+ *** of its problem, so it can be rerun by hand.
+ ***/
+
+/*** System Interfaces ***/
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <zlib.h>
+
+/*** NETGEN Interfaces ***/
+#include "netgen.h"
+
+/*** Local Constants ***/
+#define MODE_PLAIN		0		/* no flag                                  */
+#define MODE_STREAM		1		/* -s                                       */
+#define MODE_MAPPED		2		/* -w 2                                     */
+#define MODE_TREE		3		/* -l tree                                  */
+#define MODE_FENWICK	4		/* -l fenwick                               */
+#define MODE_SHARDS		5		/* -k 0/3 .. 2/3, files put end to end      */
+#define MODE_COMPACT	6		/* -c                                       */
+#define MODE_PIPELINE	7		/* -a 2 -u                                  */
+#define MODE_GZIP		8		/* -g 2, the decompressed stream            */
+#define MODE_SPILL		9		/* -o with the scratch directory            */
+#define MODE_PAGES		10		/* -p transparent                           */
+#define MODES			11
+
+#define SHARDS			3
+#define TIME_LIMIT		300		/* seconds a generator may run on a problem */
+#define FNV_OFFSET		0xcbf29ce484222325ULL
+#define FNV_PRIME		0x100000001b3ULL
+
+#define USAGE "Usage: ./compare [-n CASES] [-r SEED] [-N NODES] [-A ARCS] [-m MODE,...] [-d DIRECTORY] [-v] REFERENCE CANDIDATE\n"
+
+/*** Type Definitions ***/
+typedef struct outcome {
+	int ok;						/* 1 if a problem file was written          */
+	unsigned long long hash;	/* FNV-1a hash of the file                  */
+	long bytes;					/* and its length                           */
+} OUTCOME;
+
+/*** Private Data ***/
+static const char* mode_names[MODES] = { "plain", "stream", "mapped", "tree", "fenwick", "shards", "compact", "pipeline", "gzip", "spill", "pages" };
+
+/*** Private Function Prototypes ***/
+static void draw_problem(RANDOM*, long, long, long*);
+static long draw_log(RANDOM*, long, long);
+static int run_generator(const char*, const char*, long, long*, int, int, OUTCOME*);
+static void hash_file(const char*, OUTCOME*);
+static void hash_gzip(const char*, OUTCOME*);
+static void print_problem(FILE*, long, long, long*);
+
+
+int
+main(int argc, char **argv)
+{
+	long cases = 200, max_nodes = 2000, max_arcs = 100000;
+	long seed = 13502460;
+	int modes[MODES] = { 1, 1, 1, 0, 1, 1, 1, 1, 1, 1, 1 };
+	int verbose = 0;
+	char directory[PATH_MAX] = "";
+	char reference[PATH_MAX], candidate[PATH_MAX];
+	char* name;
+	RANDOM random;
+	long parms[PROBLEM_PARMS];
+	long problem_seed, c;
+	long runs = 0, mismatches = 0, skipped = 0, selfs = 0;
+	OUTCOME expected, got;
+	int m, opt, self;
+
+	while((opt = getopt(argc, argv, "n:r:N:A:m:d:v")) != -1) {
+		switch(opt) {
+			case 'n':
+				cases = atol(optarg);
+				break;
+			case 'r':
+				seed = atol(optarg);
+				break;
+			case 'N':
+				max_nodes = atol(optarg);
+				break;
+			case 'A':
+				max_arcs = atol(optarg);
+				break;
+			case 'm':
+				memset(modes, 0, sizeof(modes));
+				for(name = strtok(optarg, ","); name; name = strtok(NULL, ",")) {
+					for(m = 0; m < MODES && strcmp(name, mode_names[m]); m++)
+						;
+					if(m == MODES) {
+						fprintf(stderr, USAGE);
+						return 2;
+					}
+					modes[m] = 1;
+				}
+				break;
+			case 'd':
+				snprintf(directory, sizeof(directory), "%s", optarg);
+				break;
+			case 'v':
+				verbose = 1;
+				break;
+			default:
+				fprintf(stderr, USAGE);
+				return 2;
+		}
+	}
+	if(argc - optind != 2 || seed <= 0 || max_nodes < 4 || max_arcs < max_nodes) {
+		fprintf(stderr, USAGE);
+		return 2;
+	}
+	if(realpath(argv[optind], reference) == NULL || realpath(argv[optind + 1], candidate) == NULL) {
+		perror("generator");
+		return 2;
+	}
+	if(directory[0] == '\0') {
+		snprintf(directory, sizeof(directory), "%s/netgen-compare.XXXXXX", getenv("TMPDIR") ? getenv("TMPDIR") : "/tmp");
+		if(mkdtemp(directory) == NULL) {
+			perror(directory);
+			return 2;
+		}
+	}
+
+	set_randomi(&random, seed);
+	for(c = 1; c <= cases; c++) {
+		problem_seed = randomi(&random, 1L, MODULUS - 1);
+		draw_problem(&random, max_nodes, max_arcs, parms);
+
+		/* The reference may reject or fail on the problem, being limited
+		 * to smaller ones: the candidate's other modes are then compared
+		 * with its plain output.
+		 */
+		self = 0;
+		if(run_generator(reference, directory, problem_seed, parms, MODE_PLAIN, 0, &expected) || !expected.ok) {
+			skipped++;
+			if(run_generator(candidate, directory, problem_seed, parms, MODE_PLAIN, 1, &expected) || !expected.ok) {
+				if(verbose) {
+					printf("skipped       ");
+					print_problem(stdout, problem_seed, c, parms);
+				}
+				continue;
+			}
+			self = 1;
+			selfs++;
+		}
+		for(m = 0; m < MODES; m++) {
+			if(!modes[m] || (self && m == MODE_PLAIN)) {
+				continue;
+			}
+			runs++;
+			if(run_generator(candidate, directory, problem_seed, parms, m, 1, &got) ||
+			   !got.ok || got.hash != expected.hash || got.bytes != expected.bytes) {
+				mismatches++;
+				printf("MISMATCH %-8s", mode_names[m]);
+				print_problem(stdout, problem_seed, c, parms);
+			} else if(verbose) {
+				printf("ok       %-8s", mode_names[m]);
+				print_problem(stdout, problem_seed, c, parms);
+			}
+		}
+		fflush(stdout);
+	}
+	rmdir(directory);
+
+	printf("%ld problems, %ld runs compared, %ld mismatches, %ld skipped by the reference, %ld of them compared with the plain candidate\n",
+		cases, runs, mismatches, skipped, selfs);
+	return mismatches ? 1 : 0;
+}
+
+
+/*** Draw a valid parameter vector, from one of the families described at
+ *** the top of this file.
+ ***/
+static void draw_problem(RANDOM* random, long max_nodes, long max_arcs, long* parms)
+{
+	long non_sources, most;
+
+	memset(parms, 0, PROBLEM_PARMS * sizeof(long));
+
+	/* lists of up to a few hundred indices are kept in the small representation */
+	NODES = randomi(random, 1L, 4L) == 1 ? randomi(random, 4L, 300L) : randomi(random, 4L, max_nodes);
+
+	if(randomi(random, 1L, 6L) == 1) {	/* assignment */
+		NODES &= ~1L;
+		SOURCES = SINKS = SUPPLY = NODES / 2;
+		DENSITY = randomi(random, NODES, NODES + SOURCES * SOURCES);
+	} else {
+		switch(randomi(random, 1L, 5L)) {
+			case 1:						/* no transshipment nodes */
+				SOURCES = randomi(random, 1L, NODES - 1);
+				SINKS = NODES - SOURCES;
+				break;
+			case 2:						/* a single source or sink */
+				SOURCES = randomi(random, 1L, 2L) == 1 ? 1 : randomi(random, 1L, NODES - 1);
+				SINKS = SOURCES == 1 ? randomi(random, 1L, NODES - 1) : 1;
+				break;
+			default:
+				SOURCES = randomi(random, 1L, NODES / 2);
+				SINKS = randomi(random, 1L, NODES - SOURCES);
+				break;
+		}
+		switch(randomi(random, 1L, 4L)) {
+			case 1:
+				TSOURCES = SOURCES;
+				TSINKS = SINKS;
+				break;
+			case 2:
+				TSOURCES = randomi(random, 0L, SOURCES);
+				TSINKS = randomi(random, 0L, SINKS);
+				break;
+			default:
+				break;
+		}
+
+		non_sources = NODES - SOURCES + TSOURCES;
+		most = NODES * non_sources;
+		switch(randomi(random, 1L, 4L)) {
+			case 1:						/* sparse */
+				DENSITY = randomi(random, NODES, 2 * NODES);
+				break;
+			case 2:						/* moderate */
+				DENSITY = randomi(random, 2 * NODES, 8 * NODES);
+				break;
+			case 3:						/* dense */
+				DENSITY = randomi(random, most / 2, most);
+				break;
+			default:
+				DENSITY = draw_log(random, NODES, most);
+				break;
+		}
+
+		SUPPLY = randomi(random, 1L, 3L) == 1 ? SOURCES : SOURCES * randomi(random, 1L, 1000L);
+	}
+	if(DENSITY > max_arcs) {
+		DENSITY = NODES > max_arcs ? NODES : max_arcs;
+	}
+
+	MINCOST = randomi(random, 0L, 100L);
+	MAXCOST = randomi(random, 1L, 4L) == 1 ? MINCOST : MINCOST + randomi(random, 0L, 10000L);
+	switch(randomi(random, 1L, 4L)) {
+		case 1:
+			HICOST = 0;
+			CAPACITATED = 100;
+			break;
+		case 2:
+			HICOST = 100;
+			CAPACITATED = 0;
+			break;
+		default:
+			HICOST = randomi(random, 0L, 100L);
+			CAPACITATED = randomi(random, 0L, 100L);
+			break;
+	}
+	MINCAP = randomi(random, 0L, 1000L);
+	MAXCAP = randomi(random, 1L, 4L) == 1 ? MINCAP : MINCAP + randomi(random, 0L, 100000L);
+}
+
+
+/*** A number between low and high, roughly uniform in its logarithm. ***/
+static long draw_log(RANDOM* random, long low, long high)
+{
+	long top = low;
+
+	while(top < high / 2 && randomi(random, 0L, 1L)) {
+		top *= 2;
+	}
+	return randomi(random, low, top < high ? top : high);
+}
+
+
+/*** Run a generator on a problem in the given mode, in the scratch
+ *** directory, and hash the file it writes.  Returns zero, or 1 if the
+ *** generator could not be run; a run that fails or writes no file is
+ *** reported as an outcome that is not ok.
+ ***/
+static int run_generator(const char* generator, const char* directory, long seed, long* parms, int mode, int flags, OUTCOME* outcome)
+{
+	char input[PATH_MAX + 32], output[PATH_MAX + 64], shard[16], threads[] = "2";
+	char* args[8];
+	FILE* fin;
+	pid_t child;
+	int status, k, count, fd, a;
+	unsigned long long hash = FNV_OFFSET;
+	long bytes = 0;
+
+	snprintf(input, sizeof(input), "%s/input", directory);
+	if((fin = fopen(input, "w")) == NULL) {
+		perror(input);
+		return 1;
+	}
+	print_problem(fin, seed, 1, parms);
+	fclose(fin);
+
+	count = mode == MODE_SHARDS ? SHARDS : 1;
+	outcome->ok = 1;
+	for(k = 0; k < count; k++) {
+		a = 0;
+		args[a++] = (char *)generator;
+		if(flags) {
+			switch(mode) {
+				case MODE_STREAM:
+					args[a++] = "-s";
+					break;
+				case MODE_MAPPED:
+					args[a++] = "-w";
+					args[a++] = threads;
+					break;
+				case MODE_TREE:
+					args[a++] = "-l";
+					args[a++] = "tree";
+					break;
+				case MODE_FENWICK:
+					args[a++] = "-l";
+					args[a++] = "fenwick";
+					break;
+				case MODE_SHARDS:
+					snprintf(shard, sizeof(shard), "%d/%d", k, SHARDS);
+					args[a++] = "-k";
+					args[a++] = shard;
+					break;
+				case MODE_COMPACT:
+					args[a++] = "-c";
+					break;
+				case MODE_PIPELINE:
+					args[a++] = "-a";
+					args[a++] = threads;
+					args[a++] = "-u";
+					break;
+				case MODE_GZIP:
+					args[a++] = "-g";
+					args[a++] = threads;
+					break;
+				case MODE_SPILL:		/* run from the scratch directory */
+					args[a++] = "-o";
+					args[a++] = ".";
+					break;
+				case MODE_PAGES:
+					args[a++] = "-p";
+					args[a++] = "transparent";
+					break;
+				default:
+					break;
+			}
+		}
+		args[a] = NULL;
+
+		if((child = fork()) < 0) {
+			perror("fork");
+			return 1;
+		}
+		if(child == 0) {
+			if(chdir(directory) || (fd = open(input, O_RDONLY)) < 0 || dup2(fd, 0) < 0) {
+				_exit(127);
+			}
+			close(fd);
+			alarm(TIME_LIMIT);
+			if((fd = open("/dev/null", O_WRONLY)) >= 0) {
+				dup2(fd, 1);
+				dup2(fd, 2);
+				close(fd);
+			}
+			execv(generator, args);
+			_exit(127);
+		}
+		if(waitpid(child, &status, 0) < 0) {
+			perror("waitpid");
+			return 1;
+		}
+		if(WIFEXITED(status) && WEXITSTATUS(status) == 127) {
+			fprintf(stderr, "%s: cannot be run\n", generator);
+			return 1;
+		}
+		if(!WIFEXITED(status) || WEXITSTATUS(status) != 0) {	/* a file may be left half written */
+			outcome->ok = 0;
+		}
+
+		if(mode == MODE_SHARDS && flags) {
+			snprintf(output, sizeof(output), "%s/1.%d", directory, k);
+		} else if(mode == MODE_GZIP && flags) {
+			snprintf(output, sizeof(output), "%s/1.gz", directory);
+		} else {
+			snprintf(output, sizeof(output), "%s/1", directory);
+		}
+		outcome->hash = hash;
+		outcome->bytes = bytes;
+		if(mode == MODE_GZIP && flags) {
+			hash_gzip(output, outcome);
+		} else {
+			hash_file(output, outcome);
+		}
+		hash = outcome->hash;
+		bytes = outcome->bytes;
+		unlink(output);
+	}
+	unlink(input);
+	return 0;
+}
+
+
+/*** Continue the hash of an outcome over a file.  The outcome is not ok
+ *** if the file cannot be read.
+ ***/
+static void hash_file(const char* filename, OUTCOME* outcome)
+{
+	unsigned char buffer[65536];
+	FILE* fin;
+	size_t n, i;
+
+	if((fin = fopen(filename, "r")) == NULL) {
+		outcome->ok = 0;
+		return;
+	}
+	while((n = fread(buffer, 1, sizeof(buffer), fin)) > 0) {
+		for(i = 0; i < n; i++) {
+			outcome->hash = (outcome->hash ^ buffer[i]) * FNV_PRIME;
+		}
+		outcome->bytes += (long)n;
+	}
+	fclose(fin);
+}
+
+
+/*** Continue the hash of an outcome over the decompressed contents of a
+ *** gzip file, all its members end to end.  The outcome is not ok if the
+ *** file cannot be read or is corrupt.
+ ***/
+static void hash_gzip(const char* filename, OUTCOME* outcome)
+{
+	unsigned char buffer[65536];
+	gzFile fin;
+	int n, i;
+
+	if((fin = gzopen(filename, "rb")) == NULL) {
+		outcome->ok = 0;
+		return;
+	}
+	while((n = gzread(fin, buffer, sizeof(buffer))) > 0) {
+		for(i = 0; i < n; i++) {
+			outcome->hash = (outcome->hash ^ buffer[i]) * FNV_PRIME;
+		}
+		outcome->bytes += (long)n;
+	}
+	if(n < 0) {
+		outcome->ok = 0;
+	}
+	gzclose(fin);
+}
+
+
+/*** Print a problem as a line of a manifest. ***/
+static void print_problem(FILE* fout, long seed, long problem, long* parms)
+{
+	int i;
+
+	fprintf(fout, "%ld %ld", seed, problem);
+	for(i = 0; i < PROBLEM_PARMS; i++) {
+		fprintf(fout, " %ld", parms[i]);
+	}
+	fprintf(fout, "\n");
+}
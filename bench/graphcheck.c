@@ -0,0 +1,278 @@
+/*** Check of the graphs build_graph and netgen_graph hand over.
+ ***
+ *** Draws random valid parameter vectors, generates each problem into a
+ *** context, and sorts it into a graph with one thread and with several.
+ *** Every graph must satisfy the invariants graph.h promises:
+ ***
+ ***	first_out  offsets from 0 to the number of arcs, never decreasing,
+ ***	           and tail[first_out[v]..first_out[v+1]-1] all v
+ ***	first_in   the same for in_arc, whose arcs into v all have head v,
+ ***	           each arc appearing once
+ ***	order      a permutation of the arcs, each graph arc being the arc
+ ***	           of the context at its place: same tail, head (numbered
+ ***	           from 1 there), cost and capacity
+ ***	           within each node, out and in arcs in generation order
+ ***	supply     the context's supplies
+ ***
+ *** and the graphs made with any number of threads, or by netgen_graph,
+ *** must be the same.  Each problem is drawn with enough arcs now and then
+ *** for build_graph to use all the threads asked for.  Every failure is
+ *** printed with the invariant broken and the manifest line of its
+ *** problem, so it can be rerun by hand.
+ ***/
+
+/*** System Interfaces ***/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/*** NETGEN Interfaces ***/
+#include "netgen.h"
+#include "graph.h"
+
+/*** Local Constants ***/
+#define THREAD_COUNTS	3		/* sorts compared, see thread_counts        */
+
+#define USAGE "Usage: ./graphcheck [-n CASES] [-r SEED] [-N NODES] [-A ARCS] [-c] [-v]\n"
+
+/*** Private Data ***/
+static const int thread_counts[THREAD_COUNTS] = { 1, 2, 4 };
+
+/*** Private Function Prototypes ***/
+static void draw_problem(RANDOM*, long, long, long*);
+static const char* check_graph(NETGEN_CONTEXT*, NETGEN_GRAPH*);
+static int same_graph(NETGEN_GRAPH*, NETGEN_GRAPH*);
+static void print_problem(FILE*, long, long, long*);
+
+
+int
+main(int argc, char **argv)
+{
+	long cases = 100, max_nodes = 20000, max_arcs = 600000;
+	long seed = 13502460;
+	int compact = 0, verbose = 0;
+	RANDOM random;
+	NETGEN_CONTEXT* ctx;
+	NETGEN_GRAPH* first;
+	NETGEN_GRAPH* graph;
+	long parms[PROBLEM_PARMS];
+	long problem_seed, c, arcs;
+	long checked = 0, failures = 0, skipped = 0;
+	const char* broken;
+	int t, opt;
+
+	while((opt = getopt(argc, argv, "n:r:N:A:cv")) != -1) {
+		switch(opt) {
+			case 'n':
+				cases = atol(optarg);
+				break;
+			case 'r':
+				seed = atol(optarg);
+				break;
+			case 'N':
+				max_nodes = atol(optarg);
+				break;
+			case 'A':
+				max_arcs = atol(optarg);
+				break;
+			case 'c':
+				compact = 1;
+				break;
+			case 'v':
+				verbose = 1;
+				break;
+			default:
+				fprintf(stderr, USAGE);
+				return 2;
+		}
+	}
+	if(argc != optind || seed <= 0 || max_nodes < 4 || max_arcs < max_nodes) {
+		fprintf(stderr, USAGE);
+		return 2;
+	}
+	if((ctx = make_netgen_context()) == NULL) {
+		fprintf(stderr, "Unable to allocate a generator context.\n");
+		return 2;
+	}
+	set_compact_storage(ctx, compact);
+
+	set_randomi(&random, seed);
+	for(c = 1; c <= cases; c++) {
+		problem_seed = randomi(&random, 1L, MODULUS - 1);
+		draw_problem(&random, max_nodes, max_arcs, parms);
+
+		if((arcs = netgen(ctx, problem_seed, parms)) < 0) {
+			/* rejected or too large: nothing to check */
+			skipped++;
+			continue;
+		}
+
+		first = NULL;
+		broken = NULL;
+		for(t = 0; t < THREAD_COUNTS && broken == NULL; t++) {
+			if((arcs = build_graph(ctx, thread_counts[t], &graph)) < 0) {
+				broken = error_message(arcs);
+			} else if((broken = check_graph(ctx, graph)) == NULL && first != NULL && !same_graph(first, graph)) {
+				broken = "graphs differ with the number of threads";
+			}
+			if(first == NULL) {
+				first = graph;
+			} else {
+				free_netgen_graph(graph);
+			}
+		}
+		if(broken == NULL) {
+			if((arcs = netgen_graph(ctx, problem_seed, parms, 0, &graph)) < 0) {
+				broken = error_message(arcs);
+			} else if(!same_graph(first, graph)) {
+				broken = "netgen_graph differs from build_graph";
+			}
+			free_netgen_graph(graph);
+		}
+		free_netgen_graph(first);
+
+		checked++;
+		if(broken != NULL) {
+			failures++;
+			printf("FAILED %s: ", broken);
+			print_problem(stdout, problem_seed, c, parms);
+		} else if(verbose) {
+			printf("ok     %ld arcs: ", (long)ctx->arc_count);
+			print_problem(stdout, problem_seed, c, parms);
+		}
+		fflush(stdout);
+	}
+	free_netgen_context(ctx);
+
+	printf("%ld problems, %ld checked, %ld failures, %ld skipped\n", cases, checked, failures, skipped);
+	return failures ? 1 : 0;
+}
+
+
+/*** Draw a valid parameter vector: a general minimum cost flow problem,
+ *** sparse or dense, one time in four as large as the limits allow.
+ ***/
+static void draw_problem(RANDOM* random, long max_nodes, long max_arcs, long* parms)
+{
+	long most;
+
+	memset(parms, 0, PROBLEM_PARMS * sizeof(long));
+
+	NODES = randomi(random, 1L, 4L) == 1 ? randomi(random, max_nodes / 2, max_nodes) : randomi(random, 4L, 300L);
+	SOURCES = randomi(random, 1L, NODES / 2);
+	SINKS = randomi(random, 1L, NODES - SOURCES);
+	if(randomi(random, 1L, 2L) == 1) {
+		TSOURCES = randomi(random, 0L, SOURCES);
+		TSINKS = randomi(random, 0L, SINKS);
+	}
+	most = NODES * (NODES - SOURCES + TSOURCES);
+	DENSITY = randomi(random, NODES, 20 * NODES < most ? 20 * NODES : most);
+	if(DENSITY > max_arcs) {
+		DENSITY = max_arcs;
+	}
+	SUPPLY = SOURCES * randomi(random, 1L, 1000L);
+
+	MINCOST = randomi(random, 0L, 100L);
+	MAXCOST = MINCOST + randomi(random, 0L, 10000L);
+	HICOST = randomi(random, 0L, 100L);
+	CAPACITATED = randomi(random, 0L, 100L);
+	MINCAP = randomi(random, 0L, 1000L);
+	MAXCAP = MINCAP + randomi(random, 0L, 100000L);
+}
+
+
+/*** Check a graph against the network the context holds.  Returns NULL,
+ *** or the invariant it breaks.
+ ***/
+static const char* check_graph(NETGEN_CONTEXT* ctx, NETGEN_GRAPH* gp)
+{
+	const char* broken = NULL;
+	unsigned char* seen;
+	NODE v;
+	ARC p, k;
+
+	if(gp->nodes != (NODE)ctx->parms[0] || gp->arcs != ctx->arc_count) {
+		return "sizes differ from the network";
+	}
+	if(gp->first_out[0] != 0 || gp->first_out[gp->nodes] != gp->arcs ||
+	   gp->first_in[0] != 0 || gp->first_in[gp->nodes] != gp->arcs) {
+		return "offsets do not span the arcs";
+	}
+	if((seen = (unsigned char*) calloc(gp->arcs + 1, 2)) == NULL) {
+		return "out of memory";
+	}
+
+	for(v = 0; v < gp->nodes && broken == NULL; v++) {
+		if(gp->first_out[v] > gp->first_out[v + 1] || gp->first_in[v] > gp->first_in[v + 1]) {
+			broken = "offsets decrease";
+			break;
+		}
+		for(p = gp->first_out[v]; p < gp->first_out[v + 1]; p++) {
+			if(gp->tail[p] != v) {
+				broken = "arc out of the wrong tail";
+			} else if(p > gp->first_out[v] && gp->order[p] <= gp->order[p - 1]) {
+				broken = "out arcs not in generation order";
+			}
+		}
+		for(k = gp->first_in[v]; k < gp->first_in[v + 1] && broken == NULL; k++) {
+			p = gp->in_arc[k];
+			if(p >= gp->arcs || seen[2 * p]) {
+				broken = "in_arc is not a permutation";
+			} else if(gp->head[p] != v) {
+				broken = "in_arc arc into the wrong head";
+			} else if(k > gp->first_in[v] && gp->order[p] <= gp->order[gp->in_arc[k - 1]]) {
+				broken = "in arcs not in generation order";
+			} else {
+				seen[2 * p] = 1;
+			}
+		}
+	}
+
+	for(p = 0; p < gp->arcs && broken == NULL; p++) {
+		k = gp->order[p];
+		if(k >= gp->arcs || seen[2 * k + 1]) {
+			broken = "order is not a permutation";
+		} else if(ARC_FROM(k) - 1 != gp->tail[p] || ARC_TO(k) - 1 != gp->head[p] ||
+		          ARC_C(k) != gp->cost[p] || ARC_U(k) != gp->capacity[p]) {
+			broken = "order does not lead back to the network's arc";
+		} else {
+			seen[2 * k + 1] = 1;
+		}
+	}
+	if(broken == NULL && memcmp((void *)gp->supply, (void *)ctx->b, gp->nodes * sizeof(CAPACITY)) != 0) {
+		broken = "supplies differ from the network";
+	}
+
+	free((void *)seen);
+	return broken;
+}
+
+
+/*** Whether two graphs are the same, array by array. ***/
+static int same_graph(NETGEN_GRAPH* a, NETGEN_GRAPH* b)
+{
+	return a->nodes == b->nodes && a->arcs == b->arcs &&
+		!memcmp((void *)a->first_out, (void *)b->first_out, (a->nodes + 1) * sizeof(ARC)) &&
+		!memcmp((void *)a->first_in, (void *)b->first_in, (a->nodes + 1) * sizeof(ARC)) &&
+		!memcmp((void *)a->tail, (void *)b->tail, a->arcs * sizeof(NODE)) &&
+		!memcmp((void *)a->head, (void *)b->head, a->arcs * sizeof(NODE)) &&
+		!memcmp((void *)a->cost, (void *)b->cost, a->arcs * sizeof(COST)) &&
+		!memcmp((void *)a->capacity, (void *)b->capacity, a->arcs * sizeof(CAPACITY)) &&
+		!memcmp((void *)a->order, (void *)b->order, a->arcs * sizeof(ARC)) &&
+		!memcmp((void *)a->in_arc, (void *)b->in_arc, a->arcs * sizeof(ARC)) &&
+		!memcmp((void *)a->supply, (void *)b->supply, a->nodes * sizeof(CAPACITY));
+}
+
+
+/*** Print a problem as a line of a manifest. ***/
+static void print_problem(FILE* fout, long seed, long problem, long* parms)
+{
+	int i;
+
+	fprintf(fout, "%ld %ld", seed, problem);
+	for(i = 0; i < PROBLEM_PARMS; i++) {
+		fprintf(fout, " %ld", parms[i]);
+	}
+	fprintf(fout, "\n");
+}
@@ -0,0 +1,370 @@
+/*** Microbenchmarks for index lists and the random number generators.
+ ***
+ *** Each benchmark repeats one access pattern of netgen() on lists of
+ *** several sizes, for both representations (a bitset of flags up to
+ *** FLAG_LIMIT, a tree or Fenwick engine above) and both large engines:
+ ***
+ ***	make           make_index_list and free_index_list of a whole list
+ ***	reset          reset_index_list of a list that was used, as done for
+ ***	               every tail of the skeleton
+ ***	choose_random  choose_index at random positions of a near full list,
+ ***	               as the skeleton's transshipment nodes are drawn
+ ***	remove_random  remove_index of random, possibly repeated, indices
+ ***	drain          choose_index(handle, 1) until the list is empty, as the
+ ***	               sinks left over for the last source are collected
+ ***	short_lists    a reset, one removal and a few choices at random
+ ***	               positions up to pseudo_size, as in pick_head
+ ***
+ *** and the random number generators: randomi, fill_randomi, skip_randomi
+ *** and streami.  Every benchmark is repeated, doubling its rounds, until it
+ *** has run for the minimum time; one JSON object is printed per benchmark,
+ *** with the time per operation and a checksum of the values obtained.
+ ***/
+
+/*** System Interfaces ***/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/*** NETGEN Interfaces ***/
+#include "index.h"
+#include "random.h"
+
+/*** Local Constants ***/
+#define SEED 13502460			/* seed of every benchmark                  */
+#define SHORT_CHOICES 8			/* heads chosen from each short list        */
+#define FILL_COUNT 1024			/* numbers drawn per call of fill_randomi   */
+#define SKIP_COUNT 1000			/* numbers skipped per call of skip_randomi */
+
+#define USAGE "Usage: ./micro [-b BENCHMARK] [-l tree|fenwick] [-t SECONDS]\n"
+
+/*** Type Definitions ***/
+typedef struct bench_args {
+	INDEX size;					/* size of the lists, zero for the generators */
+	int engine;					/* engine of the large lists                  */
+	RANDOM random;				/* draws of the access pattern                */
+	unsigned long check;		/* checksum of the values obtained            */
+} BENCH_ARGS;
+
+typedef unsigned long (*BENCHMARK)(BENCH_ARGS*, unsigned long);	/* runs some rounds, returns operations */
+
+typedef struct bench_entry {
+	const char* name;
+	BENCHMARK run;
+	int lists;					/* 1 if it runs on lists of every size        */
+} BENCH_ENTRY;
+
+/*** Private Function Prototypes ***/
+static double now(void);
+static INDEX_LIST prepare(BENCH_ARGS*);
+static unsigned long bench_make(BENCH_ARGS*, unsigned long);
+static unsigned long bench_reset(BENCH_ARGS*, unsigned long);
+static unsigned long bench_choose_random(BENCH_ARGS*, unsigned long);
+static unsigned long bench_remove_random(BENCH_ARGS*, unsigned long);
+static unsigned long bench_drain(BENCH_ARGS*, unsigned long);
+static unsigned long bench_short_lists(BENCH_ARGS*, unsigned long);
+static unsigned long bench_randomi(BENCH_ARGS*, unsigned long);
+static unsigned long bench_fill_randomi(BENCH_ARGS*, unsigned long);
+static unsigned long bench_skip_randomi(BENCH_ARGS*, unsigned long);
+static unsigned long bench_streami(BENCH_ARGS*, unsigned long);
+static void measure(const BENCH_ENTRY*, INDEX, int, double);
+
+/*** Benchmarks ***/
+static const BENCH_ENTRY benchmarks[] = {
+	{ "make", bench_make, 1 },
+	{ "reset", bench_reset, 1 },
+	{ "choose_random", bench_choose_random, 1 },
+	{ "remove_random", bench_remove_random, 1 },
+	{ "drain", bench_drain, 1 },
+	{ "short_lists", bench_short_lists, 1 },
+	{ "randomi", bench_randomi, 0 },
+	{ "fill_randomi", bench_fill_randomi, 0 },
+	{ "skip_randomi", bench_skip_randomi, 0 },
+	{ "streami", bench_streami, 0 },
+	{ NULL, NULL, 0 }
+};
+
+static const INDEX sizes[] = { 16, 64, 256, 4096, 65536, 1048576, 0 };
+
+
+int
+main(int argc, char **argv)
+{
+	const BENCH_ENTRY* entry;
+	const char* only = NULL;
+	double minimum = 0.2;
+	int engines[2] = { INDEX_TREE, INDEX_FENWICK };
+	int engine_count = 2;
+	int i, e, c;
+
+	while((c = getopt(argc, argv, "b:l:t:")) != -1) {
+		switch(c) {
+			case 'b':
+				only = optarg;
+				break;
+			case 'l':
+				engine_count = 1;
+				if(!strcmp(optarg, "tree")) {
+					engines[0] = INDEX_TREE;
+				} else if(!strcmp(optarg, "fenwick")) {
+					engines[0] = INDEX_FENWICK;
+				} else {
+					fprintf(stderr, USAGE);
+					return 1;
+				}
+				break;
+			case 't':
+				minimum = atof(optarg);
+				break;
+			default:
+				fprintf(stderr, USAGE);
+				return 1;
+		}
+	}
+	if(optind != argc) {
+		fprintf(stderr, USAGE);
+		return 1;
+	}
+
+	for(entry = benchmarks; entry->name; entry++) {
+		if(only && strcmp(only, entry->name)) {
+			continue;
+		}
+		if(!entry->lists) {
+			measure(entry, 0, 0, minimum);
+			continue;
+		}
+		for(i = 0; sizes[i]; i++) {
+			/* the engine only matters above FLAG_LIMIT, and make uses the default one */
+			if(sizes[i] <= FLAG_LIMIT || entry->run == bench_make) {
+				measure(entry, sizes[i], INDEX_ENGINE, minimum);
+				continue;
+			}
+			for(e = 0; e < engine_count; e++) {
+				measure(entry, sizes[i], engines[e], minimum);
+			}
+		}
+	}
+	return 0;
+}
+
+
+/*** Wall clock time in seconds. ***/
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+/*** Make a list of the benchmark's size on its engine, the way netgen()
+ *** keeps its lists: made empty once, then reset to each range.
+ ***/
+static INDEX_LIST prepare(BENCH_ARGS* args)
+{
+	INDEX_LIST handle;
+
+	if((handle = make_index_list((INDEX)1, (INDEX)1)) == NULL) {
+		fprintf(stderr, "out of memory\n");
+		exit(1);
+	}
+	use_index_engine(handle, args->engine);
+	if(reset_index_list(handle, (INDEX)1, args->size)) {
+		fprintf(stderr, "out of memory\n");
+		exit(1);
+	}
+	return handle;
+}
+
+
+static unsigned long bench_make(BENCH_ARGS* args, unsigned long rounds)
+{
+	INDEX_LIST handle;
+	unsigned long r;
+
+	for(r = 0; r < rounds; r++) {
+		if((handle = make_index_list((INDEX)1, args->size)) == NULL) {
+			fprintf(stderr, "out of memory\n");
+			exit(1);
+		}
+		args->check += index_size(handle);
+		free_index_list(handle);
+	}
+	return rounds;
+}
+
+
+static unsigned long bench_reset(BENCH_ARGS* args, unsigned long rounds)
+{
+	INDEX_LIST handle = prepare(args);
+	unsigned long r;
+
+	for(r = 0; r < rounds; r++) {
+		reset_index_list(handle, (INDEX)1, args->size);
+		args->check += choose_index(handle, (INDEX)randomi(&args->random, 1L, (long)args->size));
+	}
+	free_index_list(handle);
+	return rounds;
+}
+
+
+static unsigned long bench_choose_random(BENCH_ARGS* args, unsigned long rounds)
+{
+	INDEX_LIST handle = prepare(args);
+	INDEX count = args->size / 8 ? args->size / 8 : 1;
+	unsigned long r;
+	INDEX i;
+
+	for(r = 0; r < rounds; r++) {
+		reset_index_list(handle, (INDEX)1, args->size);
+		for(i = 0; i < count; i++) {
+			args->check += choose_index(handle, (INDEX)randomi(&args->random, 1L, (long)index_size(handle)));
+		}
+	}
+	free_index_list(handle);
+	return rounds * count;
+}
+
+
+static unsigned long bench_remove_random(BENCH_ARGS* args, unsigned long rounds)
+{
+	INDEX_LIST handle = prepare(args);
+	INDEX count = args->size / 8 ? args->size / 8 : 1;
+	unsigned long r;
+	INDEX i;
+
+	for(r = 0; r < rounds; r++) {
+		reset_index_list(handle, (INDEX)1, args->size);
+		for(i = 0; i < count; i++) {
+			remove_index(handle, (INDEX)randomi(&args->random, 1L, (long)args->size));
+		}
+		args->check += index_size(handle);
+	}
+	free_index_list(handle);
+	return rounds * count;
+}
+
+
+static unsigned long bench_drain(BENCH_ARGS* args, unsigned long rounds)
+{
+	INDEX_LIST handle = prepare(args);
+	unsigned long r;
+
+	for(r = 0; r < rounds; r++) {
+		reset_index_list(handle, (INDEX)1, args->size);
+		while(index_size(handle) > 0) {
+			args->check += choose_index(handle, 1);
+		}
+	}
+	free_index_list(handle);
+	return rounds * args->size;
+}
+
+
+static unsigned long bench_short_lists(BENCH_ARGS* args, unsigned long rounds)
+{
+	INDEX_LIST handle = prepare(args);
+	unsigned long r;
+	int i;
+
+	for(r = 0; r < rounds; r++) {
+		reset_index_list(handle, (INDEX)1, args->size);
+		remove_index(handle, (INDEX)randomi(&args->random, 1L, (long)args->size));
+		for(i = 0; i < SHORT_CHOICES; i++) {
+			args->check += choose_index(handle, (INDEX)randomi(&args->random, 1L, (long)pseudo_size(handle)));
+		}
+	}
+	free_index_list(handle);
+	return rounds;
+}
+
+
+static unsigned long bench_randomi(BENCH_ARGS* args, unsigned long rounds)
+{
+	unsigned long r;
+
+	for(r = 0; r < rounds; r++) {
+		args->check += randomi(&args->random, 1L, 1000000L);
+	}
+	return rounds;
+}
+
+
+static unsigned long bench_fill_randomi(BENCH_ARGS* args, unsigned long rounds)
+{
+	long buffer[FILL_COUNT];
+	unsigned long r;
+
+	for(r = 0; r < rounds; r++) {
+		fill_randomi(&args->random, buffer, FILL_COUNT);
+		args->check += buffer[r % FILL_COUNT];
+	}
+	return rounds * FILL_COUNT;
+}
+
+
+static unsigned long bench_skip_randomi(BENCH_ARGS* args, unsigned long rounds)
+{
+	unsigned long r;
+
+	for(r = 0; r < rounds; r++) {
+		skip_randomi(&args->random, SKIP_COUNT + r % SKIP_COUNT);
+		args->check += args->random.seed;
+	}
+	return rounds;
+}
+
+
+static unsigned long bench_streami(BENCH_ARGS* args, unsigned long rounds)
+{
+	RANDOM_STREAM stream;
+	unsigned long r;
+
+	set_stream(&stream, SEED, 1UL, 0);
+	for(r = 0; r < rounds; r++) {
+		args->check += streami(&stream, 1L, 1000000L);
+	}
+	return rounds;
+}
+
+
+/*** Run a benchmark with doubling rounds until it takes the minimum time,
+ *** then print its result.  The checksum is the one of a first, single
+ *** round, so that it can be compared between engines.
+ ***/
+static void measure(const BENCH_ENTRY* entry, INDEX size, int engine, double minimum)
+{
+	BENCH_ARGS args;
+	unsigned long rounds, operations, check = 0;
+	double start, elapsed;
+
+	for(rounds = 0; ; rounds = rounds ? 2 * rounds : 1) {
+		args.size = size;
+		args.engine = engine;
+		args.check = 0;
+		set_randomi(&args.random, SEED);
+		start = now();
+		operations = entry->run(&args, rounds ? rounds : 1);
+		elapsed = now() - start;
+		if(rounds == 0) {
+			check = args.check;
+		} else if(elapsed >= minimum) {
+			break;
+		}
+	}
+
+	printf("{\"benchmark\": \"%s\", ", entry->name);
+	if(entry->lists) {
+		printf("\"representation\": \"%s\", \"engine\": \"%s\", \"size\": %lu, ",
+			size <= FLAG_LIMIT ? "small" : "large",
+			size <= FLAG_LIMIT ? "flags" : engine == INDEX_FENWICK ? "fenwick" : "tree",
+			(unsigned long)size);
+	}
+	printf("\"operations\": %lu, \"seconds\": %.6f, \"ns_per_operation\": %.2f, \"check\": %lu}\n",
+		operations, elapsed, elapsed * 1e9 / operations, check);
+	fflush(stdout);
+}
@@ -0,0 +1,491 @@
+/*** batch.c - generate many problems in parallel */
+
+/*** A manifest is a sequence of problem specifications in the format the
+ *** generator reads from stdin: a seed, a problem number and the 13
+ *** generation parameters, separated by white space and repeated until the
+ *** end of the file.  A '#' starts a comment that runs to the end of its
+ *** line; comments go between problems.  Each problem is written to a file
+ *** named after its problem number, exactly as an interactive run would
+ *** write it.  A manifest may sweep seeds under one problem number: the
+ *** files of problems sharing a number are named PROBLEM.SEED instead, so
+ *** that no two jobs write the same file.  Two problems with the same
+ *** number and seed would still share one, and make the manifest invalid.
+ ***
+ *** Problems are run by a pool of worker threads, each owning a generator
+ *** context and a deque of jobs.  Jobs are sorted by decreasing size and
+ *** dealt round robin, and every worker takes the largest job left at the
+ *** front of its own deque.  A worker whose deque runs dry steals the
+ *** largest job from the fullest deque, so a few large problems are started
+ *** early and never leave the other threads idle behind them.
+ ***
+ *** When a memory budget is given, a job is only admitted if its estimated
+ *** footprint fits next to the jobs already running.  A worker that cannot
+ *** admit its next job looks for a smaller one, and sleeps until memory is
+ *** released if none fits.  A job larger than the whole budget still runs,
+ *** but alone.
+ ***/
+
+#include <ctype.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "batch.h"
+#include "dimacs.h"
+
+/*** Internally useful types */
+typedef struct job_queue {
+	pthread_mutex_t lock;
+	BATCH_JOB** jobs;				/* jobs dealt to this worker, largest first */
+	size_t first;					/* position of the next job to take         */
+	size_t last;					/* one past the last job                    */
+} QUEUE;
+
+typedef struct batch_pool {
+	QUEUE* queues;					/* one deque per worker                     */
+	int workers;
+	size_t budget;					/* memory budget in bytes, zero if none     */
+	pthread_mutex_t memory_lock;	/* guards the fields below                  */
+	pthread_cond_t memory_freed;
+	size_t in_use;					/* footprint of the jobs running            */
+	size_t remaining;				/* jobs not yet taken                       */
+	int running;					/* jobs admitted and not yet finished       */
+	const OUTPUT_OPTIONS* output;	/* how problems are written                 */
+	int failures;					/* jobs that could not be written           */
+} POOL;
+
+typedef struct batch_worker {
+	POOL* pool;
+	int self;						/* index of the worker's own deque          */
+	pthread_t thread;
+} WORKER;
+
+
+/*** Private functions */
+
+static int compare_jobs(const void*, const void*);
+static int compare_names(const void*, const void*);
+static int name_jobs(BATCH_JOB**, size_t);
+static BATCH_JOB* take_job(POOL*, int);
+static BATCH_JOB* admit_job(POOL*, int);
+static BATCH_JOB* remove_job(QUEUE*, size_t);
+static int run_job(NETGEN_CONTEXT*, BATCH_JOB*, const OUTPUT_OPTIONS*);
+static void* work(void*);
+
+
+/*** Read the next problem of a manifest, skipping the comments before
+ *** it: from a '#' to the end of the line.  Returns 1 if a problem was
+ *** read, 0 at the end of the manifest and -1 if it is malformed.
+ ***/
+int read_problem(FILE* fin, BATCH_JOB* job)
+{
+	int i, c;
+
+	while((c = getc(fin)) != EOF) {
+		if(c == '#') {
+			while((c = getc(fin)) != EOF && c != '\n')
+				;
+		} else if(!isspace(c)) {
+			ungetc(c, fin);
+			break;
+		}
+	}
+
+	switch(fscanf(fin, "%ld%ld", &job->seed, &job->problem)) {
+		case EOF:
+			return 0;
+		case 2:
+			break;
+		default:
+			return -1;
+	}
+	for(i = 0; i < PROBLEM_PARMS; i++) {
+		if(fscanf(fin, "%ld", &job->parms[i]) != 1) {
+			return -1;
+		}
+	}
+
+	job->shared = 0;
+	return 1;
+}
+
+
+/*** Generate every problem of a manifest using the given number of threads
+ *** (all online processors if not positive), memory budget in bytes
+ *** (unlimited if zero) and output options.  Returns the number of problems that failed, or
+ *** -1 if the manifest cannot be read.
+ ***/
+int run_batch(FILE* fin, int threads, size_t budget, const OUTPUT_OPTIONS* output)
+{
+	BATCH_JOB* jobs = NULL;
+	BATCH_JOB** order = NULL;
+	BATCH_JOB** slots = NULL;
+	BATCH_JOB* more;
+	WORKER* workers = NULL;
+	POOL pool;
+	size_t count = 0, space = 0, n, pos;
+	size_t extra;
+	ARC block;
+	int rc, i;
+
+	/* Read the whole manifest before starting. */
+	for(;;) {
+		if(count == space) {
+			space = 2 * space + 64;
+			if((more = (BATCH_JOB*) realloc((void *)jobs, space * sizeof(BATCH_JOB))) == NULL) {
+				free((void *)jobs);
+				return -1;
+			}
+			jobs = more;
+		}
+		if((rc = read_problem(fin, &jobs[count])) <= 0) {
+			break;
+		}
+		count++;
+	}
+	if(rc < 0) {
+		fprintf(stderr, "Malformed problem specification after %lu problems of the manifest.\n", (unsigned long)count);
+		free((void *)jobs);
+		return -1;
+	}
+
+	/* Estimate each job's memory as it will be written: the streaming
+	 * formats and shards hold only a block of arcs at a time, and the
+	 * pipeline also the ring of its writers.
+	 */
+	block = output->format == OUTPUT_STREAM || output->format == OUTPUT_SPILL ||
+	        output->format == OUTPUT_PIPELINE || output->shards > 1 ? ARC_BLOCK : 0;
+	extra = output->format == OUTPUT_PIPELINE ? pipe_space(output->threads) : 0;
+	for(n = 0; n < count; n++) {
+		jobs[n].footprint = netgen_footprint(jobs[n].parms, block, output->compact, extra);
+	}
+
+	if(threads <= 0) {
+		threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+	}
+	if((size_t)threads > count) {
+		threads = (int)count;
+	}
+	if(threads <= 0) {
+		threads = 1;
+	}
+
+	/* Sort the jobs by decreasing size and deal them to the workers, each
+	 * deque being a contiguous run of slots.
+	 */
+	order = (BATCH_JOB**) malloc((count + 1) * sizeof(BATCH_JOB*));
+	slots = (BATCH_JOB**) malloc((count + 1) * sizeof(BATCH_JOB*));
+	pool.queues = (QUEUE*) calloc((size_t)threads, sizeof(QUEUE));
+	workers = (WORKER*) calloc((size_t)threads, sizeof(WORKER));
+	if(!order || !slots || !pool.queues || !workers) {
+		free((void *)order);
+		free((void *)slots);
+		free((void *)pool.queues);
+		free((void *)workers);
+		free((void *)jobs);
+		return -1;
+	}
+	for(n = 0; n < count; n++) {
+		order[n] = &jobs[n];
+	}
+	if(name_jobs(order, count) != 0) {
+		free((void *)order);
+		free((void *)slots);
+		free((void *)pool.queues);
+		free((void *)workers);
+		free((void *)jobs);
+		return -1;
+	}
+	qsort((void *)order, count, sizeof(BATCH_JOB*), compare_jobs);
+
+	pos = 0;
+	for(i = 0; i < threads; i++) {
+		pool.queues[i].jobs = slots;
+		pool.queues[i].first = pos;
+		for(n = (size_t)i; n < count; n += (size_t)threads) {
+			slots[pos++] = order[n];
+		}
+		pool.queues[i].last = pos;
+		pthread_mutex_init(&pool.queues[i].lock, NULL);
+	}
+	free((void *)order);
+
+	pool.workers = threads;
+	pool.budget = budget;
+	pool.in_use = 0;
+	pool.remaining = count;
+	pool.running = 0;
+	pool.failures = 0;
+	pool.output = output;
+	pthread_mutex_init(&pool.memory_lock, NULL);
+	pthread_cond_init(&pool.memory_freed, NULL);
+
+	/* Run the pool; the calling thread is worker zero.  Should a thread
+	 * fail to start, its deque is simply emptied by the others.
+	 */
+	for(i = 0; i < threads; i++) {
+		workers[i].pool = &pool;
+		workers[i].self = i;
+	}
+	for(i = 1; i < threads; i++) {
+		if(pthread_create(&workers[i].thread, NULL, work, (void *)&workers[i]) != 0) {
+			workers[i].pool = NULL;
+		}
+	}
+	work((void *)&workers[0]);
+	for(i = 1; i < threads; i++) {
+		if(workers[i].pool) {
+			pthread_join(workers[i].thread, NULL);
+		}
+	}
+
+	for(i = 0; i < threads; i++) {
+		pthread_mutex_destroy(&pool.queues[i].lock);
+	}
+	pthread_cond_destroy(&pool.memory_freed);
+	pthread_mutex_destroy(&pool.memory_lock);
+	free((void *)slots);
+	free((void *)pool.queues);
+	free((void *)workers);
+	free((void *)jobs);
+
+	return pool.failures;
+}
+
+
+/*** Order jobs by decreasing footprint, then by problem number. */
+
+static int compare_jobs(const void* a, const void* b)
+{
+	const BATCH_JOB* ja = *(const BATCH_JOB* const*)a;
+	const BATCH_JOB* jb = *(const BATCH_JOB* const*)b;
+
+	if(ja->footprint != jb->footprint) {
+		return ja->footprint > jb->footprint ? -1 : 1;
+	}
+	return ja->problem < jb->problem ? -1 : (ja->problem > jb->problem);
+}
+
+
+/*** Order jobs by problem number, then by seed. */
+
+static int compare_names(const void* a, const void* b)
+{
+	const BATCH_JOB* ja = *(const BATCH_JOB* const*)a;
+	const BATCH_JOB* jb = *(const BATCH_JOB* const*)b;
+
+	if(ja->problem != jb->problem) {
+		return ja->problem < jb->problem ? -1 : 1;
+	}
+	return ja->seed < jb->seed ? -1 : (ja->seed > jb->seed);
+}
+
+
+/*** Mark the jobs whose problem number is used more than once, so that
+ *** each has an output file of its own.  Returns zero, or -1 if two jobs
+ *** have the same problem number and seed.
+ ***/
+static int name_jobs(BATCH_JOB** order, size_t count)
+{
+	size_t n;
+
+	qsort((void *)order, count, sizeof(BATCH_JOB*), compare_names);
+	for(n = 1; n < count; n++) {
+		if(order[n]->problem != order[n - 1]->problem) {
+			continue;
+		}
+		if(order[n]->seed == order[n - 1]->seed) {
+			fprintf(stderr, "Problem %ld appears twice in the manifest with seed %ld.\n", order[n]->problem, order[n]->seed);
+			return -1;
+		}
+		order[n]->shared = order[n - 1]->shared = 1;
+	}
+	return 0;
+}
+
+
+/*** Remove the job at a given position of a deque, whose lock is held,
+ *** keeping the others in order.
+ ***/
+static BATCH_JOB* remove_job(QUEUE* q, size_t pos)
+{
+	BATCH_JOB* job = q->jobs[pos];
+
+	for( ; pos > q->first; pos--) {
+		q->jobs[pos] = q->jobs[pos - 1];
+	}
+	q->first++;
+	return job;
+}
+
+
+/*** Take the next job for a worker when there is no memory budget: the
+ *** front of its own deque, or else the front of the fullest other deque.
+ *** Returns NULL once every deque is empty.
+ ***/
+static BATCH_JOB* take_job(POOL* pool, int self)
+{
+	BATCH_JOB* job = NULL;
+	QUEUE* q;
+	size_t most;
+	int i, victim;
+
+	if(pool->budget) {
+		return admit_job(pool, self);
+	}
+
+	q = &pool->queues[self];
+	pthread_mutex_lock(&q->lock);
+	if(q->first < q->last) {
+		job = remove_job(q, q->first);
+	}
+	pthread_mutex_unlock(&q->lock);
+
+	while(job == NULL) {
+		/* Pick the fullest deque; it may have shrunk before it is robbed. */
+		most = 0;
+		victim = -1;
+		for(i = 0; i < pool->workers; i++) {
+			q = &pool->queues[i];
+			pthread_mutex_lock(&q->lock);
+			if(q->last - q->first > most) {
+				most = q->last - q->first;
+				victim = i;
+			}
+			pthread_mutex_unlock(&q->lock);
+		}
+		if(victim < 0) {
+			break;
+		}
+		q = &pool->queues[victim];
+		pthread_mutex_lock(&q->lock);
+		if(q->first < q->last) {
+			job = remove_job(q, q->first);
+		}
+		pthread_mutex_unlock(&q->lock);
+	}
+
+	return job;
+}
+
+
+/*** Take the next job for a worker under a memory budget: the largest job
+ *** that fits, looking first in the worker's own deque and then in the
+ *** others.  If none fits the worker waits for running jobs to release
+ *** memory, unless nothing is running, in which case the largest job is
+ *** admitted regardless.  Returns NULL once every job has been taken.
+ ***/
+static BATCH_JOB* admit_job(POOL* pool, int self)
+{
+	BATCH_JOB* job = NULL;
+	BATCH_JOB* best;
+	QUEUE* q;
+	size_t pos;
+	int i, owner;
+
+	pthread_mutex_lock(&pool->memory_lock);
+	while(job == NULL && pool->remaining > 0) {
+		for(i = 0; i < pool->workers && job == NULL; i++) {
+			q = &pool->queues[(self + i) % pool->workers];
+			pthread_mutex_lock(&q->lock);
+			for(pos = q->first; pos < q->last; pos++) {
+				if(pool->in_use + q->jobs[pos]->footprint <= pool->budget) {
+					job = remove_job(q, pos);
+					break;
+				}
+			}
+			pthread_mutex_unlock(&q->lock);
+		}
+
+		if(job == NULL && pool->running == 0) {
+			best = NULL;
+			owner = 0;
+			for(i = 0; i < pool->workers; i++) {
+				q = &pool->queues[i];
+				if(q->first < q->last && (best == NULL || q->jobs[q->first]->footprint > best->footprint)) {
+					best = q->jobs[q->first];
+					owner = i;
+				}
+			}
+			q = &pool->queues[owner];
+			pthread_mutex_lock(&q->lock);
+			job = remove_job(q, q->first);
+			pthread_mutex_unlock(&q->lock);
+		}
+
+		if(job == NULL) {
+			pthread_cond_wait(&pool->memory_freed, &pool->memory_lock);
+		}
+	}
+
+	if(job) {
+		pool->remaining--;
+		pool->running++;
+		pool->in_use += job->footprint;
+	}
+	pthread_mutex_unlock(&pool->memory_lock);
+
+	return job;
+}
+
+
+/*** Generate one problem into its output file.  Returns zero on success. */
+
+static int run_job(NETGEN_CONTEXT* ctx, BATCH_JOB* job, const OUTPUT_OPTIONS* output)
+{
+	char filename[48];
+	long rc;
+
+	if(job->shared) {
+		sprintf(filename, "%ld.%ld", job->problem, job->seed);
+	} else {
+		sprintf(filename, "%ld", job->problem);
+	}
+	if((rc = generate_problem(filename, ctx, job->seed, job->problem, job->parms, output)) < 0) {
+		fprintf(stderr, "Problem %ld: %s\n", job->problem, error_message(rc));
+		return 1;
+	}
+
+	return 0;
+}
+
+
+/*** Body of a worker thread.  The generator context is kept from one job
+ *** to the next, except under a memory budget where its storage is
+ *** released so that the budget accounts for it exactly.
+ ***/
+static void* work(void* arg)
+{
+	WORKER* worker = (WORKER*)arg;
+	POOL* pool = worker->pool;
+	NETGEN_CONTEXT* ctx = NULL;
+	BATCH_JOB* job;
+	int failed;
+
+	while((job = take_job(pool, worker->self)) != NULL) {
+		if(ctx == NULL && (ctx = make_netgen_context()) == NULL) {
+			fprintf(stderr, "Problem %ld: %s\n", job->problem, error_message(ALLOCATION_FAILURE));
+			failed = 1;
+		} else {
+			failed = run_job(ctx, job, pool->output);
+		}
+
+		if(pool->budget) {
+			free_netgen_context(ctx);
+			ctx = NULL;
+		}
+
+		pthread_mutex_lock(&pool->memory_lock);
+		if(pool->budget) {
+			pool->running--;
+			pool->in_use -= job->footprint;
+			pthread_cond_broadcast(&pool->memory_freed);
+		}
+		pool->failures += failed;
+		pthread_mutex_unlock(&pool->memory_lock);
+	}
+
+	free_netgen_context(ctx);
+	return NULL;
+}
@@ -0,0 +1,24 @@
+#ifndef BATCH_H
+#define BATCH_H 1
+
+#include <stdio.h>
+
+#include "netgen.h"
+#include "output.h"
+
+/*** Type Definitions ***/
+typedef struct batch_job {
+	long seed;						/* random seed                              */
+	long problem;					/* problem number, also the output filename */
+	long parms[PROBLEM_PARMS];		/* generation parameters                    */
+	size_t footprint;				/* estimated memory, set by run_batch as    */
+									/* the job weight                           */
+	int shared;						/* set if other jobs have the same problem  */
+									/* number: output named PROBLEM.SEED        */
+} BATCH_JOB;
+
+/*** Methods Declaration ***/
+int read_problem(FILE*, BATCH_JOB*);		/* read the next problem of a manifest          */
+int run_batch(FILE*, int, size_t, const OUTPUT_OPTIONS*);	/* generate every problem of a manifest in parallel */
+
+#endif /* BATCH_H */
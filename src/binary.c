@@ -0,0 +1,334 @@
+/*** binary.c - save a generated network in a binary format read in place */
+
+/*** A binary file is a header followed by the arc and node arrays of the
+ *** network as the generator holds them: FROM, TO, U and C for the arcs,
+ *** in the order netgen() made them, then B for the nodes.  Each array
+ *** starts on a BINARY_ALIGNMENT boundary, so that a reader can map the
+ *** file and use the arrays where they lie instead of parsing them.
+ ***
+ *** The arrays are stored in the writer's own types and byte order, which
+ *** the header records next to a version number; open_binary refuses a
+ *** file whose layout differs from the reader's rather than converting
+ *** it.  The header also carries the seed, the problem number and the
+ *** 13 parameters, as the comment block of a DIMACS file does, and flags
+ *** telling which arrays hold real values: a file converted from DIMACS
+ *** text only knows what the text said (an asn file gives no capacities,
+ *** a max file no costs and only the signs of the supplies).
+ ***/
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "binary.h"
+#include "dimacs.h"
+
+/*** Local macros */
+
+#define ALIGN(n)	(((n) + BINARY_ALIGNMENT - 1) / BINARY_ALIGNMENT * BINARY_ALIGNMENT)
+#define COLUMN_ARCS	4096			/* arcs widened at a time from compact storage */
+
+typedef char header_is_256_bytes[sizeof(BINARY_HEADER) == 256 ? 1 : -1];
+
+
+/*** Private functions */
+
+static int save_network(const char*, BINARY_HEADER*, NETGEN_CONTEXT*, const NODE*, const NODE*, const CAPACITY*, const COST*, const CAPACITY*);
+static int write_array(FILE*, uint64_t*, uint64_t, const void*, size_t);
+static int write_column(FILE*, uint64_t*, uint64_t, NETGEN_CONTEXT*, int);
+
+
+/*** Save the network a context holds, generated without a sink, to the
+ *** named file.  Returns zero, or EOF if the file cannot be written.
+ ***/
+int write_binary(const char* filename, NETGEN_CONTEXT* ctx, long seed, long problem)
+{
+	BINARY_HEADER header;
+
+	if(ctx->parms == NULL || ctx->arc_base != 0) {
+		return EOF;
+	}
+
+	describe_network(&header, ctx, seed, problem);
+	return save_network(filename, &header, ctx, FROM, TO, U, C, B);
+}
+
+
+/*** Fill a header with the kind, flags, seed, problem, parameters and
+ *** sizes of the network a context holds.  Its layout fields are zero.
+ ***/
+void describe_network(BINARY_HEADER* header, NETGEN_CONTEXT* ctx, long seed, long problem)
+{
+	long* parms = ctx->parms;
+	int i;
+
+	memset(header, 0, sizeof(BINARY_HEADER));
+	header->kind = (uint32_t)problem_kind(parms);
+	header->flags = BINARY_PARAMETERS | BINARY_EXACT_CAPACITIES | BINARY_EXACT_COSTS | BINARY_EXACT_SUPPLIES;
+	if(ctx->fast) {
+		header->flags |= BINARY_FAST;
+	}
+	header->seed = seed;
+	header->problem = problem;
+	for(i = 0; i < PROBLEM_PARMS; i++) {
+		header->parms[i] = parms[i];
+	}
+	header->nodes = (uint64_t)NODES;
+	header->arcs = (uint64_t)ctx->arc_count;
+}
+
+
+/*** Save arrays of header->arcs arcs and header->nodes nodes to the named
+ *** file.  The caller fills in the kind, flags, seed, problem, parms and
+ *** sizes of the header; the layout fields are set here.  Returns zero,
+ *** or EOF if the file cannot be written.
+ ***/
+int save_binary(const char* filename, BINARY_HEADER* header, const NODE* from, const NODE* to,
+                const CAPACITY* u, const COST* c, const CAPACITY* b)
+{
+	return save_network(filename, header, NULL, from, to, u, c, b);
+}
+
+
+/*** Map the named binary file and check its header.  On success *binary
+ *** points to the arrays in the mapping, to be released by close_binary,
+ *** and zero is returned; otherwise *binary is NULL and the result is one
+ *** of the BINARY_ error codes.
+ ***/
+int open_binary(const char* filename, NETGEN_BINARY** binary)
+{
+	NETGEN_BINARY* bp;
+	const BINARY_HEADER* header;
+	struct stat st;
+	void* map;
+	size_t length;
+	uint64_t bytes[BINARY_ARRAYS];
+	int fd, i;
+
+	*binary = NULL;
+	if((fd = open(filename, O_RDONLY)) < 0) {
+		return BINARY_UNREADABLE;
+	}
+	if(fstat(fd, &st) != 0) {
+		close(fd);
+		return BINARY_UNREADABLE;
+	}
+	if((size_t)st.st_size < sizeof(BINARY_HEADER)) {
+		close(fd);
+		return BINARY_NOT_NETGEN;
+	}
+	length = (size_t)st.st_size;
+	map = mmap(NULL, length, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if(map == MAP_FAILED) {
+		return BINARY_UNREADABLE;
+	}
+
+	header = (const BINARY_HEADER*)map;
+	if(memcmp(header->magic, BINARY_MAGIC, sizeof(BINARY_MAGIC)) != 0) {
+		munmap(map, length);
+		return BINARY_NOT_NETGEN;
+	}
+	if(header->version != BINARY_VERSION) {
+		munmap(map, length);
+		return BINARY_BAD_VERSION;
+	}
+	if(header->byte_order != BINARY_BYTE_ORDER || header->header_size != sizeof(BINARY_HEADER) ||
+	   header->node_size != sizeof(NODE) || header->value_size != sizeof(CAPACITY)) {
+		munmap(map, length);
+		return BINARY_INCOMPATIBLE;
+	}
+
+	if(header->arcs > length || header->nodes > length) {
+		munmap(map, length);
+		return BINARY_TRUNCATED;
+	}
+	bytes[BINARY_FROM] = header->arcs * sizeof(NODE);
+	bytes[BINARY_TO] = header->arcs * sizeof(NODE);
+	bytes[BINARY_U] = header->arcs * sizeof(CAPACITY);
+	bytes[BINARY_C] = header->arcs * sizeof(COST);
+	bytes[BINARY_B] = header->nodes * sizeof(CAPACITY);
+	for(i = 0; i < BINARY_ARRAYS; i++) {
+		if(header->offset[i] % BINARY_ALIGNMENT != 0 || header->offset[i] < sizeof(BINARY_HEADER) ||
+		   header->offset[i] > length || bytes[i] > length - header->offset[i]) {
+			munmap(map, length);
+			return BINARY_TRUNCATED;
+		}
+	}
+
+	if((bp = (NETGEN_BINARY*) calloc(1, sizeof(NETGEN_BINARY))) == NULL) {
+		munmap(map, length);
+		return BINARY_UNREADABLE;
+	}
+	bp->header = header;
+	bp->nodes = (NODE)header->nodes;
+	bp->arcs = (ARC)header->arcs;
+	bp->from = (const NODE*)((const char*)map + header->offset[BINARY_FROM]);
+	bp->to = (const NODE*)((const char*)map + header->offset[BINARY_TO]);
+	bp->u = (const CAPACITY*)((const char*)map + header->offset[BINARY_U]);
+	bp->c = (const COST*)((const char*)map + header->offset[BINARY_C]);
+	bp->b = (const CAPACITY*)((const char*)map + header->offset[BINARY_B]);
+	bp->map = map;
+	bp->length = length;
+	madvise(map, length, MADV_WILLNEED);
+
+	*binary = bp;
+	return 0;
+}
+
+
+/*** Unmap a file opened by open_binary.  Its arrays are no longer valid.
+ ***/
+void close_binary(NETGEN_BINARY* bp)
+{
+	if(bp == NULL) {
+		return;
+	}
+	munmap(bp->map, bp->length);
+	free((void *)bp);
+}
+
+
+const char* binary_error(int rc)
+{
+	switch(rc) {
+		case BINARY_UNREADABLE:
+			return "Unable to map the file";
+		case BINARY_NOT_NETGEN:
+			return "Not a NETGEN binary file";
+		case BINARY_BAD_VERSION:
+			return "Unsupported binary format version";
+		case BINARY_INCOMPATIBLE:
+			return "Binary file written with other byte order or type sizes";
+		case BINARY_TRUNCATED:
+			return "Binary file is truncated or damaged";
+		default:
+			return "Internal error";
+	}
+}
+
+
+/*** Save a network to the named file, as save_binary does.  If ctx is
+ *** not NULL, the arcs are its own, which are widened a few at a time if
+ *** stored compact.
+ ***/
+static int save_network(const char* filename, BINARY_HEADER* header, NETGEN_CONTEXT* ctx, const NODE* from,
+                        const NODE* to, const CAPACITY* u, const COST* c, const CAPACITY* b)
+{
+	FILE* fout;
+	const void* arrays[BINARY_ARRAYS];
+	uint64_t bytes[BINARY_ARRAYS];
+	uint64_t place;
+	int i, rc = 0;
+
+	memcpy(header->magic, BINARY_MAGIC, sizeof(BINARY_MAGIC));
+	header->version = BINARY_VERSION;
+	header->header_size = sizeof(BINARY_HEADER);
+	header->byte_order = BINARY_BYTE_ORDER;
+	header->node_size = sizeof(NODE);
+	header->value_size = sizeof(CAPACITY);
+
+	arrays[BINARY_FROM] = from;
+	arrays[BINARY_TO] = to;
+	arrays[BINARY_U] = u;
+	arrays[BINARY_C] = c;
+	arrays[BINARY_B] = b;
+	bytes[BINARY_FROM] = header->arcs * sizeof(NODE);
+	bytes[BINARY_TO] = header->arcs * sizeof(NODE);
+	bytes[BINARY_U] = header->arcs * sizeof(CAPACITY);
+	bytes[BINARY_C] = header->arcs * sizeof(COST);
+	bytes[BINARY_B] = header->nodes * sizeof(CAPACITY);
+	place = sizeof(BINARY_HEADER);
+	for(i = 0; i < BINARY_ARRAYS; i++) {
+		header->offset[i] = place = ALIGN(place);
+		place += bytes[i];
+	}
+	header->file_size = place;
+
+	if((fout = fopen(filename, "wb")) == NULL) {
+		return EOF;
+	}
+	place = 0;
+	rc = write_array(fout, &place, 0, header, sizeof(BINARY_HEADER));
+	for(i = 0; i < BINARY_ARRAYS && rc == 0; i++) {
+		if(ctx != NULL && ctx->narrow && i != BINARY_B) {
+			rc = write_column(fout, &place, header->offset[i], ctx, i);
+		} else {
+			rc = write_array(fout, &place, header->offset[i], arrays[i], bytes[i]);
+		}
+	}
+	if(fclose(fout) != 0) {
+		rc = EOF;
+	}
+	return rc;
+}
+
+
+/*** Write zeros up to the given place, then an array.  Returns zero, or
+ *** EOF on a write error.
+ ***/
+static int write_array(FILE* fout, uint64_t* place, uint64_t offset, const void* data, size_t bytes)
+{
+	static const char zeros[BINARY_ALIGNMENT];
+
+	if(offset > *place && fwrite(zeros, 1, (size_t)(offset - *place), fout) != (size_t)(offset - *place)) {
+		return EOF;
+	}
+	if(bytes > 0 && fwrite(data, 1, bytes, fout) != bytes) {
+		return EOF;
+	}
+	*place = offset + bytes;
+	return 0;
+}
+
+
+/*** Write zeros up to the given place, then one of the arc arrays of a
+ *** context in compact storage, widened.  Returns zero, or EOF on a
+ *** write error.
+ ***/
+static int write_column(FILE* fout, uint64_t* place, uint64_t offset, NETGEN_CONTEXT* ctx, int column)
+{
+	NODE nodes[COLUMN_ARCS];
+	CAPACITY capacities[COLUMN_ARCS];
+	COST costs[COLUMN_ARCS];
+	const void* data;
+	size_t size;
+	ARC a, count;
+
+	if(write_array(fout, place, offset, NULL, 0) != 0) {
+		return EOF;
+	}
+	for(a = 0; a < ctx->arc_count; a += count) {
+		count = ctx->arc_count - a < COLUMN_ARCS ? ctx->arc_count - a : COLUMN_ARCS;
+		switch(column) {
+			case BINARY_FROM:
+				copy_arcs(ctx, a, count, nodes, NULL, NULL, NULL);
+				data = nodes;
+				size = sizeof(NODE);
+				break;
+			case BINARY_TO:
+				copy_arcs(ctx, a, count, NULL, nodes, NULL, NULL);
+				data = nodes;
+				size = sizeof(NODE);
+				break;
+			case BINARY_U:
+				copy_arcs(ctx, a, count, NULL, NULL, capacities, NULL);
+				data = capacities;
+				size = sizeof(CAPACITY);
+				break;
+			default:
+				copy_arcs(ctx, a, count, NULL, NULL, NULL, costs);
+				data = costs;
+				size = sizeof(COST);
+				break;
+		}
+		if(fwrite(data, size, count, fout) != count) {
+			return EOF;
+		}
+		*place += count * size;
+	}
+	return 0;
+}
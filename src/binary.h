@@ -0,0 +1,75 @@
+#ifndef BINARY_H
+#define BINARY_H 1
+
+#include <stdint.h>
+
+#include "netgen.h"
+
+/*** Constants Definition ***/
+#define BINARY_MAGIC		"NETGENB"	/* first bytes of a file, with the final NUL       */
+#define BINARY_VERSION		1			/* raised whenever the layout changes              */
+#define BINARY_BYTE_ORDER	0x01020304	/* as written by the machine that made the file    */
+#define BINARY_ALIGNMENT	64			/* every array starts on such a boundary           */
+
+#define BINARY_FROM			0			/* arrays of a file, in the order they are stored  */
+#define BINARY_TO			1
+#define BINARY_U			2
+#define BINARY_C			3
+#define BINARY_B			4
+#define BINARY_ARRAYS		5
+
+#define BINARY_PARAMETERS		0x01	/* seed, problem and parms are known               */
+#define BINARY_EXACT_CAPACITIES	0x02	/* U holds the capacities, not implied ones        */
+#define BINARY_EXACT_COSTS		0x04	/* C holds the costs, not implied ones             */
+#define BINARY_EXACT_SUPPLIES	0x08	/* B holds the supplies, not only their signs      */
+#define BINARY_FAST				0x10	/* generated in the fast mode                      */
+
+#define BINARY_UNREADABLE	-1			/* open_binary errors                              */
+#define BINARY_NOT_NETGEN	-2
+#define BINARY_BAD_VERSION	-3
+#define BINARY_INCOMPATIBLE	-4
+#define BINARY_TRUNCATED	-5
+
+/*** Type Definition ***/
+typedef struct binary_header {			/* 256 bytes at the start of the file              */
+	char magic[8];						/* BINARY_MAGIC                                    */
+	uint32_t version;					/* BINARY_VERSION                                  */
+	uint32_t header_size;				/* sizeof(BINARY_HEADER)                           */
+	uint32_t byte_order;				/* BINARY_BYTE_ORDER in the writer's byte order    */
+	uint32_t node_size;					/* bytes of a node number (FROM, TO)               */
+	uint32_t value_size;				/* bytes of a capacity, cost or supply (U, C, B)   */
+	uint32_t kind;						/* ASSIGNMENT, MAXIMUM_FLOW or MINIMUM_COST        */
+	uint32_t flags;						/* BINARY_ flags                                   */
+	uint32_t unused;
+	int64_t seed;						/* random seed                                     */
+	int64_t problem;					/* problem number                                  */
+	int64_t parms[PROBLEM_PARMS];		/* generation parameters                           */
+	uint64_t nodes;						/* length of B                                     */
+	uint64_t arcs;						/* length of FROM, TO, U and C                     */
+	uint64_t offset[BINARY_ARRAYS];		/* place of each array from the start of the file  */
+	uint64_t file_size;					/* bytes in the file                               */
+	uint64_t reserved[4];				/* zero                                            */
+} BINARY_HEADER;
+
+typedef struct netgen_binary {			/* a file mapped by open_binary                    */
+	const BINARY_HEADER* header;		/* seed, problem, parms, kind and flags            */
+	NODE nodes;
+	ARC arcs;
+	const NODE* from;					/* arrays in the mapping, nodes numbered from 1    */
+	const NODE* to;						/* as in the DIMACS file and the context           */
+	const CAPACITY* u;
+	const COST* c;
+	const CAPACITY* b;
+	void* map;
+	size_t length;
+} NETGEN_BINARY;
+
+/*** Methods Declaration ***/
+int write_binary(const char*, NETGEN_CONTEXT*, long, long);	/* save a generated problem in binary format */
+void describe_network(BINARY_HEADER*, NETGEN_CONTEXT*, long, long);	/* header fields of a generated problem */
+int save_binary(const char*, BINARY_HEADER*, const NODE*, const NODE*, const CAPACITY*, const COST*, const CAPACITY*);	/* save arrays under a header */
+int open_binary(const char*, NETGEN_BINARY**);	/* map a binary file and check its header */
+void close_binary(NETGEN_BINARY*);		/* unmap it                                     */
+const char* binary_error(int);			/* describes an open_binary error code          */
+
+#endif /* BINARY_H */
@@ -0,0 +1,1233 @@
+/*** dimacs.c - print a generated network in the DIMACS format */
+
+/*** The problem is printed as an assignment problem (asn), a maximum
+ *** flow problem (max) or a minimum cost flow problem (min), following the
+ *** same rules netgen() uses to decide which kind of problem it generates.
+ *** The comment block at the top records the generation parameters, so
+ *** that any file can be regenerated from its own header.
+ ***/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include "dimacs.h"
+#include "ring.h"
+#include "spill.h"
+#include "writes.h"
+
+/*** The arc and node lines, which make up nearly all of the file, are
+ *** formatted by hand into a large buffer that is handed to the stream in
+ *** one piece when full.  Each kind of problem has its own emitter, so that
+ *** the loop over the arcs does no format parsing and makes no decision
+ *** other than whether the buffer needs flushing.  The bytes written are
+ *** the same as printf's for the formats of the original program.
+ ***
+ *** Since the length of every line follows from the digit counts of its
+ *** numbers, the file can also be laid out before it is written:
+ *** write_dimacs_mapped measures the arc lines of each thread's share of
+ *** the arcs, sums the lengths to find where each share starts, and lets
+ *** the threads format their shares directly into a memory-mapped file.
+ ***
+ *** write_dimacs_gzip compresses the same file on several threads.  The
+ *** arc lines are cut into chunks of GZIP_CHUNK_ARCS arcs, each formatted
+ *** and deflated by a worker into a gzip member of its own, and the
+ *** calling thread writes the members in order as they are ready.  A file
+ *** of several members is still a gzip file: gunzip and zcat put the
+ *** members' contents end to end, which gives the bytes write_dimacs
+ *** prints.  Workers run ahead of the writer by at most GZIP_SLOTS chunks
+ *** per thread, so memory stays small whatever the size of the problem.
+ ***
+ *** stream_dimacs keeps no more than a block of arcs in memory.  As the
+ *** problem line needs the number of arcs and the node lines the final
+ *** supplies, these are learnt first, by plan_shards' counting pass, and
+ *** the problem is then generated with a sink that prints each block as
+ *** it is produced.  The counting pass skips the rubbish arcs; in the
+ *** fast mode, which has none, it is a full run with a sink that only
+ *** lets the arcs be counted.  Generation being deterministic, the
+ *** printing run produces the arcs the header announces, and the file is
+ *** the same as the one write_dimacs prints.
+ ***
+ *** spill_dimacs also keeps only a block of arcs in memory, but generates
+ *** the problem once: the blocks go to a spill file on disk (spill.h)
+ *** while the counts and supplies are found, and are read back in order
+ *** after the header is printed.
+ ***
+ *** pipe_dimacs keeps the generator and the output busy at the same time.
+ *** The generating thread publishes each block of arcs its sink receives
+ *** into a lock-free ring (ring.h), and writer threads format the blocks
+ *** and write them at their place in the file, through io_uring where
+ *** available (writes.h).  The header must come first, and depends on
+ *** the arc count and the final supplies: they are learnt beforehand by
+ *** plan_shards' counting pass, which does not generate the rubbish arcs
+ *** (a full first run in the fast mode), so the file is the same as the
+ *** one write_dimacs prints.
+ ***/
+
+/*** Local constants */
+
+#define OUTPUT_SPACE (1 << 20)		/* size of the output buffer            */
+#define LINE_SPACE   128			/* longest line: "a" and five longs     */
+#define GZIP_CHUNK_ARCS 16384		/* arcs per gzip member                 */
+#define GZIP_SLOTS   2				/* members in flight per worker         */
+#define GZIP_LEVEL   6				/* zlib compression level, as gzip's    */
+#define PIPE_BLOCK_ARCS 8192		/* arcs per block of the pipeline       */
+#define PIPE_SLOTS   2				/* blocks in the ring per writer, plus  */
+									/* WRITES_DEPTH                         */
+
+/*** Internally useful types */
+
+typedef struct output {
+	FILE* fout;
+	char* base;						/* start of the buffer                  */
+	char* next;						/* where the next line goes             */
+	char* limit;					/* flush before writing a line past it  */
+	int failed;						/* set if the stream rejected a write   */
+} OUTPUT;
+
+typedef struct slice {
+	NETGEN_CONTEXT* ctx;
+	int kind;						/* kind of problem                      */
+	ARC first;						/* arcs formatted by this thread        */
+	ARC last;
+	size_t length;					/* bytes taken by their lines           */
+	char* start;					/* where the first of them goes         */
+	pthread_t thread;
+	int started;
+} SLICE;
+
+typedef struct stream {
+	OUTPUT out;
+	int kind;						/* kind of problem                      */
+} STREAM;
+
+typedef struct member {
+	unsigned long chunk;			/* chunk the slot holds or waits for    */
+	int ready;						/* set once compressed, until written   */
+	int busy;						/* set while a worker fills it          */
+	char* text;						/* the chunk's arc lines                */
+	unsigned char* data;			/* the gzip member made of them         */
+	size_t data_space;
+	size_t length;					/* bytes of the member                  */
+} MEMBER;
+
+typedef struct compressor {
+	NETGEN_CONTEXT* ctx;
+	int kind;						/* kind of problem                      */
+	unsigned long chunks;			/* chunks of GZIP_CHUNK_ARCS arcs       */
+	unsigned long next;				/* next chunk for a worker to take      */
+	MEMBER* members;				/* chunk k goes to members[k % slots]   */
+	int slots;
+	int failed;						/* set if a chunk could not be deflated */
+	pthread_mutex_t lock;
+	pthread_cond_t ready;			/* signalled when a member is ready     */
+	pthread_cond_t written;			/* signalled when a slot is free again  */
+} COMPRESSOR;
+
+typedef struct pipeline {
+	RING ring;						/* blocks on their way to the writers   */
+	int kind;						/* kind of problem                      */
+	int fd;							/* the output file                      */
+	off_t base;						/* where its arc lines start            */
+	int uring;						/* set to write through io_uring        */
+} PIPELINE;
+
+
+/*** Private functions */
+
+static int open_output(OUTPUT*, FILE*);
+static void flush_output(OUTPUT*);
+static int close_output(OUTPUT*);
+static int write_header(FILE*, NETGEN_CONTEXT*, long, long, int, long);
+static void emit_asn(OUTPUT*, NETGEN_CONTEXT*, ARC);
+static void emit_max(OUTPUT*, NETGEN_CONTEXT*, ARC);
+static void emit_min(OUTPUT*, NETGEN_CONTEXT*, ARC);
+static int count_arcs(void*, NETGEN_CONTEXT*, ARC);
+static int print_arcs(void*, NETGEN_CONTEXT*, ARC);
+static char* format_arcs(char*, NETGEN_CONTEXT*, int, ARC, ARC);
+static void* measure_slice(void*);
+static void* format_slice(void*);
+static void run_slices(SLICE*, int, void* (*)(void*));
+static int deflate_member(z_stream*, const char*, size_t, MEMBER*);
+static int compress_chunk(COMPRESSOR*, z_stream*, MEMBER*);
+static void* compress_chunks(void*);
+static void* write_blocks(void*);
+static int finish_write(RING*, WRITES*);
+static int pipe_threads(int);
+
+
+/*** Local macros */
+
+#define ROOM(out)	if((out)->next > (out)->limit) flush_output(out)
+#define PUT(p, s)	(memcpy((p), (s), sizeof(s) - 1), (p) + sizeof(s) - 1)
+
+#define LONG_LENGTH(v)	((v) < 0 ? 1 + count_digits(0UL - (unsigned long)(v)) : count_digits((unsigned long)(v)))
+
+/* Line layouts, shared by the serial and the parallel writers. */
+#define PUT_ASN_ARC(p, a)		\
+	{						\
+		p = PUT(p, "a ");		\
+		p = put_long(p, (long)ARC_FROM(a));	\
+		*p++ = ' ';				\
+		p = put_long(p, (long)ARC_TO(a));	\
+		*p++ = ' ';				\
+		p = put_long(p, ARC_C(a));	\
+		*p++ = '\n';			\
+	}
+#define PUT_MAX_ARC(p, a)		\
+	{						\
+		p = PUT(p, "a ");		\
+		p = put_long(p, (long)ARC_FROM(a));	\
+		*p++ = ' ';				\
+		p = put_long(p, (long)ARC_TO(a));	\
+		*p++ = ' ';				\
+		p = put_long(p, ARC_U(a));	\
+		*p++ = '\n';			\
+	}
+#define PUT_MIN_ARC(p, a)		\
+	{						\
+		p = PUT(p, "a ");		\
+		p = put_long(p, (long)ARC_FROM(a));	\
+		*p++ = ' ';				\
+		p = put_long(p, (long)ARC_TO(a));	\
+		p = PUT(p, " 0 ");		\
+		p = put_long(p, ARC_U(a));	\
+		*p++ = ' ';				\
+		p = put_long(p, ARC_C(a));	\
+		*p++ = '\n';			\
+	}
+#define ASN_ARC_LENGTH(a)	(5 + LONG_LENGTH((long)ARC_FROM(a)) + LONG_LENGTH((long)ARC_TO(a)) + LONG_LENGTH(ARC_C(a)))
+#define MAX_ARC_LENGTH(a)	(5 + LONG_LENGTH((long)ARC_FROM(a)) + LONG_LENGTH((long)ARC_TO(a)) + LONG_LENGTH(ARC_U(a)))
+#define MIN_ARC_LENGTH(a)	(8 + LONG_LENGTH((long)ARC_FROM(a)) + LONG_LENGTH((long)ARC_TO(a)) + LONG_LENGTH(ARC_U(a)) + LONG_LENGTH(ARC_C(a)))
+
+static const char digit_pairs[] =
+	"00010203040506070809"
+	"10111213141516171819"
+	"20212223242526272829"
+	"30313233343536373839"
+	"40414243444546474849"
+	"50515253545556575859"
+	"60616263646566676869"
+	"70717273747576777879"
+	"80818283848586878889"
+	"90919293949596979899";
+
+
+/*** Number of decimal digits of an unsigned value. */
+
+int count_digits(unsigned long v)
+{
+	int n = 1;
+
+	for(;;) {
+		if(v < 10) {
+			return n;
+		}
+		if(v < 100) {
+			return n + 1;
+		}
+		if(v < 1000) {
+			return n + 2;
+		}
+		if(v < 10000) {
+			return n + 3;
+		}
+		v /= 10000;
+		n += 4;
+	}
+}
+
+
+/*** Format an unsigned value at p, two digits at a time from the right,
+ *** and return the position following it.
+ ***/
+char* put_unsigned(char* p, unsigned long v)
+{
+	char* q = p + count_digits(v);
+	char* end = q;
+
+	while(v >= 100) {
+		q -= 2;
+		memcpy(q, digit_pairs + 2 * (v % 100), 2);
+		v /= 100;
+	}
+	if(v >= 10) {
+		memcpy(q - 2, digit_pairs + 2 * v, 2);
+	} else {
+		q[-1] = (char)('0' + v);
+	}
+	return end;
+}
+
+
+/*** Format a signed value as printf's "%ld" would. */
+
+char* put_long(char* p, long v)
+{
+	if(v < 0) {
+		*p++ = '-';
+		return put_unsigned(p, 0UL - (unsigned long)v);
+	}
+	return put_unsigned(p, (unsigned long)v);
+}
+
+
+/*** Print the network held by a context after a successful call to
+ *** netgen().  Returns zero, or EOF if the stream reports an error.
+ ***/
+int write_dimacs(FILE* fout, NETGEN_CONTEXT* ctx, long seed, long problem)
+{
+	int kind = problem_kind(ctx->parms);
+	OUTPUT out;
+
+	if(write_header(fout, ctx, seed, problem, kind, (long)ctx->arc_count) != 0 || open_output(&out, fout) != 0) {
+		return EOF;
+	}
+
+	switch(kind) {
+		case ASSIGNMENT:
+			emit_asn(&out, ctx, ctx->arc_count);
+			break;
+		case MAXIMUM_FLOW:
+			emit_max(&out, ctx, ctx->arc_count);
+			break;
+		default:
+			emit_min(&out, ctx, ctx->arc_count);
+			break;
+	}
+
+	if(close_output(&out) != 0) {
+		return EOF;
+	}
+	return ferror(fout) ? EOF : 0;
+}
+
+
+/*** Generate a problem and print it, streaming the arcs through a sink so
+ *** that only a block of them is held at a time.  The context's sink is
+ *** cleared afterwards.  Returns the number of arcs, a netgen() error
+ *** code, or OUTPUT_FAILURE if the stream reports an error.
+ ***/
+long stream_dimacs(FILE* fout, NETGEN_CONTEXT* ctx, long seed, long problem, long parms[])
+{
+	STREAM stream;
+	long arcs;
+
+	/* Learn the number of arcs and the supplies. */
+	if(ctx->fast) {
+		set_arc_sink(ctx, count_arcs, NULL, ARC_BLOCK);
+		arcs = netgen(ctx, seed, parms);
+		set_arc_sink(ctx, NULL, NULL, 0);
+	} else {
+		arcs = plan_shards(ctx, seed, parms);
+	}
+	if(arcs < 0) {
+		return arcs;
+	}
+
+	stream.kind = problem_kind(parms);
+	if(write_header(fout, ctx, seed, problem, stream.kind, arcs) != 0 || open_output(&stream.out, fout) != 0) {
+		return OUTPUT_FAILURE;
+	}
+
+	/* Then generate the arcs, printing them as they come. */
+	set_arc_sink(ctx, print_arcs, (void *)&stream, ARC_BLOCK);
+	if(ctx->fast) {
+		arcs = netgen(ctx, seed, parms);
+	} else {
+		arcs = netgen_shard(ctx, seed, parms, 0, 1);
+	}
+	set_arc_sink(ctx, NULL, NULL, 0);
+
+	if(close_output(&stream.out) != 0 || ferror(fout)) {
+		return arcs < 0 ? arcs : OUTPUT_FAILURE;
+	}
+	return arcs;
+}
+
+
+/*** Generate a problem and print it, spilling the arcs to a temporary
+ *** file in the named directory so that only a block of them is held in
+ *** memory at a time.  The context's sink is cleared afterwards.  Returns
+ *** the number of arcs, a netgen() error code, or OUTPUT_FAILURE if the
+ *** spill file or the stream reports an error.
+ ***/
+long spill_dimacs(FILE* fout, NETGEN_CONTEXT* ctx, long seed, long problem, long parms[], const char* directory)
+{
+	SPILL spill;
+	STREAM stream;
+	long arcs, count;
+
+	if(open_spill(&spill, directory) != 0) {
+		return OUTPUT_FAILURE;
+	}
+
+	set_arc_sink(ctx, spill_arcs, (void *)&spill, ARC_BLOCK);
+	arcs = netgen(ctx, seed, parms);
+	set_arc_sink(ctx, NULL, NULL, 0);
+	if(arcs < 0) {
+		close_spill(&spill);
+		return arcs;
+	}
+
+	stream.kind = problem_kind(parms);
+	if(rewind_spill(&spill) != 0 || write_header(fout, ctx, seed, problem, stream.kind, arcs) != 0 ||
+	   open_output(&stream.out, fout) != 0) {
+		close_spill(&spill);
+		return OUTPUT_FAILURE;
+	}
+
+	while((count = read_spill(&spill, ctx)) > 0) {
+		if(print_arcs((void *)&stream, ctx, (ARC)count) != 0) {
+			break;
+		}
+	}
+	close_spill(&spill);
+
+	if(close_output(&stream.out) != 0 || count != 0 || ferror(fout)) {
+		return OUTPUT_FAILURE;
+	}
+	return arcs;
+}
+
+
+/*** Generate a problem and print it, formatting and writing the arcs with
+ *** the given number of threads (all online processors if not positive)
+ *** while they are generated, through io_uring if uring is set and the
+ *** kernel allows it.  The stream must be a regular file, written from
+ *** its current position.  The context's sink is cleared afterwards.
+ *** Returns the number of arcs, a netgen() error code, or OUTPUT_FAILURE
+ *** if the file reports an error.
+ ***/
+long pipe_dimacs(FILE* fout, NETGEN_CONTEXT* ctx, long seed, long problem, long parms[], int threads, int uring)
+{
+	PIPELINE pipeline;
+	STREAM stream;
+	pthread_t* writers;
+	long arcs;
+	int i, rc, started = 0;
+
+	/* Learn the number of arcs and the supplies, for the header. */
+	if(ctx->fast) {
+		set_arc_sink(ctx, count_arcs, NULL, ARC_BLOCK);
+		arcs = netgen(ctx, seed, parms);
+		set_arc_sink(ctx, NULL, NULL, 0);
+	} else {
+		arcs = plan_shards(ctx, seed, parms);
+	}
+	if(arcs < 0) {
+		return arcs;
+	}
+
+	pipeline.kind = problem_kind(parms);
+	pipeline.uring = uring;
+	if(write_header(fout, ctx, seed, problem, pipeline.kind, arcs) != 0 || fflush(fout) != 0 ||
+	   (pipeline.base = ftello(fout)) < 0) {
+		return OUTPUT_FAILURE;
+	}
+	pipeline.fd = fileno(fout);
+
+	threads = pipe_threads(threads);
+	if((writers = (pthread_t*) calloc((size_t)threads, sizeof(pthread_t))) == NULL ||
+	   open_ring(&pipeline.ring, (unsigned long)(PIPE_SLOTS * threads + WRITES_DEPTH), PIPE_BLOCK_ARCS,
+	             (size_t)PIPE_BLOCK_ARCS * LINE_SPACE) != 0) {
+		free((void *)writers);
+		return OUTPUT_FAILURE;
+	}
+	for(i = 0; i < threads; i++) {
+		if(pthread_create(&writers[started], NULL, write_blocks, (void *)&pipeline) == 0) {
+			started++;
+		}
+	}
+
+	/* Generate the arcs again, into the ring, or print them if no writer runs. */
+	if(started > 0) {
+		set_arc_sink(ctx, ring_arcs, (void *)&pipeline.ring, PIPE_BLOCK_ARCS);
+	} else if(open_output(&stream.out, fout) == 0) {
+		stream.kind = pipeline.kind;
+		set_arc_sink(ctx, print_arcs, (void *)&stream, ARC_BLOCK);
+	} else {
+		free_ring(&pipeline.ring);
+		free((void *)writers);
+		return OUTPUT_FAILURE;
+	}
+	if(ctx->fast) {
+		arcs = netgen(ctx, seed, parms);
+	} else {
+		arcs = netgen_shard(ctx, seed, parms, 0, 1);
+	}
+	set_arc_sink(ctx, NULL, NULL, 0);
+
+	close_ring(&pipeline.ring);
+	for(i = 0; i < started; i++) {
+		pthread_join(writers[i], NULL);
+	}
+	if(started > 0) {
+		/* Leave the stream after the arcs, as if it had printed them. */
+		rc = ring_failed(&pipeline.ring) || fseeko(fout, pipeline.base + (off_t)pipeline.ring.placed, SEEK_SET) != 0;
+	} else {
+		rc = close_output(&stream.out) != 0 || ferror(fout);
+	}
+	if(rc != 0 && arcs >= 0) {
+		arcs = OUTPUT_FAILURE;
+	}
+	free_ring(&pipeline.ring);
+	free((void *)writers);
+	return arcs;
+}
+
+
+/*** Memory pipe_dimacs holds besides the context, in bytes, with the
+ *** given number of writer threads: the blocks of its ring, their arcs
+ *** and the text they are formatted into.
+ ***/
+size_t pipe_space(int threads)
+{
+	size_t slots = (size_t)(PIPE_SLOTS * pipe_threads(threads) + WRITES_DEPTH);
+
+	return slots * PIPE_BLOCK_ARCS * (2 * sizeof(NODE) + sizeof(CAPACITY) + sizeof(COST) + LINE_SPACE);
+}
+
+
+/*** Generate one of several shards of a problem and print it, streaming
+ *** the arcs as stream_dimacs does.  The first shard also gets the header,
+ *** so that the shards' files, put end to end, are the file write_dimacs
+ *** prints; plan_shards supplies the arc count and the final supplies
+ *** without a second run.  Returns the number of arcs in the shard, a
+ *** netgen() error code, or OUTPUT_FAILURE.
+ ***/
+long write_dimacs_shard(FILE* fout, NETGEN_CONTEXT* ctx, long seed, long problem, long parms[], int shard, int shards)
+{
+	STREAM stream;
+	long arcs;
+
+	if((arcs = plan_shards(ctx, seed, parms)) < 0) {
+		return arcs;
+	}
+
+	stream.kind = problem_kind(parms);
+	if(shard == 0 && write_header(fout, ctx, seed, problem, stream.kind, arcs) != 0) {
+		return OUTPUT_FAILURE;
+	}
+	if(open_output(&stream.out, fout) != 0) {
+		return OUTPUT_FAILURE;
+	}
+
+	set_arc_sink(ctx, print_arcs, (void *)&stream, ARC_BLOCK);
+	arcs = netgen_shard(ctx, seed, parms, shard, shards);
+	set_arc_sink(ctx, NULL, NULL, 0);
+
+	if(close_output(&stream.out) != 0 || ferror(fout)) {
+		return arcs < 0 ? arcs : OUTPUT_FAILURE;
+	}
+	return arcs;
+}
+
+
+/*** Print the network held by a context into the named file, formatting
+ *** the arcs with the given number of threads (all online processors if
+ *** not positive).  The file holds the same bytes write_dimacs would
+ *** print.  Returns zero, or EOF if the file cannot be written.
+ ***/
+int write_dimacs_mapped(const char* filename, NETGEN_CONTEXT* ctx, long seed, long problem, int threads)
+{
+	int kind = problem_kind(ctx->parms);
+	ARC arcs = ctx->arc_count;
+	SLICE* slices;
+	FILE* header;
+	char* text = NULL;
+	size_t text_length = 0;
+	size_t total;
+	char* map;
+	int fd, i, rc = EOF;
+
+	/* Print the comments, problem line and node lines into memory. */
+	if((header = open_memstream(&text, &text_length)) == NULL) {
+		return EOF;
+	}
+	if(write_header(header, ctx, seed, problem, kind, (long)arcs) != 0 || ferror(header)) {
+		fclose(header);
+		free((void *)text);
+		return EOF;
+	}
+	fclose(header);
+
+	/* Measure each thread's share of the arc lines. */
+	if(threads <= 0) {
+		threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+	}
+	if(threads <= 0) {
+		threads = 1;
+	}
+	if((ARC)threads > arcs / 4096 + 1) {	/* not worth a thread per few arcs */
+		threads = (int)(arcs / 4096 + 1);
+	}
+	if((slices = (SLICE*) calloc((size_t)threads, sizeof(SLICE))) == NULL) {
+		free((void *)text);
+		return EOF;
+	}
+	for(i = 0; i < threads; i++) {
+		slices[i].ctx = ctx;
+		slices[i].kind = kind;
+		slices[i].first = arcs / threads * i + ((ARC)i < arcs % threads ? (ARC)i : arcs % threads);
+		slices[i].last = slices[i].first + arcs / threads + ((ARC)i < arcs % threads);
+	}
+	run_slices(slices, threads, measure_slice);
+
+	/* Lay out the file and let every thread format its share in place. */
+	total = text_length;
+	for(i = 0; i < threads; i++) {
+		total += slices[i].length;
+	}
+
+	if((fd = open(filename, O_RDWR | O_CREAT | O_TRUNC, 0666)) < 0) {
+		goto CLEANUP;
+	}
+	if(posix_fallocate(fd, 0, (off_t)total) != 0 && ftruncate(fd, (off_t)total) != 0) {
+		close(fd);
+		goto CLEANUP;
+	}
+	map = (char*) mmap(NULL, total, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if(map == MAP_FAILED) {
+		close(fd);
+		goto CLEANUP;
+	}
+
+	memcpy(map, text, text_length);
+	slices[0].start = map + text_length;
+	for(i = 1; i < threads; i++) {
+		slices[i].start = slices[i-1].start + slices[i-1].length;
+	}
+	run_slices(slices, threads, format_slice);
+
+	rc = 0;
+	if(munmap(map, total) != 0) {
+		rc = EOF;
+	}
+	if(close(fd) != 0) {
+		rc = EOF;
+	}
+
+CLEANUP:
+	free((void *)slices);
+	free((void *)text);
+	return rc;
+}
+
+
+/*** Print the network held by a context to a stream as gzip-compressed
+ *** DIMACS text, deflating chunks of arcs with the given number of threads
+ *** (all online processors if not positive).  The stream uncompresses to
+ *** the bytes write_dimacs would print.  Returns zero, or EOF if the
+ *** stream reports an error or memory runs out.
+ ***/
+int write_dimacs_gzip(FILE* fout, NETGEN_CONTEXT* ctx, long seed, long problem, int threads)
+{
+	COMPRESSOR comp;
+	MEMBER header;
+	MEMBER* member;
+	z_stream zs;
+	FILE* mem;
+	char* text = NULL;
+	size_t text_length = 0;
+	pthread_t* workers = NULL;
+	unsigned long k;
+	int i, started = 0, rc = 0;
+
+	memset(&comp, 0, sizeof(comp));
+	memset(&header, 0, sizeof(header));
+	memset(&zs, 0, sizeof(zs));
+	comp.ctx = ctx;
+	comp.kind = problem_kind(ctx->parms);
+	comp.chunks = (ctx->arc_count + GZIP_CHUNK_ARCS - 1) / GZIP_CHUNK_ARCS;
+	if(deflateInit2(&zs, GZIP_LEVEL, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+		return EOF;
+	}
+
+	/* The comments, problem line and node lines make the first member. */
+	if((mem = open_memstream(&text, &text_length)) == NULL) {
+		deflateEnd(&zs);
+		return EOF;
+	}
+	if(write_header(mem, ctx, seed, problem, comp.kind, (long)ctx->arc_count) != 0 || ferror(mem)) {
+		rc = EOF;
+	}
+	fclose(mem);
+	if(rc != 0 || deflate_member(&zs, text, text_length, &header) != 0 ||
+	   fwrite(header.data, 1, header.length, fout) != header.length) {
+		rc = EOF;
+	}
+	free((void *)text);
+	free((void *)header.data);
+	if(rc != 0 || comp.chunks == 0) {
+		deflateEnd(&zs);
+		return rc;
+	}
+
+	if(threads <= 0) {
+		threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+	}
+	if(threads <= 0) {
+		threads = 1;
+	}
+	if((unsigned long)threads > comp.chunks) {
+		threads = (int)comp.chunks;
+	}
+	comp.slots = GZIP_SLOTS * threads;
+	comp.members = (MEMBER*) calloc((size_t)comp.slots, sizeof(MEMBER));
+	workers = (pthread_t*) calloc((size_t)threads, sizeof(pthread_t));
+	if(comp.members == NULL || workers == NULL) {
+		rc = EOF;
+		goto CLEANUP;
+	}
+	for(i = 0; i < comp.slots; i++) {
+		comp.members[i].chunk = (unsigned long)i;
+		if((comp.members[i].text = (char*) malloc((size_t)GZIP_CHUNK_ARCS * LINE_SPACE)) == NULL) {
+			rc = EOF;
+			goto CLEANUP;
+		}
+	}
+	pthread_mutex_init(&comp.lock, NULL);
+	pthread_cond_init(&comp.ready, NULL);
+	pthread_cond_init(&comp.written, NULL);
+
+	for(i = 0; i < threads; i++) {
+		if(pthread_create(&workers[started], NULL, compress_chunks, (void *)&comp) == 0) {
+			started++;
+		}
+	}
+
+	/* Write the members in order, freeing each slot for a later chunk. */
+	for(k = 0; k < comp.chunks; k++) {
+		member = &comp.members[k % comp.slots];
+		if(started == 0) {
+			member->ready = compress_chunk(&comp, &zs, member) == 0;
+		}
+		pthread_mutex_lock(&comp.lock);
+		while(!member->ready && !comp.failed) {
+			pthread_cond_wait(&comp.ready, &comp.lock);
+		}
+		pthread_mutex_unlock(&comp.lock);
+		if(!member->ready || fwrite(member->data, 1, member->length, fout) != member->length) {
+			rc = EOF;
+		}
+		pthread_mutex_lock(&comp.lock);
+		if(rc != 0) {
+			comp.failed = 1;
+		}
+		member->ready = 0;
+		member->chunk += (unsigned long)comp.slots;
+		pthread_cond_broadcast(&comp.written);
+		pthread_mutex_unlock(&comp.lock);
+		if(rc != 0) {
+			break;
+		}
+	}
+
+	for(i = 0; i < started; i++) {
+		pthread_join(workers[i], NULL);
+	}
+	pthread_cond_destroy(&comp.written);
+	pthread_cond_destroy(&comp.ready);
+	pthread_mutex_destroy(&comp.lock);
+
+CLEANUP:
+	if(comp.members != NULL) {
+		for(i = 0; i < comp.slots; i++) {
+			free((void *)comp.members[i].text);
+			free((void *)comp.members[i].data);
+		}
+	}
+	free((void *)comp.members);
+	free((void *)workers);
+	deflateEnd(&zs);
+	return rc;
+}
+
+
+/*** Decide which kind of problem the parameters describe. */
+
+int problem_kind(long parms[])
+{
+	if((SOURCES - TSOURCES) + (SINKS - TSINKS) == NODES && (SOURCES - TSOURCES) == (SINKS - TSINKS) && SOURCES == SUPPLY) {
+		return ASSIGNMENT;
+	} else if (MINCOST == 1 && MAXCOST == 1) {
+		return MAXIMUM_FLOW;
+	}
+	return MINIMUM_COST;
+}
+
+
+/*** Print the comment block, the problem line and the node lines.
+ *** Returns zero, or EOF on a write error.
+ ***/
+static int write_header(FILE* fout, NETGEN_CONTEXT* ctx, long seed, long problem, int kind, long arcs)
+{
+	long* parms = ctx->parms;
+	OUTPUT out;
+	NODE i;
+	char* p;
+
+	fprintf(fout, "c NETGEN flow network generator (C version)\n");
+	fprintf(fout, "c  Problem %2ld input parameters\n", problem);
+	fprintf(fout, "c  ---------------------------\n");
+	fprintf(fout, "c   Random seed:          %10ld\n",   seed);
+	fprintf(fout, "c   Number of nodes:      %10ld\n",   NODES);
+	fprintf(fout, "c   Source nodes:         %10ld\n",   SOURCES);
+	fprintf(fout, "c   Sink nodes:           %10ld\n",   SINKS);
+	fprintf(fout, "c   Number of arcs:       %10ld\n",   DENSITY);
+	fprintf(fout, "c   Minimum arc cost:     %10ld\n",   MINCOST);
+	fprintf(fout, "c   Maximum arc cost:     %10ld\n",   MAXCOST);
+	fprintf(fout, "c   Total supply:         %10ld\n",   SUPPLY);
+	fprintf(fout, "c   Transshipment -\n");
+	fprintf(fout, "c     Sources:            %10ld\n",   TSOURCES);
+	fprintf(fout, "c     Sinks:              %10ld\n",   TSINKS);
+	fprintf(fout, "c   Skeleton arcs -\n");
+	fprintf(fout, "c     With max cost:      %10ld%%\n", HICOST);
+	fprintf(fout, "c     Capacitated:        %10ld%%\n", CAPACITATED);
+	fprintf(fout, "c   Minimum arc capacity: %10ld\n",   MINCAP);
+	fprintf(fout, "c   Maximum arc capacity: %10ld\n",   MAXCAP);
+	if(ctx->fast) {
+		fprintf(fout, "c  Generated in fast mode\n");
+	}
+
+	switch(kind) {
+		case ASSIGNMENT:
+			fprintf(fout, "c\n");
+			fprintf(fout, "c  *** Assignment ***\n");
+			fprintf(fout, "c\n");
+			fprintf(fout, "p asn %ld %ld\n", NODES, arcs);
+			break;
+		case MAXIMUM_FLOW:
+			fprintf(fout, "c\n");
+			fprintf(fout, "c  *** Maximum flow ***\n");
+			fprintf(fout, "c\n");
+			fprintf(fout, "p max %ld %ld\n", NODES, arcs);
+			break;
+		default:
+			fprintf(fout, "c\n");
+			fprintf(fout, "c  *** Minimum cost flow ***\n");
+			fprintf(fout, "c\n");
+			fprintf(fout, "p min %ld %ld\n", NODES, arcs);
+			break;
+	}
+
+	if(open_output(&out, fout) != 0) {
+		return EOF;
+	}
+	for(i = 0; i < (NODE)NODES; i++) {
+		if(B[i] == 0 || (kind == ASSIGNMENT && B[i] < 0)) {
+			continue;
+		}
+		ROOM(&out);
+		p = PUT(out.next, "n ");
+		p = put_unsigned(p, i + 1);
+		switch(kind) {
+			case ASSIGNMENT:
+				break;
+			case MAXIMUM_FLOW:
+				p = B[i] > 0 ? PUT(p, " s") : PUT(p, " t");
+				break;
+			default:
+				*p++ = ' ';
+				p = put_long(p, B[i]);
+				break;
+		}
+		*p++ = '\n';
+		out.next = p;
+	}
+	return close_output(&out);
+}
+
+
+/*** Attach a fresh buffer to a stream.  Returns zero, or EOF if no
+ *** buffer can be allocated.
+ ***/
+static int open_output(OUTPUT* out, FILE* fout)
+{
+	out->fout = fout;
+	out->failed = 0;
+	out->base = out->next = (char*) malloc(OUTPUT_SPACE);
+	out->limit = out->base + OUTPUT_SPACE - LINE_SPACE;
+	return out->base ? 0 : EOF;
+}
+
+
+/*** Hand the buffered lines to the stream. */
+
+static void flush_output(OUTPUT* out)
+{
+	size_t length = (size_t)(out->next - out->base);
+
+	if(length > 0 && fwrite(out->base, 1, length, out->fout) != length) {
+		out->failed = 1;
+	}
+	out->next = out->base;
+}
+
+
+/*** Flush and release the buffer.  Returns zero, or EOF on a write error. */
+
+static int close_output(OUTPUT* out)
+{
+	flush_output(out);
+	free((void *)out->base);
+	out->base = out->next = out->limit = NULL;
+	return out->failed ? EOF : 0;
+}
+
+
+/*** Emit "a" lines carrying costs for the first arcs of the arrays. */
+
+static void emit_asn(OUTPUT* out, NETGEN_CONTEXT* ctx, ARC arcs)
+{
+	ARC a;
+	char* p;
+
+	for(a = 0; a < arcs; a++) {
+		ROOM(out);
+		p = out->next;
+		PUT_ASN_ARC(p, a);
+		out->next = p;
+	}
+}
+
+
+/*** Emit "a" lines carrying capacities. */
+
+static void emit_max(OUTPUT* out, NETGEN_CONTEXT* ctx, ARC arcs)
+{
+	ARC a;
+	char* p;
+
+	for(a = 0; a < arcs; a++) {
+		ROOM(out);
+		p = out->next;
+		PUT_MAX_ARC(p, a);
+		out->next = p;
+	}
+}
+
+
+/*** Emit "a" lines with a zero lower bound, capacity and cost. */
+
+static void emit_min(OUTPUT* out, NETGEN_CONTEXT* ctx, ARC arcs)
+{
+	ARC a;
+	char* p;
+
+	for(a = 0; a < arcs; a++) {
+		ROOM(out);
+		p = out->next;
+		PUT_MIN_ARC(p, a);
+		out->next = p;
+	}
+}
+
+
+/*** Arc sink for the first run of stream_dimacs: the arcs are dropped,
+ *** netgen() counts them.
+ ***/
+static int count_arcs(void* data, NETGEN_CONTEXT* ctx, ARC arcs)
+{
+	(void)data;
+	(void)ctx;
+	(void)arcs;
+	return 0;
+}
+
+
+/*** Arc sink for the second run of stream_dimacs: print the block. */
+
+static int print_arcs(void* data, NETGEN_CONTEXT* ctx, ARC arcs)
+{
+	STREAM* stream = (STREAM*)data;
+
+	switch(stream->kind) {
+		case ASSIGNMENT:
+			emit_asn(&stream->out, ctx, arcs);
+			break;
+		case MAXIMUM_FLOW:
+			emit_max(&stream->out, ctx, arcs);
+			break;
+		default:
+			emit_min(&stream->out, ctx, arcs);
+			break;
+	}
+
+	return stream->out.failed ? EOF : 0;
+}
+
+
+/*** Thread body: add up the lengths of the arc lines of a slice. */
+
+static void* measure_slice(void* arg)
+{
+	SLICE* slice = (SLICE*)arg;
+	NETGEN_CONTEXT* ctx = slice->ctx;
+	size_t length = 0;
+	ARC a;
+
+	switch(slice->kind) {
+		case ASSIGNMENT:
+			for(a = slice->first; a < slice->last; a++) {
+				length += ASN_ARC_LENGTH(a);
+			}
+			break;
+		case MAXIMUM_FLOW:
+			for(a = slice->first; a < slice->last; a++) {
+				length += MAX_ARC_LENGTH(a);
+			}
+			break;
+		default:
+			for(a = slice->first; a < slice->last; a++) {
+				length += MIN_ARC_LENGTH(a);
+			}
+			break;
+	}
+
+	slice->length = length;
+	return NULL;
+}
+
+
+/*** Format the arc lines of arcs first to last-1 at p, and return the
+ *** position following them.
+ ***/
+static char* format_arcs(char* p, NETGEN_CONTEXT* ctx, int kind, ARC first, ARC last)
+{
+	ARC a;
+
+	switch(kind) {
+		case ASSIGNMENT:
+			for(a = first; a < last; a++) {
+				PUT_ASN_ARC(p, a);
+			}
+			break;
+		case MAXIMUM_FLOW:
+			for(a = first; a < last; a++) {
+				PUT_MAX_ARC(p, a);
+			}
+			break;
+		default:
+			for(a = first; a < last; a++) {
+				PUT_MIN_ARC(p, a);
+			}
+			break;
+	}
+
+	return p;
+}
+
+
+/*** Thread body: format the arc lines of a slice where they belong. */
+
+static void* format_slice(void* arg)
+{
+	SLICE* slice = (SLICE*)arg;
+
+	format_arcs(slice->start, slice->ctx, slice->kind, slice->first, slice->last);
+	return NULL;
+}
+
+
+/*** Run a thread body over every slice, the first one on the calling
+ *** thread, and wait for all of them.  A slice whose thread cannot be
+ *** started is run by the caller.
+ ***/
+static void run_slices(SLICE* slices, int count, void* (*body)(void*))
+{
+	int i;
+
+	for(i = 1; i < count; i++) {
+		slices[i].started = pthread_create(&slices[i].thread, NULL, body, (void *)&slices[i]) == 0;
+	}
+	body((void *)&slices[0]);
+	for(i = 1; i < count; i++) {
+		if(slices[i].started) {
+			pthread_join(slices[i].thread, NULL);
+		} else {
+			body((void *)&slices[i]);
+		}
+	}
+}
+
+
+/*** Deflate text into a gzip member of its own, growing the member's
+ *** buffer as needed.  Returns zero, or EOF if out of memory.
+ ***/
+static int deflate_member(z_stream* zs, const char* text, size_t length, MEMBER* member)
+{
+	size_t space;
+	unsigned char* data;
+
+	if(deflateReset(zs) != Z_OK) {
+		return EOF;
+	}
+	space = (size_t)deflateBound(zs, (uLong)length);
+	if(space > member->data_space) {
+		if((data = (unsigned char*) realloc(member->data, space)) == NULL) {
+			return EOF;
+		}
+		member->data = data;
+		member->data_space = space;
+	}
+
+	zs->next_in = (Bytef*)text;
+	zs->avail_in = (uInt)length;
+	zs->next_out = member->data;
+	zs->avail_out = (uInt)member->data_space;
+	if(deflate(zs, Z_FINISH) != Z_STREAM_END) {
+		return EOF;
+	}
+	member->length = member->data_space - zs->avail_out;
+	return 0;
+}
+
+
+/*** Format and deflate the chunk a slot is waiting for.  Returns zero,
+ *** or EOF if out of memory.
+ ***/
+static int compress_chunk(COMPRESSOR* comp, z_stream* zs, MEMBER* member)
+{
+	NETGEN_CONTEXT* ctx = comp->ctx;
+	ARC first = (ARC)member->chunk * GZIP_CHUNK_ARCS;
+	ARC last = first + GZIP_CHUNK_ARCS < ctx->arc_count ? first + GZIP_CHUNK_ARCS : ctx->arc_count;
+	char* end;
+
+	end = format_arcs(member->text, ctx, comp->kind, first, last);
+	return deflate_member(zs, member->text, (size_t)(end - member->text), member);
+}
+
+
+/*** Thread body: take the next chunk, wait for its slot to be written,
+ *** and fill it, until no chunk is left.
+ ***/
+static void* compress_chunks(void* arg)
+{
+	COMPRESSOR* comp = (COMPRESSOR*)arg;
+	MEMBER* member;
+	z_stream zs;
+	unsigned long k;
+	int initialized, ok;
+
+	memset(&zs, 0, sizeof(zs));
+	initialized = deflateInit2(&zs, GZIP_LEVEL, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+
+	pthread_mutex_lock(&comp->lock);
+	if(!initialized) {
+		comp->failed = 1;
+		pthread_cond_broadcast(&comp->ready);
+	}
+	while(!comp->failed && comp->next < comp->chunks) {
+		k = comp->next++;
+		member = &comp->members[k % comp->slots];
+		while((member->chunk != k || member->ready || member->busy) && !comp->failed) {
+			pthread_cond_wait(&comp->written, &comp->lock);
+		}
+		if(comp->failed) {
+			break;
+		}
+		member->busy = 1;
+		pthread_mutex_unlock(&comp->lock);
+
+		ok = compress_chunk(comp, &zs, member) == 0;
+
+		pthread_mutex_lock(&comp->lock);
+		member->busy = 0;
+		if(ok) {
+			member->ready = 1;
+		} else {
+			comp->failed = 1;
+		}
+		pthread_cond_broadcast(&comp->ready);
+	}
+	pthread_mutex_unlock(&comp->lock);
+
+	if(initialized) {
+		deflateEnd(&zs);
+	}
+	return NULL;
+}
+
+
+/*** Thread body of pipe_dimacs: take blocks from the ring, format them
+ *** and queue their writes, giving each block back once it is written.
+ *** When the ring is empty, the writes in flight are waited for before
+ *** the producer is: their blocks may be the ones it needs.  After a
+ *** failure, blocks are still taken and placed, but not written.
+ ***/
+static void* write_blocks(void* arg)
+{
+	PIPELINE* pipeline = (PIPELINE*)arg;
+	WRITES writes;
+	BLOCK* block;
+	size_t length, offset;
+
+	open_writes(&writes, pipeline->fd, pipeline->uring);
+	for(;;) {
+		if((block = take_block(&pipeline->ring, writes.queued == 0)) == NULL) {
+			if(writes.queued == 0 || finish_write(&pipeline->ring, &writes) != 0) {
+				break;
+			}
+			continue;
+		}
+		if(ring_failed(&pipeline->ring)) {
+			place_block(&pipeline->ring, block, 0);
+			release_block(&pipeline->ring, block);
+			continue;
+		}
+		length = (size_t)(format_arcs(block->text, &block->view, pipeline->kind, 0, block->arcs) - block->text);
+		offset = place_block(&pipeline->ring, block, length);
+
+		if(writes.queued == WRITES_DEPTH && finish_write(&pipeline->ring, &writes) != 0) {
+			break;
+		}
+		queue_write(&writes, block->text, length, pipeline->base + (off_t)offset, (void *)block);
+		while((block = (BLOCK*)reap_write(&writes, 0)) != NULL) {
+			release_block(&pipeline->ring, block);
+		}
+		if(writes.failed) {
+			fail_ring(&pipeline->ring);
+		}
+	}
+
+	if(close_writes(&writes) != 0) {
+		fail_ring(&pipeline->ring);
+	}
+	return NULL;
+}
+
+
+/*** Wait for one of a writer's queued writes and give its block back.
+ *** Returns zero, or EOF if the kernel reports none, the ring then
+ *** failing so that the producer stops.
+ ***/
+static int finish_write(RING* ring, WRITES* writes)
+{
+	BLOCK* block;
+
+	if((block = (BLOCK*)reap_write(writes, 1)) == NULL) {
+		fail_ring(ring);
+		return EOF;
+	}
+	release_block(ring, block);
+	return 0;
+}
+
+
+/*** Number of writer threads of the pipeline: the given number, or all
+ *** online processors if not positive.
+ ***/
+static int pipe_threads(int threads)
+{
+	if(threads <= 0) {
+		threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+	}
+	return threads > 0 ? threads : 1;
+}
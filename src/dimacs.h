@@ -0,0 +1,27 @@
+#ifndef DIMACS_H
+#define DIMACS_H 1
+
+#include <stdio.h>
+
+#include "netgen.h"
+
+/*** Constants Definition ***/
+#define ASSIGNMENT		1		/* kinds of problem, as on the DIMACS problem line */
+#define MAXIMUM_FLOW	2
+#define MINIMUM_COST	3
+
+/*** Methods Declaration ***/
+int write_dimacs(FILE*, NETGEN_CONTEXT*, long, long);	/* print a generated problem in DIMACS format */
+int write_dimacs_mapped(const char*, NETGEN_CONTEXT*, long, long, int);	/* same, formatted in parallel into a mapped file */
+int write_dimacs_gzip(FILE*, NETGEN_CONTEXT*, long, long, int);	/* same, gzip-compressed on several threads */
+long stream_dimacs(FILE*, NETGEN_CONTEXT*, long, long, long*);	/* generate and print, streaming the arcs */
+long spill_dimacs(FILE*, NETGEN_CONTEXT*, long, long, long*, const char*);	/* same, the arcs spilled to disk */
+long pipe_dimacs(FILE*, NETGEN_CONTEXT*, long, long, long*, int, int);	/* same, written by threads while generated */
+size_t pipe_space(int);					/* memory pipe_dimacs holds besides the context */
+long write_dimacs_shard(FILE*, NETGEN_CONTEXT*, long, long, long*, int, int);	/* same, for one shard of the arcs */
+int problem_kind(long*);				/* kind of problem a set of parameters makes */
+int count_digits(unsigned long);		/* number of decimal digits of a value      */
+char* put_unsigned(char*, unsigned long);	/* format a value, returning the next position */
+char* put_long(char*, long);			/* same for a signed value                  */
+
+#endif /* DIMACS_H */
@@ -0,0 +1,262 @@
+/*** dimacs2bin.c - convert a DIMACS file into the binary format of binary.h,
+ *** or with -z into the packed format of packed.h */
+
+/*** Reads a problem written by the generator (or any asn, max or min file
+ *** in DIMACS format) and saves its arrays in the binary format, so that
+ *** archived instances need not be parsed again.  The seed, problem number
+ *** and parameters are taken from the comment block NETGEN writes at the
+ *** top of its files, when there is one.  Values the file leaves out are
+ *** stored as its kind implies them, and the header flags say so: unit
+ *** capacities for an assignment, zero costs and supplies of +1 (s) or
+ *** -1 (t) for a maximum flow.
+ ***/
+
+/*** System Interfaces ***/
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+/*** NETGEN Interfaces ***/
+#include "netgen.h"
+#include "dimacs.h"
+#include "binary.h"
+#include "packed.h"
+
+/*** Local Constants ***/
+#define USAGE "Usage: ./dimacs2bin [-z] DIMACS BINARY\n"
+
+#define SEED_LABEL	-1
+
+/*** Local Types ***/
+typedef struct label {
+	const char* text;				/* as printed by write_header            */
+	int parm;						/* parameter set, or SEED_LABEL          */
+} LABEL;
+
+static const LABEL labels[] = {
+	{ "Random seed:", SEED_LABEL },
+	{ "Number of nodes:", 0 },
+	{ "Source nodes:", 1 },
+	{ "Sink nodes:", 2 },
+	{ "Number of arcs:", 3 },
+	{ "Minimum arc cost:", 4 },
+	{ "Maximum arc cost:", 5 },
+	{ "Total supply:", 6 },
+	{ "Sources:", 7 },
+	{ "Sinks:", 8 },
+	{ "With max cost:", 9 },
+	{ "Capacitated:", 10 },
+	{ "Minimum arc capacity:", 11 },
+	{ "Maximum arc capacity:", 12 }
+};
+
+#define LABELS	(int)(sizeof(labels) / sizeof(labels[0]))
+
+/*** Local Functions ***/
+static void fail(const char*, unsigned long);
+static void read_comment(const char*, BINARY_HEADER*, int*);
+
+
+int
+main(int argc, char **argv)
+{
+	FILE* fin;
+	BINARY_HEADER header;
+	char* line = NULL;
+	size_t space = 0;
+	unsigned long number = 0;
+	char kind[16], value[32];
+	NODE* from = NULL;
+	NODE* to = NULL;
+	CAPACITY* u = NULL;
+	COST* c = NULL;
+	CAPACITY* b = NULL;
+	unsigned long nodes = 0, arcs = 0, v, w;
+	ARC a = 0;
+	long low, x, y;
+	char* p;
+	int found = 0, packed = 0, opt;
+	NODE i;
+
+	while((opt = getopt(argc, argv, "z")) != -1) {
+		switch(opt) {
+			case 'z':
+				packed = 1;
+				break;
+			default:
+				fprintf(stderr, USAGE);
+				exit(EXIT_FAILURE);
+		}
+	}
+	if(argc - optind != 2) {
+		fprintf(stderr, USAGE);
+		exit(EXIT_FAILURE);
+	}
+	if((fin = fopen(argv[optind], "r")) == NULL) {
+		fprintf(stderr, "Unable to open input file.\n");
+		exit(EXIT_FAILURE);
+	}
+
+	memset(&header, 0, sizeof(header));
+	while(getline(&line, &space, fin) != -1) {
+		number++;
+		switch(line[0]) {
+			case 'c':
+				if(b == NULL) {
+					read_comment(line, &header, &found);
+				}
+				break;
+			case 'p':
+				if(b != NULL || sscanf(line, "p %15s %lu %lu", kind, &nodes, &arcs) != 3) {
+					fail("bad problem line", number);
+				}
+				if(strcmp(kind, "asn") == 0) {
+					header.kind = ASSIGNMENT;
+					header.flags |= BINARY_EXACT_COSTS | BINARY_EXACT_SUPPLIES;
+				} else if(strcmp(kind, "max") == 0) {
+					header.kind = MAXIMUM_FLOW;
+					header.flags |= BINARY_EXACT_CAPACITIES;
+				} else if(strcmp(kind, "min") == 0) {
+					header.kind = MINIMUM_COST;
+					header.flags |= BINARY_EXACT_CAPACITIES | BINARY_EXACT_COSTS | BINARY_EXACT_SUPPLIES;
+				} else {
+					fail("unknown kind of problem", number);
+				}
+				from = (NODE*) malloc((arcs ? arcs : 1) * sizeof(NODE));
+				to = (NODE*) malloc((arcs ? arcs : 1) * sizeof(NODE));
+				u = (CAPACITY*) malloc((arcs ? arcs : 1) * sizeof(CAPACITY));
+				c = (COST*) malloc((arcs ? arcs : 1) * sizeof(COST));
+				b = (CAPACITY*) calloc(nodes ? nodes : 1, sizeof(CAPACITY));
+				if(!from || !to || !u || !c || !b) {
+					error_exit(ALLOCATION_FAILURE);
+				}
+				break;
+			case 'n':
+				if(b == NULL || sscanf(line, "n %lu %31s", &v, value) < 1 || v < 1 || v > nodes) {
+					fail("bad node line", number);
+				}
+				if(header.kind == ASSIGNMENT) {
+					b[v - 1] = 1;
+				} else if(header.kind == MAXIMUM_FLOW) {
+					if(strcmp(value, "s") != 0 && strcmp(value, "t") != 0) {
+						fail("bad node line", number);
+					}
+					b[v - 1] = value[0] == 's' ? 1 : -1;
+				} else {
+					b[v - 1] = strtol(value, &p, 10);
+					if(*p != '\0') {
+						fail("bad node line", number);
+					}
+				}
+				break;
+			case 'a':
+				if(b == NULL || a == arcs) {
+					fail("unexpected arc line", number);
+				}
+				p = line + 1;
+				v = strtoul(p, &p, 10);
+				w = strtoul(p, &p, 10);
+				x = strtol(p, &p, 10);
+				if(v < 1 || v > nodes || w < 1 || w > nodes) {
+					fail("bad arc line", number);
+				}
+				from[a] = v;
+				to[a] = w;
+				switch(header.kind) {
+					case ASSIGNMENT:
+						u[a] = 1;
+						c[a] = x;
+						break;
+					case MAXIMUM_FLOW:
+						u[a] = x;
+						c[a] = 0;
+						break;
+					default:
+						low = x;
+						x = strtol(p, &p, 10);
+						y = strtol(p, &p, 10);
+						if(low != 0) {
+							fail("arc lower bounds are not supported", number);
+						}
+						u[a] = x;
+						c[a] = y;
+						break;
+				}
+				a++;
+				break;
+			default:
+				break;
+		}
+	}
+	free(line);
+	fclose(fin);
+
+	if(b == NULL || a != arcs) {
+		fail("arcs missing", number);
+	}
+	if(header.kind == ASSIGNMENT) {
+		for(i = 0; i < nodes; i++) {
+			if(b[i] == 0) {
+				b[i] = -1;
+			}
+		}
+	}
+	if(found == LABELS) {
+		header.flags |= BINARY_PARAMETERS;
+	}
+	header.nodes = nodes;
+	header.arcs = arcs;
+
+	if((packed ? save_packed(argv[optind + 1], &header, from, to, u, c, b)
+	           : save_binary(argv[optind + 1], &header, from, to, u, c, b)) != 0) {
+		error_exit(OUTPUT_FAILURE);
+	}
+
+	free(from);
+	free(to);
+	free(u);
+	free(c);
+	free(b);
+	exit(EXIT_SUCCESS);
+} /* END OF MAIN */
+
+
+/*** Report a malformed input line and exit. ***/
+static void fail(const char* problem, unsigned long number)
+{
+	fprintf(stderr, "Line %lu: %s.\n", number, problem);
+	exit(EXIT_FAILURE);
+}
+
+
+/*** Take the seed, problem number, a parameter or the fast mode note from
+ *** a line of NETGEN's comment block, counting the parameters found.
+ ***/
+static void read_comment(const char* line, BINARY_HEADER* header, int* found)
+{
+	const char* p;
+	long problem;
+	int i;
+
+	if(sscanf(line, "c Problem %ld input parameters", &problem) == 1) {
+		header->problem = problem;
+		return;
+	}
+	if(strstr(line, "Generated in fast mode") != NULL) {
+		header->flags |= BINARY_FAST;
+		return;
+	}
+	for(i = 0; i < LABELS; i++) {
+		if((p = strstr(line, labels[i].text)) == NULL) {
+			continue;
+		}
+		p += strlen(labels[i].text);
+		if(labels[i].parm == SEED_LABEL) {
+			header->seed = strtol(p, NULL, 10);
+		} else {
+			header->parms[labels[i].parm] = strtol(p, NULL, 10);
+		}
+		(*found)++;
+		return;
+	}
+}
@@ -0,0 +1,593 @@
+/*** fastgen.c - generate NETGEN networks in parallel */
+
+/*** netgen() must draw every random number of a network from the one
+ *** congruential sequence of the Fortran original, in the original order,
+ *** so generating a network is inherently serial.  netgen_fast builds
+ *** networks with the same structure instead: supplies spread over the
+ *** sources, skeleton chains of transshipment nodes hooked onto sinks,
+ *** skeleton arcs with HICOST percent of them at MAXCOST, and rubbish
+ *** arcs to random heads out of every node that had a turn in the
+ *** original.  Each random choice is drawn from a counter-based stream
+ *** keyed by the seed, the node it concerns and what it is for, so that
+ *** the work of different nodes can be spread over threads.  The networks
+ *** are not those of netgen(), but they depend only on the seed and the
+ *** parameters, never on the number of threads.
+ ***
+ *** Generation is planned serially first.  Supplies, chains and the sinks
+ *** hooked onto each chain take time proportional to the number of nodes
+ *** and decide the skeleton arcs out of every tail node.  The rubbish
+ *** arcs are then counted out to the nodes by the rules of pick_head,
+ *** which make each node's share depend on the arcs the earlier nodes
+ *** took; that pass is serial but does no more than one draw or so per
+ *** node.  With every node's arc count known, each node's arcs have a
+ *** fixed place in the network, and the threads generate the arcs of
+ *** consecutive runs of nodes directly into the arc arrays.
+ ***
+ *** With an arc sink, nodes are generated a window at a time, each window
+ *** holding as many nodes as fit in a block, and each window is handed
+ *** to the sink as soon as it is complete.
+ ***/
+
+#include <pthread.h>
+#include <unistd.h>
+
+#include "netgen.h"
+#include "trace.h"
+
+/*** Local constants */
+
+#define FAST_SUPPLY   1				/* purposes of the random streams       */
+#define FAST_CHAINS   2
+#define FAST_SINKS    3
+#define FAST_LIMIT    4
+#define FAST_ARCS     5
+
+#define FIRST_ENTRIES 1024			/* plan entries allocated at first      */
+
+/*** Internally useful types */
+
+typedef struct entry {
+	NODE tail;						/* node whose arcs these are            */
+	NODE source;					/* source of its chain, if any          */
+	ARC skeleton;					/* its first skeleton head in the plan  */
+	ARC skeleton_count;				/* and their number                     */
+	ARC limit;						/* rubbish arcs out of the node         */
+	ARC first;						/* position of its first arc            */
+} ENTRY;
+
+typedef struct plan {
+	long seed;
+	int assignment;					/* nonzero for an assignment problem    */
+	INDEX low;						/* smallest possible head of an arc     */
+	ENTRY* entries;					/* tail nodes, in the order of the arcs */
+	size_t entry_count;
+	size_t entry_space;
+	NODE* heads;					/* heads of the skeleton arcs           */
+	ARC head_count;
+	ARC head_space;
+	ARC arcs;						/* arcs in the network                  */
+} PLAN;
+
+typedef struct worker {
+	NETGEN_CONTEXT* ctx;
+	PLAN* plan;
+	INDEX_LIST candidates;			/* heads not yet used by the node       */
+	size_t first;					/* entries generated by this thread     */
+	size_t last;
+	long status;
+	pthread_t thread;
+	int started;
+} WORKER;
+
+
+/*** Private functions */
+
+static long plan_assignment(NETGEN_CONTEXT*, PLAN*);
+static long plan_network(NETGEN_CONTEXT*, PLAN*);
+static void plan_rubbish(NETGEN_CONTEXT*, PLAN*);
+static int add_entry(PLAN*, NODE, NODE);
+static int add_head(PLAN*, NODE);
+static long generate_windows(NETGEN_CONTEXT*, PLAN*);
+static void* generate_entries(void*);
+static void run_workers(WORKER*, int);
+
+
+/*** Local macros */
+
+#define MIN(x, y) ((x) < (y) ? (x) : (y))
+#define MAX(x, y) ((x) > (y) ? (x) : (y))
+
+
+/*** Generate a network with the context's fast mode threads.  Returns
+ *** the number of arcs or, as netgen() does, a negative error code.
+ ***/
+ARC netgen_fast(NETGEN_CONTEXT* ctx, long seed, long parms[])
+{
+	PLAN plan;
+	long rc;
+
+	if((rc = check_parms(seed, parms)) != 0) {
+		return rc;
+	}
+	choose_storage(ctx, parms);
+	if((rc = reserve_network(ctx, (NODE)NODES + 3, ctx->sink ? ctx->block : (ARC)DENSITY)) != 0) {
+		return rc;
+	}
+
+	ctx->parms = parms;
+	ctx->status = 0;
+	ctx->arc_count = 0;
+	ctx->arc_base = 0;
+	ctx->nodes_left = 0;
+
+	(void)memset((void *)&plan, 0, sizeof(PLAN));
+	plan.seed = seed;
+
+	TRACE_BEGIN(PHASE_FAST_PLAN);
+	if((SOURCES - TSOURCES) + (SINKS - TSINKS) == NODES &&
+      (SOURCES - TSOURCES) == (SINKS - TSINKS) &&
+       SOURCES == SUPPLY) {
+		rc = plan_assignment(ctx, &plan);
+	} else {
+		rc = plan_network(ctx, &plan);
+	}
+	if(rc == 0) {
+		plan_rubbish(ctx, &plan);
+	}
+	TRACE_END(PHASE_FAST_PLAN);
+	if(rc == 0) {
+		TRACE_BEGIN(PHASE_FAST_ARCS);
+		rc = generate_windows(ctx, &plan);
+		TRACE_END(PHASE_FAST_ARCS);
+	}
+
+	free((void *)plan.entries);
+	free((void *)plan.heads);
+	return rc ? rc : (long)ctx->arc_count;
+}
+
+
+/*** Plan an assignment problem: every source is matched with a distinct
+ *** sink by its skeleton arc.
+ ***/
+static long plan_assignment(NETGEN_CONTEXT* ctx, PLAN* plan)
+{
+	long* parms = ctx->parms;
+	RANDOM_STREAM stream;
+	INDEX_LIST skeleton;
+	NODE source;
+
+	for(source = 0; source < (NODE)NODES/2; source++) {
+		B[source] = 1;
+	}
+	for( ; source < (NODE)NODES; source++) {
+		B[source] = -1;
+	}
+
+	plan->assignment = 1;
+	plan->low = (INDEX)(SOURCES + 1);
+	if(reset_index_list(ctx->skeleton, plan->low, (INDEX)NODES) != 0) {
+		return ALLOCATION_FAILURE;
+	}
+	skeleton = ctx->skeleton;
+	set_stream(&stream, plan->seed, 0, FAST_CHAINS);
+	for(source = 1; source <= (NODE)NODES/2; source++) {
+		if(add_entry(plan, source, source) != 0 ||
+		   add_head(plan, choose_index(skeleton, (INDEX)streami(&stream, 1L, (long)index_size(skeleton)))) != 0) {
+			return ALLOCATION_FAILURE;
+		}
+	}
+
+	return 0;
+}
+
+
+/*** Plan a transportation, maximum flow or minimum cost flow problem:
+ *** supplies, skeleton chains and the sinks each chain feeds, as in
+ *** netgen(), leaving the skeleton arcs of every tail node in the plan.
+ ***/
+static long plan_network(NETGEN_CONTEXT* ctx, PLAN* plan)
+{
+	long* parms = ctx->parms;
+	NODE* pred = ctx->pred;
+	NODE* head = ctx->head;
+	NODE* tail = ctx->tail;
+	RANDOM_STREAM stream;
+	INDEX_LIST handle;
+	CAPACITY supply_per_source, supply_per_sink, partial_supply;
+	NODE i, j, k, it, node, source;
+	NODE sinks_per_source, chain_length, sort_count;
+	NODE* sinks;
+
+	plan->low = (INDEX)(SOURCES - TSOURCES + 1);
+
+	/* Spread the supply over the sources. */
+	(void)memset((void *)B, 0, NODES * sizeof(CAPACITY));
+	set_stream(&stream, plan->seed, 0, FAST_SUPPLY);
+	supply_per_source = SUPPLY / SOURCES;
+	for(i = 0; i < (NODE)SOURCES; i++) {
+		B[i] += (partial_supply = streami(&stream, 1L, (long)supply_per_source));
+		B[streami(&stream, 0L, (long)(SOURCES - 1))] += supply_per_source - partial_supply;
+	}
+	B[streami(&stream, 0L, (long)(SOURCES - 1))] += SUPPLY % SOURCES;
+
+	/* Divide the transshipment nodes among the sources' chains. */
+	for(i = 1; i <= (NODE)SOURCES; i++) {
+		pred[i] = i;
+	}
+	if(reset_index_list(ctx->skeleton, (INDEX)(SOURCES + 1), (INDEX)(NODES - SINKS)) == -2) {
+		return ALLOCATION_FAILURE;
+	}
+	handle = ctx->skeleton;
+	set_stream(&stream, plan->seed, 0, FAST_CHAINS);
+	source = 1;
+	for(i = NODES-SOURCES-SINKS; i > (NODE)(4*(NODES-SOURCES-SINKS)+9)/10; i--) {
+		node = choose_index(handle, (INDEX)streami(&stream, 1L, (long)index_size(handle)));
+		pred[node] = pred[source];
+		pred[source] = node;
+		if(++source > (NODE)SOURCES) {
+			source = 1;
+		}
+	}
+	for( ; i > 0; --i) {
+		node = choose_index(handle, (INDEX)streami(&stream, 1L, (long)index_size(handle)));
+		source = streami(&stream, 1L, SOURCES);
+		pred[node] = pred[source];
+		pred[source] = node;
+	}
+
+	/* Hook every chain onto its sinks and record its skeleton arcs,
+	 * sorted by tail.
+	 */
+	for(source = 1; source <= (NODE)SOURCES; source++) {
+		sort_count = 0;
+		node = pred[source];
+		while(node != source) {
+			sort_count++;
+			head[sort_count] = node;
+			node = tail[sort_count] = pred[node];
+		}
+
+		if((NODES-SOURCES-SINKS) == 0) {
+			sinks_per_source = SINKS/SOURCES + 1;
+		} else {
+			sinks_per_source = ((double) 2*sort_count*SINKS) / ((double) NODES-SOURCES-SINKS);
+		}
+		sinks_per_source = MAX(2, MIN(sinks_per_source, (NODE)SINKS));
+
+		if(reset_index_list(ctx->candidates, (INDEX)(NODES - SINKS), (INDEX)(NODES - 1)) == -2) {
+			return ALLOCATION_FAILURE;
+		}
+		handle = ctx->candidates;
+		if((sinks = (NODE*) malloc((sinks_per_source + index_size(handle)) * sizeof(NODE))) == NULL) {
+			return ALLOCATION_FAILURE;
+		}
+		set_stream(&stream, plan->seed, source, FAST_SINKS);
+		for(i = 0; i < sinks_per_source; i++) {
+			sinks[i] = choose_index(handle, (INDEX)streami(&stream, 1L, (long)index_size(handle)));
+		}
+		if(source == (NODE)SOURCES) {
+			while(index_size(handle) > 0) {
+				j = choose_index(handle, 1);
+				if(B[j] == 0) {
+					sinks[sinks_per_source++] = j;
+				}
+			}
+		}
+
+		chain_length = sort_count;
+		supply_per_sink = B[source-1] / sinks_per_source;
+		k = pred[source];
+		for(i = 0; i < sinks_per_source; i++) {
+			sort_count++;
+			partial_supply = streami(&stream, 1L, (long)supply_per_sink);
+			j = streami(&stream, 0L, (long)sinks_per_source - 1);
+			tail[sort_count] = k;
+			head[sort_count] = sinks[i] + 1;
+			B[sinks[i]] -= partial_supply;
+			B[sinks[j]] -= (supply_per_sink - partial_supply);
+			k = source;
+			for(j = streami(&stream, 1L, (long)chain_length); j > 0; j--) {
+				k = pred[k];
+			}
+		}
+		B[sinks[0]] -= (B[source-1] % sinks_per_source);
+		free((void *)sinks);
+
+		sort_skeleton(ctx, sort_count);
+		tail[sort_count+1] = 0;
+		for(i = 1; i <= sort_count; ) {
+			it = tail[i];
+			if(add_entry(plan, it, source) != 0) {
+				return ALLOCATION_FAILURE;
+			}
+			while(it == tail[i]) {
+				if(add_head(plan, head[i]) != 0) {
+					return ALLOCATION_FAILURE;
+				}
+				i++;
+			}
+		}
+	}
+
+	/* The transshipment sinks only have rubbish arcs. */
+	for(i = NODES - SINKS + 1; i <= (NODE)(NODES - SINKS + TSINKS); i++) {
+		if(add_entry(plan, i, 0) != 0) {
+			return ALLOCATION_FAILURE;
+		}
+	}
+
+	return 0;
+}
+
+
+/*** Decide how many rubbish arcs each planned node gets, by the rules
+ *** pick_head follows, and place every node's arcs.  The counts depend
+ *** on the arcs planned for the nodes before, so the plan runs through
+ *** the nodes in order, but each node draws from its own stream.
+ ***/
+static void plan_rubbish(NETGEN_CONTEXT* ctx, PLAN* plan)
+{
+	long* parms = ctx->parms;
+	long non_sources = NODES - SOURCES + TSOURCES;
+	long nodes_left = NODES - SINKS + TSINKS;
+	long remaining, available, limit, upper_bound;
+	RANDOM_STREAM stream;
+	ENTRY* entry;
+	size_t e;
+
+	plan->arcs = 0;
+	for(e = 0; e < plan->entry_count; e++) {
+		entry = &plan->entries[e];
+		entry->first = plan->arcs;
+		plan->arcs += entry->skeleton_count;
+
+		available = non_sources - (long)entry->skeleton_count - (entry->tail >= plan->low);
+		remaining = DENSITY - (long)plan->arcs;
+		nodes_left--;
+		limit = 0;
+		if(2 * nodes_left < remaining) {
+			if((remaining + non_sources - available - 1) / (nodes_left + 1) >= non_sources - 1) {
+				limit = non_sources;
+			} else {
+				set_stream(&stream, plan->seed, entry->tail, FAST_LIMIT);
+				upper_bound = 2 * (remaining / (nodes_left + 1) - 1);
+				do {
+					limit = streami(&stream, 1L, upper_bound);
+					if(nodes_left == 0) {
+						limit = remaining;
+					}
+				} while(((double) nodes_left * (non_sources - 1)) < ((double) remaining - limit));
+			}
+		}
+
+		entry->limit = (ARC)MAX(0, MIN(limit, available));
+		plan->arcs += entry->limit;
+	}
+}
+
+
+/*** Append a tail node to the plan.  Returns nonzero if out of memory. */
+
+static int add_entry(PLAN* plan, NODE tail, NODE source)
+{
+	ENTRY* entries;
+	ENTRY* entry;
+	size_t space;
+
+	if(plan->entry_count == plan->entry_space) {
+		space = plan->entry_space ? 2 * plan->entry_space : FIRST_ENTRIES;
+		if((entries = (ENTRY*) realloc((void *)plan->entries, space * sizeof(ENTRY))) == NULL) {
+			return 1;
+		}
+		plan->entries = entries;
+		plan->entry_space = space;
+	}
+
+	entry = &plan->entries[plan->entry_count++];
+	entry->tail = tail;
+	entry->source = source;
+	entry->skeleton = plan->head_count;
+	entry->skeleton_count = 0;
+	entry->limit = 0;
+	entry->first = 0;
+	return 0;
+}
+
+
+/*** Append a skeleton arc out of the last tail node planned.  Returns
+ *** nonzero if out of memory.
+ ***/
+static int add_head(PLAN* plan, NODE head)
+{
+	NODE* heads;
+	ARC space;
+
+	if(plan->head_count == plan->head_space) {
+		space = plan->head_space ? 2 * plan->head_space : FIRST_ENTRIES;
+		if((heads = (NODE*) realloc((void *)plan->heads, space * sizeof(NODE))) == NULL) {
+			return 1;
+		}
+		plan->heads = heads;
+		plan->head_space = space;
+	}
+
+	plan->heads[plan->head_count++] = head;
+	plan->entries[plan->entry_count - 1].skeleton_count++;
+	return 0;
+}
+
+
+/*** Generate the planned arcs.  Without a sink the arc arrays are made
+ *** to hold the whole network, which is then generated in one window;
+ *** with one, each window is filled with as many nodes as the arrays
+ *** hold and handed to the sink.  Within a window the nodes are divided
+ *** into runs with about as many arcs each, one run per thread.
+ ***/
+static long generate_windows(NETGEN_CONTEXT* ctx, PLAN* plan)
+{
+	WORKER* workers;
+	ARC most, arcs;
+	size_t e, first, last;
+	int threads, count, i;
+	long rc = 0;
+
+	most = 0;
+	for(e = 0; e < plan->entry_count; e++) {
+		most = MAX(most, plan->entries[e].skeleton_count + plan->entries[e].limit);
+	}
+	if((rc = reserve_network(ctx, 0, ctx->sink ? most : plan->arcs)) != 0) {
+		return rc;
+	}
+
+	if((threads = ctx->fast_threads) <= 0) {
+		threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+	}
+	if(threads <= 0) {
+		threads = 1;
+	}
+	if((size_t)threads > plan->entry_count) {
+		threads = plan->entry_count > 0 ? (int)plan->entry_count : 1;
+	}
+	if((workers = (WORKER*) calloc((size_t)threads, sizeof(WORKER))) == NULL) {
+		return ALLOCATION_FAILURE;
+	}
+	for(i = 0; i < threads; i++) {
+		workers[i].ctx = ctx;
+		workers[i].plan = plan;
+		if((workers[i].candidates = make_index_list((INDEX)1, (INDEX)1)) == NULL) {
+			rc = ALLOCATION_FAILURE;
+			goto CLEANUP;
+		}
+		use_index_engine(workers[i].candidates, ctx->engine);
+		use_index_pages(workers[i].candidates, ctx->pages);
+	}
+
+	for(first = 0; first < plan->entry_count; first = last) {
+		/* Take the nodes whose arcs fit in the arrays. */
+		ctx->arc_base = plan->entries[first].first;
+		for(last = first + 1; last < plan->entry_count; last++) {
+			if(plan->entries[last].first + plan->entries[last].skeleton_count + plan->entries[last].limit - ctx->arc_base > ctx->arc_space) {
+				break;
+			}
+		}
+		arcs = (last < plan->entry_count ? plan->entries[last].first : plan->arcs) - ctx->arc_base;
+
+		/* Give each thread a run of nodes starting past its share of arcs. */
+		count = (size_t)threads < last - first ? threads : (int)(last - first);
+		e = first;
+		for(i = 0; i < count; i++) {
+			workers[i].first = e;
+			while(e < last && plan->entries[e].first - ctx->arc_base < arcs / count * (ARC)(i + 1)) {
+				e++;
+			}
+			workers[i].last = i + 1 == count ? last : e;
+		}
+		run_workers(workers, count);
+		for(i = 0; i < count; i++) {
+			if(workers[i].status != 0) {
+				rc = workers[i].status;
+				goto CLEANUP;
+			}
+		}
+
+		ctx->arc_count = ctx->arc_base + arcs;
+		if(ctx->sink && arcs > 0 && ctx->sink(ctx->sink_data, ctx, arcs) != 0) {
+			rc = OUTPUT_FAILURE;
+			goto CLEANUP;
+		}
+	}
+	if(ctx->sink) {
+		ctx->arc_base = ctx->arc_count;
+	}
+
+CLEANUP:
+	for(i = 0; i < threads; i++) {
+		free_index_list(workers[i].candidates);
+	}
+	free((void *)workers);
+	return rc;
+}
+
+
+/*** Thread body: generate the arcs out of a run of planned nodes. */
+
+static void* generate_entries(void* arg)
+{
+	WORKER* worker = (WORKER*)arg;
+	NETGEN_CONTEXT* ctx = worker->ctx;
+	PLAN* plan = worker->plan;
+	long* parms = ctx->parms;
+	INDEX_LIST handle = worker->candidates;
+	RANDOM_STREAM stream;
+	ENTRY* entry;
+	NODE head;
+	CAPACITY cap;
+	COST cost;
+	ARC a, h, limit;
+	size_t e;
+
+	for(e = worker->first; e < worker->last; e++) {
+		entry = &plan->entries[e];
+		if(reset_index_list(handle, plan->low, (INDEX)NODES) == -2) {
+			worker->status = ALLOCATION_FAILURE;
+			return NULL;
+		}
+		remove_index(handle, (INDEX)entry->tail);
+		set_stream(&stream, plan->seed, entry->tail, FAST_ARCS);
+		a = entry->first - ctx->arc_base;
+
+		for(h = entry->skeleton; h < entry->skeleton + entry->skeleton_count; h++, a++) {
+			head = plan->heads[h];
+			remove_index(handle, (INDEX)head);
+			if(plan->assignment) {
+				cap = 1;
+				cost = streami(&stream, MINCOST, MAXCOST);
+			} else {
+				cap = SUPPLY;
+				if(streami(&stream, 1L, 100L) <= CAPACITATED) {
+					cap = MAX(B[entry->source-1], MINCAP);
+				}
+				cost = MAXCOST;
+				if(streami(&stream, 1L, 100L) > HICOST) {
+					cost = streami(&stream, MINCOST, MAXCOST);
+				}
+			}
+			STORE_ARC(a, entry->tail, head, cost, cap);
+		}
+
+		for(limit = entry->limit; limit > 0; limit--, a++) {
+			head = choose_index(handle, (INDEX)streami(&stream, 1L, (long)index_size(handle)));
+			cap = SUPPLY;
+			if(streami(&stream, 1L, 100L) <= CAPACITATED) {
+				cap = streami(&stream, MINCAP, MAXCAP);
+			}
+			cost = streami(&stream, MINCOST, MAXCOST);
+			STORE_ARC(a, entry->tail, head, cost, cap);
+		}
+	}
+
+	return NULL;
+}
+
+
+/*** Run the workers, the first one on the calling thread, and wait for
+ *** all of them.  A worker whose thread cannot be started is run by the
+ *** caller.
+ ***/
+static void run_workers(WORKER* workers, int count)
+{
+	int i;
+
+	for(i = 1; i < count; i++) {
+		workers[i].started = pthread_create(&workers[i].thread, NULL, generate_entries, (void *)&workers[i]) == 0;
+	}
+	generate_entries((void *)&workers[0]);
+	for(i = 1; i < count; i++) {
+		if(workers[i].started) {
+			pthread_join(workers[i].thread, NULL);
+		} else {
+			generate_entries((void *)&workers[i]);
+		}
+	}
+}
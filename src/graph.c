@@ -0,0 +1,268 @@
+/*** graph.c - hand a generated network over as forward and reverse stars */
+
+/*** netgen() leaves the arcs of a network in the context's arc arrays,
+ *** in the order they were generated.  Solvers want them grouped by tail
+ *** (forward star) and by head (reverse star) instead, so build_graph
+ *** moves them into a graph of their own with a counting sort.  Each
+ *** thread counts the tails and heads of a run of consecutive arcs; the
+ *** counts are then turned into the place of each thread's first arc out
+ *** of and into every node, and the threads place their arcs.  Runs are
+ *** taken in order, so arcs keep their generation order within each node,
+ *** whatever the number of threads, and the graph is always the same.
+ *** As every thread counts over all the nodes, a thread is only given to
+ *** as many arcs as there are nodes, which bounds the counts by twice the
+ *** size of the arcs' order array.
+ ***/
+
+#include <pthread.h>
+#include <unistd.h>
+
+#include "graph.h"
+
+/*** Local constants */
+
+#define SORT_ARCS 65536				/* fewest arcs worth a thread of their own */
+
+/*** Internally useful types */
+
+typedef struct sorter {
+	NETGEN_CONTEXT* ctx;
+	NETGEN_GRAPH* graph;
+	ARC first;						/* arcs sorted by this thread, in       */
+	ARC last;						/* generation order                     */
+	ARC* out;						/* arcs out of each node, then the      */
+	ARC* in;						/* place of the next one; same for into */
+	int placing;					/* zero while counting                  */
+	pthread_t thread;
+	int started;
+} SORTER;
+
+
+/*** Private functions */
+
+static NETGEN_GRAPH* make_graph(NODE, ARC);
+static void* sort_arcs(void*);
+static void run_sorters(SORTER*, int);
+
+
+/*** Generate a problem and return it as a graph owned by the caller, to
+ *** be freed with free_netgen_graph.  The context's arc sink, if any, is
+ *** not used.  Returns the number of arcs or a netgen() error code, in
+ *** which case no graph is made.
+ ***/
+long netgen_graph(NETGEN_CONTEXT* ctx, long seed, long parms[], int threads, NETGEN_GRAPH** graph)
+{
+	ARC_SINK sink = ctx->sink;
+	long arcs;
+
+	*graph = NULL;
+	ctx->sink = NULL;
+	arcs = netgen(ctx, seed, parms);
+	ctx->sink = sink;
+	if(arcs < 0) {
+		return arcs;
+	}
+
+	return build_graph(ctx, threads, graph);
+}
+
+
+/*** Sort the network a context holds, generated without a sink, into a
+ *** new graph, using the given number of threads (all processors if not
+ *** positive).  Returns the number of arcs, BAD_PARMS if the context does
+ *** not hold a whole network, or ALLOCATION_FAILURE.
+ ***/
+long build_graph(NETGEN_CONTEXT* ctx, int threads, NETGEN_GRAPH** graph)
+{
+	long* parms = ctx->parms;
+	NETGEN_GRAPH* gp;
+	SORTER* sorters;
+	ARC out, in, count;
+	NODE v;
+	int i;
+	long rc = 0;
+
+	*graph = NULL;
+	if(parms == NULL || ctx->status != 0 || ctx->arc_base != 0) {
+		return BAD_PARMS;
+	}
+	if((gp = make_graph((NODE)NODES, ctx->arc_count)) == NULL) {
+		return ALLOCATION_FAILURE;
+	}
+
+	if(threads <= 0) {
+		threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+	}
+	if((ARC)threads > gp->arcs / SORT_ARCS) {
+		threads = (int)(gp->arcs / SORT_ARCS);
+	}
+	/* Each thread counts into two arrays as long as the nodes: it must
+	 * sort at least as many arcs, so that the counts of a sparse network
+	 * take less memory than its arcs.
+	 */
+	if((ARC)threads > gp->arcs / ((ARC)gp->nodes + 1)) {
+		threads = (int)(gp->arcs / ((ARC)gp->nodes + 1));
+	}
+	if(threads <= 0) {
+		threads = 1;
+	}
+	if((sorters = (SORTER*) calloc((size_t)threads, sizeof(SORTER))) == NULL) {
+		free_netgen_graph(gp);
+		return ALLOCATION_FAILURE;
+	}
+	for(i = 0; i < threads; i++) {
+		sorters[i].ctx = ctx;
+		sorters[i].graph = gp;
+		sorters[i].first = gp->arcs / threads * i;
+		sorters[i].last = i + 1 == threads ? gp->arcs : gp->arcs / threads * (i + 1);
+		sorters[i].out = (ARC*) calloc(gp->nodes + 1, sizeof(ARC));
+		sorters[i].in = (ARC*) calloc(gp->nodes + 1, sizeof(ARC));
+		if(sorters[i].out == NULL || sorters[i].in == NULL) {
+			rc = ALLOCATION_FAILURE;
+			goto CLEANUP;
+		}
+	}
+
+	/* Count, then give each thread its places, node after node. */
+	run_sorters(sorters, threads);
+	out = in = 0;
+	for(v = 0; v < gp->nodes; v++) {
+		gp->first_out[v] = out;
+		gp->first_in[v] = in;
+		for(i = 0; i < threads; i++) {
+			count = sorters[i].out[v];
+			sorters[i].out[v] = out;
+			out += count;
+			count = sorters[i].in[v];
+			sorters[i].in[v] = in;
+			in += count;
+		}
+	}
+	gp->first_out[gp->nodes] = out;
+	gp->first_in[gp->nodes] = in;
+
+	for(i = 0; i < threads; i++) {
+		sorters[i].placing = 1;
+	}
+	run_sorters(sorters, threads);
+	(void)memcpy((void *)gp->supply, (void *)B, gp->nodes * sizeof(CAPACITY));
+
+CLEANUP:
+	for(i = 0; i < threads; i++) {
+		free((void *)sorters[i].out);
+		free((void *)sorters[i].in);
+	}
+	free((void *)sorters);
+	if(rc != 0) {
+		free_netgen_graph(gp);
+		return rc;
+	}
+
+	*graph = gp;
+	return (long)gp->arcs;
+}
+
+
+/*** Free a graph and its arrays.
+ ***/
+void free_netgen_graph(NETGEN_GRAPH* gp)
+{
+	if(gp == NULL) {
+		return;
+	}
+
+	free((void *)gp->first_out);
+	free((void *)gp->tail);
+	free((void *)gp->head);
+	free((void *)gp->cost);
+	free((void *)gp->capacity);
+	free((void *)gp->order);
+	free((void *)gp->first_in);
+	free((void *)gp->in_arc);
+	free((void *)gp->supply);
+	free((void *)gp);
+}
+
+
+/*** Allocate a graph of the given size.  Returns NULL if out of memory.
+ ***/
+static NETGEN_GRAPH* make_graph(NODE nodes, ARC arcs)
+{
+	NETGEN_GRAPH* gp;
+	ARC room = arcs > 0 ? arcs : 1;
+
+	if((gp = (NETGEN_GRAPH*) calloc(1, sizeof(NETGEN_GRAPH))) == NULL) {
+		return NULL;
+	}
+	gp->nodes = nodes;
+	gp->arcs = arcs;
+	gp->first_out = (ARC*) malloc((nodes + 1) * sizeof(ARC));
+	gp->tail = (NODE*) malloc(room * sizeof(NODE));
+	gp->head = (NODE*) malloc(room * sizeof(NODE));
+	gp->cost = (COST*) malloc(room * sizeof(COST));
+	gp->capacity = (CAPACITY*) malloc(room * sizeof(CAPACITY));
+	gp->order = (ARC*) malloc(room * sizeof(ARC));
+	gp->first_in = (ARC*) malloc((nodes + 1) * sizeof(ARC));
+	gp->in_arc = (ARC*) malloc(room * sizeof(ARC));
+	gp->supply = (CAPACITY*) malloc((nodes > 0 ? nodes : 1) * sizeof(CAPACITY));
+	if(!gp->first_out || !gp->tail || !gp->head || !gp->cost || !gp->capacity ||
+	   !gp->order || !gp->first_in || !gp->in_arc || !gp->supply) {
+		free_netgen_graph(gp);
+		return NULL;
+	}
+
+	return gp;
+}
+
+
+/*** Thread body: count the tails and heads of a run of arcs or, once the
+ *** counts are places, move the arcs there.
+ ***/
+static void* sort_arcs(void* arg)
+{
+	SORTER* sorter = (SORTER*)arg;
+	NETGEN_CONTEXT* ctx = sorter->ctx;
+	NETGEN_GRAPH* gp = sorter->graph;
+	ARC a, p;
+
+	if(!sorter->placing) {
+		for(a = sorter->first; a < sorter->last; a++) {
+			sorter->out[ARC_FROM(a) - 1]++;
+			sorter->in[ARC_TO(a) - 1]++;
+		}
+		return NULL;
+	}
+
+	for(a = sorter->first; a < sorter->last; a++) {
+		p = sorter->out[ARC_FROM(a) - 1]++;
+		gp->tail[p] = ARC_FROM(a) - 1;
+		gp->head[p] = ARC_TO(a) - 1;
+		gp->cost[p] = ARC_C(a);
+		gp->capacity[p] = ARC_U(a);
+		gp->order[p] = a;
+		gp->in_arc[sorter->in[ARC_TO(a) - 1]++] = p;
+	}
+	return NULL;
+}
+
+
+/*** Run the sorters, the first one on the calling thread, and wait for
+ *** all of them.  A sorter whose thread cannot be started is run by the
+ *** caller.
+ ***/
+static void run_sorters(SORTER* sorters, int count)
+{
+	int i;
+
+	for(i = 1; i < count; i++) {
+		sorters[i].started = pthread_create(&sorters[i].thread, NULL, sort_arcs, (void *)&sorters[i]) == 0;
+	}
+	sort_arcs((void *)&sorters[0]);
+	for(i = 1; i < count; i++) {
+		if(sorters[i].started) {
+			pthread_join(sorters[i].thread, NULL);
+		} else {
+			sort_arcs((void *)&sorters[i]);
+		}
+	}
+}
@@ -0,0 +1,28 @@
+#ifndef GRAPH_H
+#define GRAPH_H 1
+
+#include "netgen.h"
+
+/*** Type Definition ***/
+typedef struct netgen_graph {
+	NODE nodes;					/* nodes, numbered from 0 (NETGEN's node v is v-1)   */
+	ARC arcs;					/* arcs, numbered from 0 in forward-star order       */
+	ARC* first_out;				/* nodes+1 offsets: arcs out of v are first_out[v]   */
+								/* up to first_out[v+1]-1                            */
+	NODE* tail;					/* tail of each arc                                  */
+	NODE* head;					/* head of each arc                                  */
+	COST* cost;					/* cost of each arc                                  */
+	CAPACITY* capacity;			/* capacity of each arc                              */
+	ARC* order;					/* place of each arc in netgen()'s (DIMACS) order     */
+	ARC* first_in;				/* nodes+1 offsets into in_arc: arcs into v are      */
+								/* in_arc[first_in[v]] up to in_arc[first_in[v+1]-1] */
+	ARC* in_arc;				/* arcs by head                                      */
+	CAPACITY* supply;			/* supply (demand if negative) of each node          */
+} NETGEN_GRAPH;
+
+/*** Methods Declaration ***/
+long netgen_graph(NETGEN_CONTEXT*, long, long*, int, NETGEN_GRAPH**);	/* generate a problem as an owned graph */
+long build_graph(NETGEN_CONTEXT*, int, NETGEN_GRAPH**);	/* same, from the network a context holds */
+void free_netgen_graph(NETGEN_GRAPH*);		/* free a graph and its arrays              */
+
+#endif /* GRAPH_H */
@@ -51,7 +51,10 @@
  ***     during both the choose_index and remove_index operations.
  ***
  *** For small index lists, the first of these methods is quite efficient
- *** and is, in fact, implemented in the following code.  Unfortunately,
+ *** and is, in fact, implemented in the following code.  The flags are
+ *** kept one bit per integer in machine words, so that choose_index skips
+ *** a word at a time by counting its set bits and then selects the bit
+ *** within the last one.  Unfortunately,
  *** for the uses we have in mind (i.e. NETGEN), the typical access pattern
  *** to index lists involves a large list, with both choose_index and
  *** remove_index operations occurring at random positions in the list.
@@ -63,13 +66,54 @@
  *** and under rather generous assumptions regarding the randomness of the
  *** positions supplied to choose_index, running time becomes logarithmic
  *** per choose_index and remove_index operation.
+ ***
+ *** A handle points to the list's own header; there is no shared table of
+ *** lists, so distinct lists may be used concurrently from different threads.
+ ***
+ *** A list can be reset to a new range with reset_index_list, keeping its
+ *** storage.  Resetting a large list only reinitializes the root of the
+ *** tree, and nodes are linked by their position in the node array, which
+ *** grows as intervals are split; the cost of a list is thus proportional
+ *** to the operations made on it rather than to its range.  A caller
+ *** making many short-lived lists (NETGEN makes one per node) can reuse a
+ *** single list instead of allocating and freeing one each time.
+ ***
+ *** Random positions make the interval tree miss the cache at nearly every
+ *** level of its descent, as nodes are laid out in the order intervals were
+ *** split.  Large lists can therefore use a second engine instead, chosen
+ *** with use_index_engine or, for all lists, the INDEX_ENGINE symbol at
+ *** compile time.  It keeps a bitmap of removed indices and a Fenwick tree
+ *** counting them per word of the bitmap, both in flat arrays; the k'th
+ *** remaining index is found by one descent of the Fenwick tree followed
+ *** by a search within a single word.  Words touched since the last reset
+ *** are recorded, so that a reset clears only them.  Both engines return
+ *** exactly the same indices.
  ***/
 
 #include "index.h"
+#include "pages.h"
+#include "trace.h"
+
+#if defined(__BMI2__) && defined(__x86_64__)
+#include <immintrin.h>
+#endif
 
 /*** Internally useful types */
+typedef struct count_tree {
+	INDEX base;								/* smallest integer of the list                      */
+	INDEX words;							/* words of bitmap in use                            */
+	INDEX step;								/* largest power of two not above words              */
+	INDEX space;							/* words allocated                                   */
+	INDEX touched_count;					/* words with a removed index                        */
+	FLAG* removed;							/* bitmap, bit set if the index was removed          */
+	INDEX* counts;							/* Fenwick tree of removed indices per word, 1-based */
+	INDEX* touched;							/* the words with a removed index                    */
+} COUNTS;
+
 typedef struct index_header {
-	INDEX original_size;					/* original size of index                            */
+	INDEX original_size;					/* original size of index, zero if unusable          */
+	int engine;								/* INDEX_TREE or INDEX_FENWICK for large lists       */
+	int pages;								/* PAGES_ mode of the flags, tree and counts         */
 	INDEX index_size;						/* number of indices in the index                    */
 	INDEX pseudo_size;						/* almost the number of indices in the index         */
 	union {
@@ -80,98 +124,171 @@ typedef struct index_header {
 		FLAG* flag;							/* pointer to flag array - small                     */
 		struct interval_node* first_node; 	/* pointer to root of interval tree - large          */
 	} p;
+	size_t space;							/* bytes allocated for the flags or the tree         */
+	COUNTS c;								/* state of the Fenwick engine - large case          */
 } HEADER;
 
 typedef struct interval_node {
-	INDEX base;				/* smallest integer in this subtree */
-	INDEX count;			/* count of indices in this subtree */
-	struct interval_node* left_child; /* pointers down the tree */
-} INODE;
+	INDEX base;				/* smallest integer in this subtree              */
+	INDEX count;			/* count of indices in this subtree              */
+	INDEX left_child;		/* position of the children in the node array,   */
+} INODE;					/* the right one following the left; 0 if a leaf */
 
+/*** Local constants */
+#define FIRST_NODES 64		/* tree nodes allocated for a new large list */
+#define FLAG_BITS (8 * sizeof(FLAG))	/* indices per word of flags */
+#define FLAG_WORDS(size) (((size) + FLAG_BITS - 1) / FLAG_BITS)
 
-/*** Static storage */
 
-static INDEX_LIST active_handles = 0;
-static HEADER* index_headers = NULL;
+/*** Private functions */
 
+static int reserve_nodes(HEADER*);
+static int reset_counts(COUNTS*, INDEX, INDEX, int);
+static INDEX choose_counted(COUNTS*, INDEX);
+static int remove_counted(COUNTS*, INDEX);
+static int count_bits(FLAG);
+static int select_free(FLAG, INDEX);
 
-/*** Make a new index list with a specified range.  Returns an integer handle
- *** to identify the list, or -1 if an error occurs.
+
+/*** Make a new index list with a specified range.  Returns a handle
+ *** to identify the list, or NULL if an error occurs.
  ***/
 INDEX_LIST make_index_list(INDEX from, INDEX to)
 {
-	INDEX_LIST handle = 0;
 	HEADER* hp;
-	INODE* np;
 
 	if(from <= 0 || from > to) {	/* sanity check */
-		return -1;
+		return NULL;
 	}
 
-	/* Find an inactive list header or allocate a new one. */
-	for(hp = index_headers; handle < active_handles; hp++, handle++) {
-		if(hp->original_size == 0) {
-			break;
-		}
+	if((hp = (HEADER*) calloc(1, sizeof(HEADER))) == NULL) {
+		return NULL;
 	}
-
-	if(handle == active_handles) {
-		++active_handles;
-		if(handle == 0) {
-			index_headers = (HEADER*) malloc(active_handles * sizeof(HEADER));
-		} else {
-			index_headers = (HEADER*) realloc(index_headers, active_handles * sizeof(HEADER));
-		}
+	hp->engine = INDEX_ENGINE;
+	if(reset_index_list(hp, from, to) != 0) {
+		free((void *)hp);
+		return NULL;
 	}
 
-	if(index_headers == NULL) {
+	return hp;
+}
+
+
+/*** Reset an existing index list to a new range, reusing its storage.
+ *** Returns zero, -1 if the range is invalid or -2 if space cannot be
+ *** found; the list then behaves as an empty list that ignores all
+ *** operations, as a NULL handle would.
+ ***/
+int reset_index_list(INDEX_LIST handle, INDEX from, INDEX to)
+{
+	HEADER* hp = handle;
+	INODE* np;
+	size_t bytes;
+
+	if(hp == NULL) {	/* sanity checks */
+		return -1;
+	}
+	TRACE_COUNT(TRACE_LIST_RESETS, 1);
+	hp->original_size = hp->index_size = hp->pseudo_size = 0;
+	if(from <= 0 || from > to) {
 		return -1;
 	}
 
 
-	/* Fill in the list header and allocate space for the list. */
-	hp = &index_headers[handle];
+	/* Make sure there is space for the flags or the first tree nodes. */
+	if(to - from + 1 <= FLAG_LIMIT) { /* SMALL */
+		bytes = FLAG_WORDS(to - from + 1) * sizeof(FLAG);
+	} else if(hp->engine == INDEX_FENWICK) {
+		if(reset_counts(&hp->c, from, to, hp->pages) != 0) {
+			return -2;
+		}
+		bytes = 0;
+	} else {			/* LARGE */
+		bytes = FIRST_NODES * sizeof(INODE);
+	}
+	if(bytes > hp->space) {
+		free_pages((void *)hp->p.flag);
+		if((hp->p.flag = (FLAG*) alloc_pages(bytes, hp->pages)) == NULL) {
+			hp->space = 0;
+			return -2;
+		}
+		hp->space = bytes;
+	}
+
+
+	/* Fill in the list header and initialize the list. */
 	hp->pseudo_size = hp->index_size = hp->original_size = to - from + 1;
 	if(hp->original_size <= FLAG_LIMIT) { /* SMALL */
 		hp->i.index_base = from;
-		hp->p.flag = (FLAG*) malloc(hp->original_size * sizeof(FLAG));
-		if(hp->p.flag == NULL) {
-			return -1;
-		}
-		(void)memset((void *)hp->p.flag, 0, hp->original_size * sizeof(FLAG));
-	} else {			/* LARGE */
+		(void)memset((void *)hp->p.flag, 0, FLAG_WORDS(hp->original_size) * sizeof(FLAG));
+	} else if(hp->engine == INDEX_TREE) {	/* LARGE */
 		hp->i.index_nodes = 1;
-		np = (INODE*) malloc(hp->original_size * sizeof(INODE));
-		if(np == NULL) {
-			return -1;
-		}
-		hp->p.first_node = np;
+		TRACE_COUNT(TRACE_TREE_NODES, 1);
+		np = hp->p.first_node;
 		np->base = from;
 		np->count = hp->original_size;
-		np->left_child = NULL;
+		np->left_child = 0;
 	}
 
-	return handle;
+	return 0;
 }
 
 
-/*** Free an existing index list.  The header is zeroed afterwards
- *** to indicate that it can be reused.
+/*** Free an existing index list together with its header.
  ***/
 void free_index_list(INDEX_LIST handle)
 {
-	HEADER* hp;
+	if(handle == NULL) {	/* sanity check */
+		return;
+	}
+
+	free_pages((void *)handle->p.flag);
+	free_pages((void *)handle->c.removed);
+	free_pages((void *)handle->c.counts);
+	free_pages((void *)handle->c.touched);
+	free((void *)handle);
+}
 
-	if(handle < 0 || handle >= active_handles) {	/* sanity check */
+
+/*** Select the engine a list uses when it is large.  The choice takes
+ *** effect when the list is next reset.
+ ***/
+void use_index_engine(INDEX_LIST handle, int engine)
+{
+	if(handle == NULL || (engine != INDEX_TREE && engine != INDEX_FENWICK)) {	/* sanity check */
 		return;
 	}
 
-	hp = &index_headers[handle];
-	if(hp->p.flag) {
-		free((void *)hp->p.flag);
+	handle->engine = engine;
+}
+
+
+/*** Select the PAGES_ mode (pages.h) of the flags, tree nodes and counts
+ *** of a list.  The choice takes effect when they are next allocated.
+ ***/
+void use_index_pages(INDEX_LIST handle, int pages)
+{
+	if(handle == NULL) {	/* sanity check */
+		return;
 	}
-  
-	(void)memset((void *)hp, 0, sizeof(HEADER));
+
+	handle->pages = pages;
+}
+
+
+/*** Return the largest array a list holds: its tree nodes or flags, or
+ *** the Fenwick counts if it uses that engine.  NULL if it holds none.
+ ***/
+const void* index_list_pool(INDEX_LIST handle)
+{
+	if(handle == NULL) {	/* sanity check */
+		return NULL;
+	}
+
+	if(handle->c.counts != NULL && handle->engine == INDEX_FENWICK) {
+		return (const void *)handle->c.counts;
+	}
+	return (const void *)handle->p.flag;
 }
 
 /*** Choose the integer at a certain position in an index list.  The
@@ -186,41 +303,50 @@ INDEX choose_index(INDEX_LIST handle, INDEX position)
 	INODE* npl;
 	INODE* npr;
 	INDEX index;
+	int bit;
 
-	if(handle < 0 || handle >= active_handles) {	/* sanity checks */
+	if(handle == NULL) {	/* sanity checks */
 		return 0;
 	}
-	hp = &index_headers[handle];
-	if(hp->p.flag == NULL) {
+	hp = handle;
+	if(hp->original_size == 0) {
 		return 0;
 	}
 	if(position < 1 || position > hp->index_size) {
 		return 0;
 	}
+	if(hp->original_size > FLAG_LIMIT && hp->engine == INDEX_TREE && reserve_nodes(hp) != 0) {
+		return 0;
+	}
 
 	/* Adjust counts of remaining indices. */
+	TRACE_COUNT(TRACE_LIST_CHOICES, 1);
 	hp->index_size--;
 	hp->pseudo_size--;
 
 	/* Find the index we want and remove it from the list. */
 	if(hp->original_size <= FLAG_LIMIT) { /* SMALL */
-		for(cp = hp->p.flag; position > 0; cp++) {
-			if(!*cp) {
-				position--;
-			}
+		for(cp = hp->p.flag; (INDEX)(bit = (int)FLAG_BITS - count_bits(*cp)) < position; cp++) {
+			position -= bit;
 		}
-		*(--cp) = 1;
-		return hp->i.index_base + (INDEX)(cp - hp->p.flag);
+		bit = select_free(*cp, position);
+		*cp |= (FLAG)1 << bit;
+		return hp->i.index_base + (INDEX)(cp - hp->p.flag) * FLAG_BITS + (INDEX)bit;
+	} else if(hp->engine == INDEX_FENWICK) {
+		return choose_counted(&hp->c, position);
 	} else {			/* LARGE */
+		TRACE_DESCENT_START;
 		np = hp->p.first_node;
 		while (np->left_child) {
+			TRACE_DESCENT_STEP;
 			np->count--;
-			np = np->left_child;
+			np = hp->p.first_node + np->left_child;
 			if(position > np->count) {
 				position -= np->count;
 				np++;
 			}
 		}
+		TRACE_DESCENT_END;
 		np->count--;
 		if(position == 1) {	/* beginning of interval */
 			index = np->base++;
@@ -228,15 +354,17 @@ INDEX choose_index(INDEX_LIST handle, INDEX position)
 			index = np->base + np->count;
 		} else {			/* middle of interval - split it */
 			index = np->base + position - 1;
-			npl = np->left_child = hp->p.first_node + hp->i.index_nodes;
+			np->left_child = hp->i.index_nodes;
+			npl = hp->p.first_node + hp->i.index_nodes;
 			npr = npl + 1;
 			hp->i.index_nodes += 2;
+			TRACE_COUNT(TRACE_TREE_NODES, 2);
 			npl->base = np->base;
 			npl->count = position - 1;
-			npl->left_child = NULL;
+			npl->left_child = 0;
 			npr->base = index + 1;
 			npr->count = np->count - npl->count;
-			npr->left_child = NULL;
+			npr->left_child = 0;
 		}
 		return index;
 	}
@@ -250,19 +378,24 @@ void remove_index(INDEX_LIST handle, INDEX index)
 {
 	HEADER* hp;
 	FLAG* cp;
+	FLAG bit;
 	INODE* np;
 	INODE* npl;
 	INODE* npr;
 
-	if(handle < 0 || handle >= active_handles) {	/* sanity checks */
+	if(handle == NULL) {	/* sanity checks */
+		return;
+	}
+	hp = handle;
+	if(hp->original_size == 0) {
 		return;
 	}
-	hp = &index_headers[handle];
-	if(hp->p.flag == NULL) {
+	if(hp->original_size > FLAG_LIMIT && hp->engine == INDEX_TREE && reserve_nodes(hp) != 0) {
 		return;
 	}
 
 	/* Adjust the pseudo-size before looking for the index. */
+	TRACE_COUNT(TRACE_LIST_REMOVALS, 1);
 	hp->pseudo_size--;
 
 	/* Remove the index from the index list. */
@@ -270,27 +403,37 @@ void remove_index(INDEX_LIST handle, INDEX index)
 		if(index < hp->i.index_base || index >= hp->i.index_base + hp->original_size) {
 			return;
 		}
-		cp = hp->p.flag + (index - hp->i.index_base);
-		if(!*cp) {
-			*cp = 1;
+		index -= hp->i.index_base;
+		cp = hp->p.flag + index / FLAG_BITS;
+		bit = (FLAG)1 << (index % FLAG_BITS);
+		if(!(*cp & bit)) {
+			*cp |= bit;
+			hp->index_size--;
+		}
+		return;
+	} else if(hp->engine == INDEX_FENWICK) {
+		if(index >= hp->c.base && index < hp->c.base + hp->original_size && remove_counted(&hp->c, index)) {
 			hp->index_size--;
 		}
 		return;
 	} else {			/* LARGE */
+		TRACE_DESCENT_START;
 		np = hp->p.first_node;
 		while (np->left_child) {
+			TRACE_DESCENT_STEP;
 			np->count--;
-			np = np->left_child + 1;
+			np = hp->p.first_node + np->left_child + 1;
 			if(index < np->base) {
 				np--;
 			}
 		}
+		TRACE_DESCENT_END;
 
 		if(index < np->base || index >= np->base + np->count) { /* mistake - back out */
 			np = hp->p.first_node;
 			while (np->left_child) {
 				np->count++;
-				np = np->left_child + 1;
+				np = hp->p.first_node + np->left_child + 1;
 				if(index < np->base) {
 					np--;
 				}
@@ -303,15 +446,17 @@ void remove_index(INDEX_LIST handle, INDEX index)
 			np->base++;
 		} else if(index == np->base + np->count) {	/* end of interval */
     	} else {   	    	    			/* middle of interval - split it */
-			npl = np->left_child = hp->p.first_node + hp->i.index_nodes;
+			np->left_child = hp->i.index_nodes;
+			npl = hp->p.first_node + hp->i.index_nodes;
 			npr = npl + 1;
 			hp->i.index_nodes += 2;
+			TRACE_COUNT(TRACE_TREE_NODES, 2);
 			npl->base = np->base;
 			npl->count = index - np->base;
-			npl->left_child = NULL;
+			npl->left_child = 0;
 			npr->base = index + 1;
 			npr->count = np->count - npl->count;
-			npr->left_child = NULL;
+			npr->left_child = 0;
 		}
 		hp->index_size--;
 		return;
@@ -323,11 +468,11 @@ void remove_index(INDEX_LIST handle, INDEX index)
  ***/
 INDEX index_size(INDEX_LIST handle)
 {
-	if(handle < 0 || handle >= active_handles) {	/* sanity check */
+	if(handle == NULL) {	/* sanity check */
 		return 0;
 	}
 
-	return index_headers[handle].index_size;
+	return handle->index_size;
 }
 
 
@@ -336,9 +481,196 @@ INDEX index_size(INDEX_LIST handle)
  ***/
 INDEX pseudo_size(INDEX_LIST handle)
 {
-	if(handle < 0 || handle >= active_handles) {	/* sanity check */
+	if(handle == NULL) {	/* sanity check */
+		return 0;
+	}
+
+	return handle->pseudo_size;
+}
+
+
+/*** Return the largest number of bytes a list ranging from "from" through
+ *** "to" can hold: its header, and its flags or a tree split at every
+ *** index, which is more than the Fenwick engine needs.
+ ***/
+size_t index_list_space(INDEX from, INDEX to)
+{
+	INDEX size;
+
+	if(from <= 0 || from > to) {	/* sanity check */
+		return 0;
+	}
+
+	size = to - from + 1;
+	if(size <= FLAG_LIMIT) { /* SMALL */
+		return sizeof(HEADER) + FLAG_WORDS(size) * sizeof(FLAG);
+	}
+	return sizeof(HEADER) + size * sizeof(INODE);		/* LARGE */
+}
+
+
+/*** Make sure the tree of a large list has room for the two nodes of
+ *** one more split, doubling its node array if not.  Nodes refer to each
+ *** other by position, so moving the array is harmless.  Returns zero,
+ *** or -1 if the array cannot be enlarged.
+ ***/
+static int reserve_nodes(HEADER* hp)
+{
+	size_t bytes;
+	INODE* np;
+
+	if((hp->i.index_nodes + 2) * sizeof(INODE) <= hp->space) {
+		return 0;
+	}
+
+	bytes = 2 * hp->space;
+	if((np = (INODE*) resize_pages((void *)hp->p.first_node, bytes, hp->pages)) == NULL) {
+		return -1;
+	}
+	hp->p.first_node = np;
+	hp->space = bytes;
+	return 0;
+}
+
+
+/*** Prepare the Fenwick engine for a list ranging from "from" through
+ *** "to".  The words touched since the last reset are cleared, together
+ *** with the counts covering them; the arrays are only reallocated, in
+ *** the given PAGES_ mode, if they are too short.  Returns zero, or -1 if
+ *** space cannot be found.
+ ***/
+static int reset_counts(COUNTS* cp, INDEX from, INDEX to, int pages)
+{
+	INDEX words = (to - from) / FLAG_BITS + 1;
+	INDEX t, w;
+
+	if(words > cp->space) {
+		free_pages((void *)cp->removed);
+		free_pages((void *)cp->counts);
+		free_pages((void *)cp->touched);
+		cp->removed = (FLAG*) alloc_pages(words * sizeof(FLAG), pages);
+		cp->counts = (INDEX*) alloc_pages((words + 1) * sizeof(INDEX), pages);
+		cp->touched = (INDEX*) alloc_pages(words * sizeof(INDEX), pages);
+		if(!cp->removed || !cp->counts || !cp->touched) {
+			cp->space = cp->words = cp->touched_count = 0;
+			return -1;
+		}
+		(void)memset((void *)cp->removed, 0, words * sizeof(FLAG));
+		(void)memset((void *)cp->counts, 0, (words + 1) * sizeof(INDEX));
+		cp->space = words;
+	} else {
+		for(t = 0; t < cp->touched_count; t++) {
+			w = cp->touched[t];
+			cp->removed[w] = 0;
+			for(w++; w <= cp->words; w += w & (0 - w)) {
+				cp->counts[w] = 0;
+			}
+		}
+	}
+
+	cp->touched_count = 0;
+	cp->base = from;
+	cp->words = words;
+	for(cp->step = 1; 2 * cp->step <= words; cp->step *= 2) {
+	}
+	return 0;
+}
+
+
+/*** Find and remove the remaining index at a given position, known to be
+ *** valid.  The Fenwick descent finds the word holding it; as the bits
+ *** past the end of the last word are never removed but come after every
+ *** real index, they are never reached.
+ ***/
+static INDEX choose_counted(COUNTS* cp, INDEX position)
+{
+	INDEX word = 0;
+	INDEX step, next, remaining;
+
+	for(step = cp->step; step > 0; step /= 2) {
+		next = word + step;
+		if(next <= cp->words) {
+			remaining = step * FLAG_BITS - cp->counts[next];
+			if(remaining < position) {
+				word = next;
+				position -= remaining;
+			}
+		}
+	}
+
+	next = word * FLAG_BITS + (INDEX)select_free(cp->removed[word], position);
+	(void)remove_counted(cp, cp->base + next);
+	return cp->base + next;
+}
+
+
+/*** Mark an index of the list's range as removed.  Returns 1 if it was
+ *** still there, 0 if not.
+ ***/
+static int remove_counted(COUNTS* cp, INDEX index)
+{
+	INDEX offset = index - cp->base;
+	INDEX word = offset / FLAG_BITS;
+	FLAG bit = (FLAG)1 << (offset % FLAG_BITS);
+	INDEX w;
+
+	if(cp->removed[word] & bit) {
 		return 0;
 	}
+	if(cp->removed[word] == 0) {
+		cp->touched[cp->touched_count++] = word;
+	}
+	cp->removed[word] |= bit;
+	for(w = word + 1; w <= cp->words; w += w & (0 - w)) {
+		cp->counts[w]++;
+	}
+	return 1;
+}
+
+
+/*** Bit manipulation helpers for flag words. */
+
+static int count_bits(FLAG w)
+{
+#ifdef __GNUC__
+	return __builtin_popcountl(w);
+#else
+	int n = 0;
+
+	for( ; w; w &= w - 1) {
+		n++;
+	}
+	return n;
+#endif /* __GNUC__ */
+}
 
-	return index_headers[handle].pseudo_size;
+/*** Find the bit of the position'th index not yet removed in a word of
+ *** flags, known to hold at least that many.  With BMI2 the bit is
+ *** deposited straight onto the free indices; otherwise whole bytes are
+ *** skipped by their counts before stepping through the last one.
+ ***/
+static int select_free(FLAG removed, INDEX position)
+{
+#if defined(__BMI2__) && defined(__x86_64__)
+	return __builtin_ctzl(_pdep_u64((FLAG)1 << (position - 1), ~removed));
+#else
+	FLAG left = ~removed;
+	int shift, n;
+
+	for(shift = 0; (INDEX)(n = count_bits(left & 0xff)) < position; shift += 8) {
+		position -= n;
+		left >>= 8;
+	}
+	while(--position > 0) {
+		left &= left - 1;
+	}
+#ifdef __GNUC__
+	return shift + __builtin_ctzl(left);
+#else
+	for( ; !(left & 1); left >>= 1) {
+		shift++;
+	}
+	return shift;
+#endif /* __GNUC__ */
+#endif /* __BMI2__ */
 }
@@ -2,12 +2,29 @@
 #define INDEX_H 1
 
 /*** Constants Definitions ***/
-#define FLAG_LIMIT 100
+/* Up to FLAG_LIMIT, a bitset beats the tree on pick_head's pattern (a
+ * reset and a few choices) only with BMI2 (make ARCH=-mbmi2); without it,
+ * only for the shortest lists.
+ */
+#ifndef FLAG_LIMIT
+#if defined(__BMI2__) && defined(__x86_64__)
+#define FLAG_LIMIT 256			/* largest list kept as a bitset of flags     */
+#else
+#define FLAG_LIMIT 16			/* largest list kept as a bitset of flags     */
+#endif /* __BMI2__ */
+#endif /* FLAG_LIMIT */
+
+#define INDEX_TREE    1			/* large lists kept in a binary interval tree */
+#define INDEX_FENWICK 2			/* large lists kept in a bitmap of removed    */
+								/* indices, counted by a Fenwick tree         */
+#ifndef INDEX_ENGINE
+#define INDEX_ENGINE INDEX_TREE	/* engine of newly made lists                 */
+#endif /* INDEX_ENGINE */
 
 /*** Type Definitions ***/
 typedef unsigned long INDEX;	/* Index Element     */
-typedef int INDEX_LIST;			/* Index List Handle */
-typedef unsigned char FLAG;
+typedef struct index_header* INDEX_LIST;	/* Index List Handle */
+typedef unsigned long FLAG;		/* word of flags, one bit per index */
 
 /*** Methods Declarations ***/
 #ifdef __STDC__
@@ -15,11 +32,16 @@ typedef unsigned char FLAG;
 #include <string.h>
 
 INDEX_LIST make_index_list(INDEX, INDEX);		/* allocates a new index list          */
+int reset_index_list(INDEX_LIST, INDEX, INDEX);	/* reuses a list for a new range       */
+void use_index_engine(INDEX_LIST, int);			/* selects the engine for large lists  */
+void use_index_pages(INDEX_LIST, int);			/* selects how its storage is paged    */
+const void* index_list_pool(INDEX_LIST);		/* largest array the list holds        */
 void free_index_list(INDEX_LIST);				/* frees an existing list              */
 INDEX choose_index(INDEX_LIST, INDEX);			/* chooses index at specified position */
 void remove_index(INDEX_LIST, INDEX);			/* removes specified index from list   */
 INDEX index_size(INDEX_LIST);					/* number of indices remaining         */
 INDEX pseudo_size(INDEX_LIST);					/* "modified" index size               */
+size_t index_list_space(INDEX, INDEX);			/* bytes held by a list of given range */
 
 #else
 
@@ -34,11 +56,16 @@ void * memset();				/* ditto                                   */
 void exit();					/* ditto                                   */
 
 INDEX_LIST make_index_list();	/* allocates a new index list          */
+int reset_index_list();			/* reuses a list for a new range       */
+void use_index_engine();		/* selects the engine for large lists  */
+void use_index_pages();			/* selects how its storage is paged    */
+char* index_list_pool();		/* largest array the list holds        */
 void free_index_list();			/* frees an existing list              */
 INDEX choose_index();			/* chooses index at specified position */
 void remove_index();			/* removes specified index from list   */
 INDEX index_size(); 			/* number of indices remaining         */
 INDEX pseudo_size();			/* "modified" index size               */
+unsigned long index_list_space();	/* bytes held by a list of given range */
 
 #endif /* __STDC__ */
 
@@ -1,13 +1,22 @@
 /*** System Interfaces ***/
 #include <stdio.h>
+#include <string.h>
+#include <unistd.h>
 
 /*** NETGEN Interfaces ***/
 #include "netgen.h"
+#include "output.h"
+#include "pages.h"
+#include "batch.h"
+#include "server.h"
+#include "trace.h"
 
 /*** Local Constants ***/
 #define INPUT_FILE	1
 #define INPUT_STDIN	2
 
+#define USAGE "Usage: ./netgen [-j THREADS] [-m MEGABYTES] [-w THREADS | -g THREADS | -s | -o DIRECTORY | -a THREADS [-u] | -b | -z] [-c] [-p transparent|explicit] [-l tree|fenwick] [-f THREADS | -k SHARD/SHARDS] [-t TRACE] [-S SOCKET | FILE]\n"
+
 /*** Local Macros ***/
 #define READ(v) 		     		\
 	switch( scanf("%ld", &v) ) {	\
@@ -25,29 +34,164 @@ main(int argc, char **argv)
 	long parms[PROBLEM_PARMS];
 	long arcs;
 	int i;
+	int status = EXIT_FAILURE;	/* until the problem is written */
+	NETGEN_CONTEXT* ctx = NULL;
 	
 	/* I/O Variables */
 	FILE * fin = NULL;
-	FILE * fout = NULL;
 	char filename[256];
 	unsigned char flag;
+	OUTPUT_OPTIONS output = { OUTPUT_DIMACS, 0, 0, 0, 0, 0, 0, 0, NULL, 0, 0 };
+
+	/* Batch Variables */
+	int threads = 0;
+	long megabytes = 0;
+	int opt, failures;
+
+	/* Instrumentation Variables */
+	const char* tracefile = NULL;
+
+	/* Server Variables */
+	const char* socket_path = NULL;
 	
+	while((opt = getopt(argc, argv, "j:m:w:g:so:a:ubzcp:l:f:k:t:S:")) != -1) {
+		switch(opt) {
+			case 'j':
+				threads = atoi(optarg);
+				break;
+			case 'm':
+				megabytes = atol(optarg);
+				break;
+			case 'w':
+				output.format = OUTPUT_MAPPED;
+				output.threads = atoi(optarg);
+				break;
+			case 'g':
+				output.format = OUTPUT_GZIP;
+				output.threads = atoi(optarg);
+				break;
+			case 's':
+				output.format = OUTPUT_STREAM;
+				break;
+			case 'o':
+				output.format = OUTPUT_SPILL;
+				output.directory = optarg;
+				break;
+			case 'a':
+				output.format = OUTPUT_PIPELINE;
+				output.threads = atoi(optarg);
+				break;
+			case 'u':
+				output.uring = 1;
+				break;
+			case 'b':
+				output.format = OUTPUT_BINARY;
+				break;
+			case 'z':
+				output.format = OUTPUT_PACKED;
+				break;
+			case 'c':
+				output.compact = 1;
+				break;
+			case 'p':
+				if(strcmp(optarg, "transparent") == 0) {
+					output.pages = PAGES_TRANSPARENT;
+				} else if(strcmp(optarg, "explicit") == 0) {
+					output.pages = PAGES_EXPLICIT;
+				} else {
+					fprintf(stderr, USAGE);
+					goto TERMINATE;
+				}
+				break;
+			case 'l':
+				if(strcmp(optarg, "tree") == 0) {
+					output.engine = INDEX_TREE;
+				} else if(strcmp(optarg, "fenwick") == 0) {
+					output.engine = INDEX_FENWICK;
+				} else {
+					fprintf(stderr, USAGE);
+					goto TERMINATE;
+				}
+				break;
+			case 'f':
+				output.fast = 1;
+				output.fast_threads = atoi(optarg);
+				break;
+			case 'k':
+				if(sscanf(optarg, "%d/%d", &output.shard, &output.shards) != 2 ||
+				   output.shard < 0 || output.shard >= output.shards) {
+					fprintf(stderr, USAGE);
+					goto TERMINATE;
+				}
+				break;
+			case 't':
+				if(!trace_enabled()) {
+					fprintf(stderr, "Instrumentation is not compiled in: build with make TRACE=1.\n");
+					goto TERMINATE;
+				}
+				tracefile = optarg;
+				break;
+			case 'S':
+				socket_path = optarg;
+				break;
+			default:
+				fprintf(stderr, USAGE);
+				goto TERMINATE;
+		}
+	}
+
+	if(output.fast && output.shards > 1) {	/* shards are of the exact networks only */
+		fprintf(stderr, USAGE);
+		goto TERMINATE;
+	}
+	if(output.format != OUTPUT_DIMACS && output.shards > 1) {	/* and of plain DIMACS text */
+		fprintf(stderr, USAGE);
+		goto TERMINATE;
+	}
+	if(output.uring && output.format != OUTPUT_PIPELINE) {	/* io_uring is for the pipelined writers */
+		fprintf(stderr, USAGE);
+		goto TERMINATE;
+	}
+
+	/* As a server, the problems come from the socket's clients. */
+	if(socket_path != NULL) {
+		if(argc != optind || output.shards > 1 || output.format == OUTPUT_GZIP) {
+			fprintf(stderr, USAGE);
+			goto TERMINATE;
+		}
+		if(run_server(socket_path, threads, &output) != 0) {
+			fprintf(stderr, "Unable to serve on %s.\n", socket_path);
+			exit(EXIT_FAILURE);
+		}
+		exit(EXIT_SUCCESS);
+	}
+
 	/* The generator accepts two forms of input: a file from where the problem
 	 * params are read or an input stream from stdin. If no file is provided in
 	 * command line, it is assumed that the params are to be inputed from stdin.
 	 */
-	if(argc == 2) {
+	if(argc - optind == 1) {
 		flag = INPUT_FILE;
-	} else if(argc == 1) {
+	} else if(argc == optind) {
 		flag = INPUT_STDIN;
 	} else {
-		fprintf(stderr, "Usage: ./netgen [FILE]\n");
+		fprintf(stderr, USAGE);
 		goto TERMINATE;
 	}
 	
 	if(flag == INPUT_FILE) {
-		fprintf(stderr, "ERROR: reading from input file still not possible.\n");
-		goto TERMINATE;
+		/* A file may hold any number of problems, generated in parallel. */
+		if((fin = fopen(argv[optind], "r")) == NULL) {
+			fprintf(stderr, "Unable to open input file.\n");
+			goto TERMINATE;
+		}
+		failures = run_batch(fin, threads, (size_t)(megabytes > 0 ? megabytes : 0) << 20, &output);
+		fclose(fin);
+		if(tracefile && write_trace(tracefile) != 0) {
+			fprintf(stderr, "Unable to write the trace file.\n");
+			failures++;
+		}
+		exit(failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
 	} else if(flag == INPUT_STDIN) {
 		/* First read the seed and the problem: if valid, read the rest of input */
 		fprintf(stdout, "Seed: ");
@@ -108,86 +252,22 @@ main(int argc, char **argv)
 		}
 	}
 	
-	/* Open output file */
+	/* Generate Network and print it to a file named after the problem */
 	sprintf(filename, "%ld", problem);
-	fout = fopen(filename, "w");
-	if(!fout) {
-		fprintf(stderr, "Unable to open output file.\n");
-		exit(0);
+	if((ctx = make_netgen_context()) == NULL) {
+		error_exit(ALLOCATION_FAILURE);
 	}
-	
-	/* Output to file */
-	fprintf(fout, "c NETGEN flow network generator (C version)\n");
-	fprintf(fout, "c  Problem %2ld input parameters\n", problem);
-	fprintf(fout, "c  ---------------------------\n");
-	fprintf(fout, "c   Random seed:          %10ld\n",   seed);
-	fprintf(fout, "c   Number of nodes:      %10ld\n",   NODES);
-	fprintf(fout, "c   Source nodes:         %10ld\n",   SOURCES);
-	fprintf(fout, "c   Sink nodes:           %10ld\n",   SINKS);
-	fprintf(fout, "c   Number of arcs:       %10ld\n",   DENSITY);
-	fprintf(fout, "c   Minimum arc cost:     %10ld\n",   MINCOST);
-	fprintf(fout, "c   Maximum arc cost:     %10ld\n",   MAXCOST);
-	fprintf(fout, "c   Total supply:         %10ld\n",   SUPPLY);
-	fprintf(fout, "c   Transshipment -\n");
-	fprintf(fout, "c     Sources:            %10ld\n",   TSOURCES);
-	fprintf(fout, "c     Sinks:              %10ld\n",   TSINKS);
-	fprintf(fout, "c   Skeleton arcs -\n");
-	fprintf(fout, "c     With max cost:      %10ld%%\n", HICOST);
-	fprintf(fout, "c     Capacitated:        %10ld%%\n", CAPACITATED);
-	fprintf(fout, "c   Minimum arc capacity: %10ld\n",   MINCAP);
-	fprintf(fout, "c   Maximum arc capacity: %10ld\n",   MAXCAP);
-
-	/* Generate Network */
-	if((arcs = netgen(seed, parms)) < 0) {
+	if((arcs = generate_problem(filename, ctx, seed, problem, parms, &output)) < 0) {
 		error_exit(arcs);
 	}
-
-	/* Print Network */
-	if((SOURCES - TSOURCES) + (SINKS - TSINKS) == NODES && (SOURCES - TSOURCES) == (SINKS - TSINKS) && SOURCES == SUPPLY) {
-		fprintf(fout, "c\n");
-		fprintf(fout, "c  *** Assignment ***\n");
-		fprintf(fout, "c\n");
-		fprintf(fout, "p asn %ld %ld\n", NODES, arcs);
-		for(i = 0; i < NODES; i++) {
-			if(B[i] > 0) {
-				fprintf(fout, "n %ld\n", (long) (i + 1));
-			}
-		}
-		for(i = 0; i < arcs; i++) {
-			fprintf(fout, "a %ld %ld %ld\n", FROM[i], TO[i], C[i]);
-		}	
-	} else if (MINCOST == 1 && MAXCOST == 1) {
-		fprintf(fout, "c\n");
-		fprintf(fout, "c  *** Maximum flow ***\n");
-		fprintf(fout, "c\n");
-		fprintf(fout, "p max %ld %ld\n", NODES, arcs);
-		for(i = 0; i < NODES; i++) {
-			if(B[i] > 0) {
-				fprintf(fout, "n %ld s\n", (long) (i + 1));
-			} else if(B[i] < 0) {
-				fprintf(fout, "n %ld t\n", (long) (i + 1));
-			}
-		}
-		for(i = 0; i < arcs; i++) {
-			fprintf(fout, "a %ld %ld %ld\n", FROM[i], TO[i], U[i]);
-		}
-	} else {
-		fprintf(fout, "c\n");
-		fprintf(fout, "c  *** Minimum cost flow ***\n");
-		fprintf(fout, "c\n");
-		fprintf(fout, "p min %ld %ld\n", NODES, arcs);
-		for(i = 0; i < NODES; i++) {
-			if(B[i] != 0) {
-				fprintf(fout, "n %ld %ld\n", (long) (i + 1), B[i]);
-			}
-		}
-		for(i = 0; i < arcs; i++) {
-			fprintf(fout, "a %ld %ld %ld %ld %ld\n", FROM[i], TO[i], (long) 0, U[i], C[i]);
-		}
+	status = EXIT_SUCCESS;
+	if(tracefile && write_trace(tracefile) != 0) {
+		fprintf(stderr, "Unable to write the trace file.\n");
+		status = EXIT_FAILURE;
 	}
 	
 TERMINATE:
 
-	fclose(fout);
-	exit(EXIT_SUCCESS);
+	free_netgen_context(ctx);
+	exit(status);
 } /* END OF MAIN */
@@ -60,9 +60,27 @@
  ***	Fortran interface is suffixed with an underscore to make it
  ***	callable in the normal fashion from Fortran (a Unix convention).
  ***
- ***    Because Fortran has no facility for pointers, the common arrays
- ***    are statically allocated.  Static allocation has nothing to recommend
- ***    it except for the need for a Fortran interface.
+ ***    The network is kept in a NETGEN_CONTEXT rather than in statically
+ ***    allocated common arrays, so problem sizes are bounded only by
+ ***    available memory.  The arrays are sized from NODES and DENSITY when
+ ***    netgen() is called, grown should the skeleton need more arcs than
+ ***    requested, and kept for reuse by later calls on the same context.
+ ***
+ ***    A context may instead be given an arc sink, in which case the arc
+ ***    arrays only hold a block of arcs.  Each full block is handed to the
+ ***    sink as soon as it is generated, so that memory no longer grows with
+ ***    DENSITY; supplies and demands still stay in B until the end.
+ ***
+ ***    Arcs are generated unit by unit: a source with its chain, or a
+ ***    transshipment sink, or a source of an assignment problem.  The
+ ***    state of the generator between two units is small enough to be
+ ***    recorded, which lets plan_shards checkpoint a problem in a pass
+ ***    that counts arcs instead of generating them, and netgen_shard
+ ***    generate exactly the arcs of any run of units.
+ ***
+ ***    A context may also be set to the fast mode of fastgen.c, which
+ ***    spreads generation over threads at the cost of no longer producing
+ ***    the networks of the Fortran code.
  ***
  ***    This software expects input parameters to be long integers
  ***    (in the sense of C); that means no INTEGER*2 from Fortran callers.
@@ -77,30 +95,68 @@
 
 /*** System interfaces */
 
+#include <limits.h>
 #include <stdio.h>
 
 
 /*** Public interfaces */
 
-#define ALLOCATE_NETWORK
 #include "netgen.h"
 
 
 /*** Private interfaces */
 
+#include "pages.h"
+#include "trace.h"
+
 #ifdef DEBUG
 #define PRIVATE
 #else
 #define PRIVATE static
 #endif /* DEBUG */
 
-/*** Private variables */
-
-static NODE nodes_left;
-static ARC arc_count;
-static NODE pred[MAXARCS];
-static NODE head[MAXARCS];
-static NODE tail[MAXARCS];
+/*** Private functions */
+
+PRIVATE long start_network(NETGEN_CONTEXT*, long, long*, ARC);
+PRIVATE void generate_unit(NETGEN_CONTEXT*, NODE);
+PRIVATE void hook_chain(NETGEN_CONTEXT*, NODE);
+PRIVATE void assign_source(NETGEN_CONTEXT*, NODE);
+PRIVATE void count_rubbish(NETGEN_CONTEXT*, INDEX_LIST, long);
+PRIVATE int make_room(NETGEN_CONTEXT*);
+PRIVATE int grow_compact(NETGEN_CONTEXT*, ARC);
+PRIVATE long finish_network(NETGEN_CONTEXT*);
+PRIVATE INDEX_LIST reuse_list(NETGEN_CONTEXT*, INDEX_LIST, INDEX, INDEX);
+PRIVATE NODE shard_unit(SHARD_PLAN*, int, int);
+PRIVATE void note_change(NETGEN_CONTEXT*, NODE, CAPACITY);
+PRIVATE void free_plan(SHARD_PLAN*);
+
+
+/*** Private types */
+
+typedef struct checkpoint {
+	RANDOM random;				/* state of the random sequence       */
+	ARC arc_count;				/* arcs generated before the unit     */
+	NODE nodes_left;
+	ARC changes;				/* supply changes made before it      */
+} CHECKPOINT;
+
+typedef struct change {
+	NODE node;					/* sink whose supply was lowered      */
+	CAPACITY amount;			/* and by how much                    */
+} CHANGE;
+
+struct shard_plan {
+	long seed;					/* problem planned                    */
+	long parms[PROBLEM_PARMS];
+	NODE units;					/* units of the problem               */
+	CHECKPOINT* checkpoints;	/* one per unit, and one past the end */
+	CHANGE* changes;			/* supply changes in order            */
+	ARC change_count;
+	ARC change_space;
+	NODE* heads;				/* sink matched with each source of   */
+								/* an assignment problem              */
+	CAPACITY* b;				/* final supplies                     */
+};
 
 
 /*** Local macros */
@@ -109,76 +165,335 @@ static NODE tail[MAXARCS];
 #define MAX(x, y) ((x) > (y) ? (x) : (y))
 #define SAVE_ARC(tail, head, cost, capacity)	/* records an arc where our caller can get it */ \
   {				\
-    FROM[arc_count] = tail;	\
-    TO  [arc_count] = head;	\
-    C   [arc_count] = cost;	\
-    U   [arc_count] = capacity; \
-    arc_count++;		\
+    if(ctx->counting) {		\
+      (void)(cost);		\
+      ctx->arc_count++;		\
+    } else if(ctx->arc_count - ctx->arc_base < ctx->arc_space || make_room(ctx)) { \
+      STORE_ARC(ctx->arc_count - ctx->arc_base, tail, head, cost, capacity); \
+      ctx->arc_count++;		\
+    }				\
   }
+#define TAKE_SUPPLY(node, amount)	/* lowers a sink's supply, noting it when planning */ \
+  {				\
+    B[node] -= (amount);	\
+    if(ctx->counting) {		\
+      note_change(ctx, node, amount); \
+    }				\
+  }
+#define assignment_problem(parms)	/* decides if the parameters describe one */ \
+  ((SOURCES - TSOURCES) + (SINKS - TSINKS) == NODES && \
+   (SOURCES - TSOURCES) == (SINKS - TSINKS) && \
+    SOURCES == SUPPLY)
+#define count_units(parms) ((NODE)(assignment_problem(parms) ? NODES/2 : SOURCES + TSINKS))
 
 
 
+/*** Allocate an empty generator context.  Storage for the network is
+ *** obtained by netgen() once the size of the problem is known.  Returns
+ *** NULL if the context itself cannot be allocated.
+ ***/
+NETGEN_CONTEXT* make_netgen_context(void)
+{
+	NETGEN_CONTEXT* ctx;
+
+	if((ctx = (NETGEN_CONTEXT*) calloc(1, sizeof(NETGEN_CONTEXT))) == NULL) {
+		return NULL;
+	}
+
+	ctx->compact = NETGEN_COMPACT;
+	ctx->skeleton = make_index_list((INDEX)1, (INDEX)1);
+	ctx->candidates = make_index_list((INDEX)1, (INDEX)1);
+	if(ctx->skeleton == NULL || ctx->candidates == NULL) {
+		free_netgen_context(ctx);
+		return NULL;
+	}
+	set_page_mode(ctx, NETGEN_PAGES);
+
+	return ctx;
+}
+
+
+/*** Free a generator context together with the network it holds.
+ ***/
+void free_netgen_context(NETGEN_CONTEXT* ctx)
+{
+	if(ctx == NULL) {
+		return;
+	}
+
+	free_pages((void *)ctx->from);
+	free_pages((void *)ctx->to);
+	free_pages((void *)ctx->u);
+	free_pages((void *)ctx->c);
+	free_pages((void *)ctx->from32);
+	free_pages((void *)ctx->to32);
+	free_pages((void *)ctx->u32);
+	free_pages((void *)ctx->c32);
+	free_pages((void *)ctx->b);
+	free_pages((void *)ctx->pred);
+	free_pages((void *)ctx->head);
+	free_pages((void *)ctx->tail);
+	free_index_list(ctx->skeleton);
+	free_index_list(ctx->candidates);
+	free_plan(ctx->plan);
+	free((void *)ctx);
+}
+
+
+/*** Stream the arcs generated with a context to a sink, "block" arcs at
+ *** a time, rather than keeping them in the arc arrays.  Each call to the
+ *** sink passes the number of arcs at the start of FROM, TO, U and C;
+ *** the sink returns nonzero to report an error, which netgen() then
+ *** returns as OUTPUT_FAILURE.  A NULL sink restores the default.
+ ***/
+void set_arc_sink(NETGEN_CONTEXT* ctx, ARC_SINK sink, void* data, ARC block)
+{
+	ctx->sink = sink;
+	ctx->sink_data = data;
+	ctx->block = block > 0 ? block : ARC_BLOCK;
+}
+
+
+/*** Select the engine, INDEX_TREE or INDEX_FENWICK, of the index lists
+ *** used by a context.  Both generate exactly the same networks.
+ ***/
+void set_index_engine(NETGEN_CONTEXT* ctx, int engine)
+{
+	ctx->engine = engine;
+	use_index_engine(ctx->skeleton, engine);
+	use_index_engine(ctx->candidates, engine);
+}
+
+
+/*** Generate the networks of a context in the fast mode of netgen_fast,
+ *** with the given number of threads (all processors if zero), or go
+ *** back to the exact NETGEN sequence if threads is negative.
+ ***/
+void set_fast_mode(NETGEN_CONTEXT* ctx, int threads)
+{
+	ctx->fast = threads >= 0;
+	ctx->fast_threads = threads > 0 ? threads : 0;
+}
+
+
+/*** Store the arcs of later networks in 32-bit arrays, half the size of
+ *** the usual ones, whenever the parameters let every node number,
+ *** capacity and cost fit (see compact_fits); other networks are stored
+ *** as usual.  Arc sinks and other readers of a compact network use
+ *** ARC_FROM, ARC_TO, ARC_U and ARC_C, or copy_arcs.
+ ***/
+void set_compact_storage(NETGEN_CONTEXT* ctx, int compact)
+{
+	ctx->compact = compact != 0;
+}
+
+
+/*** Back the large arrays of a context, its network and index lists,
+ *** with huge pages in the given PAGES_ mode (pages.h), falling back to
+ *** ordinary pages when the kernel has none.  The mode applies as the
+ *** arrays are next allocated.  Arc arrays for the whole of an exact
+ *** network are also spread over the NUMA nodes, as the parallel writers
+ *** read them from every node; the fast mode's are first touched by the
+ *** threads that fill them.
+ ***/
+void set_page_mode(NETGEN_CONTEXT* ctx, int pages)
+{
+	ctx->pages = pages;
+	use_index_pages(ctx->skeleton, pages);
+	use_index_pages(ctx->candidates, pages);
+}
+
+
 /*** C callable interface routine */
 
-ARC netgen(long seed, long parms[])
+ARC netgen(NETGEN_CONTEXT* ctx, long seed, long parms[])
 {
-	register NODE i,j,k;
+	NODE unit, units;
+	long rc;
+
+	TRACE_BEGIN(PHASE_NETWORK);
+	if(ctx->fast) {
+		rc = netgen_fast(ctx, seed, parms);
+	} else if((rc = start_network(ctx, seed, parms, ctx->sink ? ctx->block : (ARC)DENSITY)) == 0) {
+		units = count_units(parms);
+		for(unit = 0; unit < units; unit++) {
+			generate_unit(ctx, unit);
+		}
+		rc = finish_network(ctx);
+	}
+	TRACE_END(PHASE_NETWORK);
+
+	return rc;
+}
+
+
+/*** Plan the generation of a network in shards.  The problem is run
+ *** through once without keeping any arcs, and a checkpoint is recorded
+ *** at the start of each unit: the state of the random sequence, the arc
+ *** count and the nodes left, and how far the changes to the sinks'
+ *** supplies have got.  Returns the number of arcs in the network, or an
+ *** error code; the context then holds the final supplies in B.
+ ***/
+long plan_shards(NETGEN_CONTEXT* ctx, long seed, long parms[])
+{
+	SHARD_PLAN* plan;
+	NODE unit, units;
+	long rc;
+
+	free_plan(ctx->plan);
+	if((ctx->plan = plan = (SHARD_PLAN*) calloc(1, sizeof(SHARD_PLAN))) == NULL) {
+		return ALLOCATION_FAILURE;
+	}
+	if((rc = start_network(ctx, seed, parms, 0)) != 0) {
+		return rc;
+	}
+
+	plan->seed = seed;
+	(void)memcpy((void *)plan->parms, (void *)parms, PROBLEM_PARMS * sizeof(long));
+	plan->units = units = count_units(parms);
+	plan->checkpoints = (CHECKPOINT*) malloc((units + 1) * sizeof(CHECKPOINT));
+	plan->b = (CAPACITY*) malloc(NODES * sizeof(CAPACITY));
+	if(assignment_problem(parms)) {
+		plan->heads = (NODE*) malloc(units * sizeof(NODE));
+	}
+	if(!plan->checkpoints || !plan->b || (assignment_problem(parms) && !plan->heads)) {
+		return ALLOCATION_FAILURE;
+	}
+
+	ctx->counting = 1;
+	for(unit = 0; unit <= units; unit++) {
+		plan->checkpoints[unit].random = ctx->random;
+		plan->checkpoints[unit].arc_count = ctx->arc_count;
+		plan->checkpoints[unit].nodes_left = ctx->nodes_left;
+		plan->checkpoints[unit].changes = plan->change_count;
+		if(unit < units) {
+			generate_unit(ctx, unit);
+		}
+	}
+	ctx->counting = 0;
+	ctx->arc_base = ctx->arc_count;
+
+	(void)memcpy((void *)plan->b, (void *)B, NODES * sizeof(CAPACITY));
+	return ctx->status ? ctx->status : (long)ctx->arc_count;
+}
+
+
+/*** Generate one of several shards of the network planned by the last
+ *** call to plan_shards.  Shards are runs of consecutive units holding
+ *** about as many arcs each; their arcs, taken in order, are exactly the
+ *** arcs netgen() would generate.  The shard starts from the checkpoint
+ *** of its first unit, its arcs being numbered from there.  Returns the
+ *** number of arcs in the shard, or an error code; the context then holds
+ *** the final supplies of the network, and arc_base the number of arcs
+ *** before the shard if they were not handed to a sink.
+ ***/
+long netgen_shard(NETGEN_CONTEXT* ctx, long seed, long parms[], int shard, int shards)
+{
+	SHARD_PLAN* plan = ctx->plan;
+	CHECKPOINT* start;
+	NODE unit, first, last;
+	ARC c;
+	long rc;
+
+	if(plan == NULL || plan->seed != seed || memcmp((void *)plan->parms, (void *)parms, PROBLEM_PARMS * sizeof(long)) != 0 ||
+	   shard < 0 || shard >= shards) {
+		return BAD_PARMS;
+	}
+	first = shard_unit(plan, shard, shards);
+	last = shard_unit(plan, shard + 1, shards);
+	start = &plan->checkpoints[first];
+
+	if((rc = start_network(ctx, seed, parms, ctx->sink ? ctx->block : plan->checkpoints[last].arc_count - start->arc_count)) != 0) {
+		return rc;
+	}
+
+	/* Bring the network to the state it had at the shard's first unit. */
+	(void)memcpy((void *)B, (void *)plan->b, NODES * sizeof(CAPACITY));
+	for(c = start->changes; c < plan->change_count; c++) {
+		B[plan->changes[c].node] += plan->changes[c].amount;
+	}
+	if(plan->heads) {
+		for(unit = 0; unit < first; unit++) {
+			remove_index(ctx->skeleton, (INDEX)plan->heads[unit]);
+		}
+	}
+	ctx->random = start->random;
+	ctx->arc_count = ctx->arc_base = start->arc_count;
+	ctx->nodes_left = start->nodes_left;
+
+	for(unit = first; unit < last; unit++) {
+		generate_unit(ctx, unit);
+	}
+
+	rc = finish_network(ctx);
+	(void)memcpy((void *)B, (void *)plan->b, NODES * sizeof(CAPACITY));
+	return rc < 0 ? rc : (long)(ctx->arc_count - start->arc_count);
+}
+
+
+/*** Check the parameters and set up the generation of a network, up to
+ *** the point where the arcs out of the first unit are generated: for
+ *** an assignment problem, the supplies and the list of unmatched sinks;
+ *** otherwise the supplies and the skeleton chains.  Room is made for the
+ *** given number of arcs.
+ ***/
+PRIVATE long start_network(NETGEN_CONTEXT* ctx, long seed, long parms[], ARC arcs)
+{
+	register NODE i;
 	NODE source;
 	NODE node;
-	NODE sinks_per_source;
-	NODE * sinks;
-	NODE it;
-	int chain_length;
-	COST cost;
-	CAPACITY cap;
+	NODE* pred;
 	INDEX_LIST handle;
-	int supply_per_sink;
-	int partial_supply;
-	int sort_count;
+	long rc;
 
 	/* Perform sanity checks on the input */
-	if(seed <= 0) {
-		return BAD_SEED;
-	}
-	if(NODES > MAXNODES || DENSITY > MAXARCS) {
-		return TOO_BIG;
+	if((rc = check_parms(seed, parms)) != 0) {
+		return rc;
 	}
-	if((NODES <= 0) || (NODES > DENSITY) || (SOURCES <= 0) || (SINKS <= 0) ||
-      (SOURCES + SINKS > NODES) || (MINCOST > MAXCOST) || (SUPPLY < SOURCES) ||
-      (TSOURCES > SOURCES) || (TSINKS > SINKS) || (HICOST < 0 || HICOST > 100) ||
-      (CAPACITATED < 0 || CAPACITATED > 100) || (MINCAP > MAXCAP)) {
-		return BAD_PARMS;
+
+	/* Size the network storage for this problem.  The skeleton arrays hold
+	 * at most one chain plus the sinks hooked onto it, and a sentinel.
+	 */
+	choose_storage(ctx, parms);
+	if((rc = reserve_network(ctx, (NODE)NODES + 3, arcs)) != 0) {
+		return rc;
 	}
+	pred = ctx->pred;
 
 	/* Do a little bit of setting up. */
-	set_randomi(seed);
-
-	arc_count = 0;
-	nodes_left = NODES - SINKS + TSINKS;
-
-	if((SOURCES - TSOURCES) + (SINKS - TSINKS) == NODES &&
-      (SOURCES - TSOURCES) == (SINKS - TSINKS) &&
-       SOURCES == SUPPLY) {
-		create_assignment(parms);
-		return arc_count;
+	set_randomi(&ctx->random, seed);
+
+	ctx->parms = parms;
+	ctx->status = 0;
+	ctx->arc_count = 0;
+	ctx->arc_base = 0;
+	ctx->nodes_left = NODES - SINKS + TSINKS;
+
+	TRACE_BEGIN(PHASE_SUPPLY);
+	if(assignment_problem(parms)) {
+		create_assignment(ctx);
+		TRACE_END(PHASE_SUPPLY);
+		return 0;
 	}
 
-	(void)memset((void *)B, 0, sizeof(B));	/* set supplies and demands to zero */
+	(void)memset((void *)B, 0, NODES * sizeof(CAPACITY));	/* set supplies and demands to zero */
 
-	create_supply((NODE)SOURCES, (CAPACITY)SUPPLY);
+	create_supply(ctx, (NODE)SOURCES, (CAPACITY)SUPPLY);
+	TRACE_END(PHASE_SUPPLY);
 
 
 	/* Form most of the network skeleton.  First, 60% of the transshipment
 	 * nodes are divided evenly among the various sources; the remainder
 	 * are chained onto the end of the chains belonging to random sources.
 	 */
+	TRACE_BEGIN(PHASE_CHAINS);
 	for(i = 1; i <= SOURCES; i++) {	/* point SOURCES at themselves */
 		pred[i] = i;
 	}
-	handle = make_index_list((INDEX)(SOURCES + 1), (INDEX)(NODES - SINKS));
+	handle = reuse_list(ctx, ctx->skeleton, (INDEX)(SOURCES + 1), (INDEX)(NODES - SINKS));
 	source = 1;
 	for(i = NODES-SOURCES-SINKS; i > (4*(NODES-SOURCES-SINKS)+9)/10; i--) {
-		node = choose_index(handle, (INDEX)randomi(1L, (long)index_size(handle)));
+		node = choose_index(handle, (INDEX)randomi(&ctx->random, 1L, (long)index_size(handle)));
 		pred[node] = pred[source];
 		pred[source] = node;
 		if(++source > SOURCES) {
@@ -186,129 +501,548 @@ ARC netgen(long seed, long parms[])
 		}
 	}
 	for( ; i > 0; --i) {
-		node = choose_index(handle, (INDEX)randomi(1L, (long)index_size(handle)));
-		source = randomi(1L, SOURCES);
+		node = choose_index(handle, (INDEX)randomi(&ctx->random, 1L, (long)index_size(handle)));
+		source = randomi(&ctx->random, 1L, SOURCES);
 		pred[node] = pred[source];
 		pred[source] = node;
 	}
-	free_index_list(handle);
+	TRACE_END(PHASE_CHAINS);
 
+	return 0;
+}
 
-	/* For each source chain, hook it to an "appropriate" number of sinks,
-	 * place capacities and costs on the skeleton edges, and then call
-	 * pick_head to add a bunch of rubbish edges at each node on the chain.
-	 */
 
-  for(source = 1; source <= SOURCES; source++) {
-		sort_count = 0;
-		node = pred[source];
-		while (node != source) {
-			sort_count++;
-			head[sort_count] = node;
-			node = tail[sort_count] = pred[node];
-		}
+/*** Generate the arcs out of one unit of the network.  The units are the
+ *** sources of an assignment problem; otherwise the sources, each with
+ *** its chain, followed by the transshipment sinks.
+ ***/
+PRIVATE void generate_unit(NETGEN_CONTEXT* ctx, NODE unit)
+{
+	long* parms = ctx->parms;
+	INDEX_LIST handle;
+	NODE i;
 
-		if ((NODES-SOURCES-SINKS) == 0) {
-			sinks_per_source = SINKS/SOURCES + 1;
-		} else { /* changing to handle overflows with large n; Mar 18 -- jc */
-			sinks_per_source = ((double) 2*sort_count*SINKS) / ((double) NODES-SOURCES-SINKS);
-		}
+	if(assignment_problem(parms)) {
+		assign_source(ctx, unit + 1);
+	} else if(unit < (NODE)SOURCES) {
+		hook_chain(ctx, unit + 1);
+	} else {
 
-		sinks_per_source = MAX(2, MIN(sinks_per_source, SINKS));
-		sinks = (NODE*) malloc(sinks_per_source * sizeof(NODE));
-		handle = make_index_list((INDEX)(NODES - SINKS), (INDEX)(NODES - 1));
-		
-		for(i = 0; i < sinks_per_source; i++) {
-			sinks[i] = choose_index(handle, (INDEX)randomi(1L, (long)index_size(handle)));
-		}
+		/* Add more rubbish edges out of the transshipment sinks. */
+		TRACE_BEGIN(PHASE_TRANSSHIPMENT);
+		i = NODES - SINKS + 1 + (unit - SOURCES);
+		handle = reuse_list(ctx, ctx->candidates, (INDEX)(SOURCES - TSOURCES + 1), (INDEX)NODES);
+		remove_index(handle, (INDEX)i);
+		pick_head(ctx, handle, i);
+		TRACE_END(PHASE_TRANSSHIPMENT);
+	}
+}
+
+
+/*** For a source's chain, hook it to an "appropriate" number of sinks,
+ *** place capacities and costs on the skeleton edges, and then call
+ *** pick_head to add a bunch of rubbish edges at each node on the chain.
+ ***/
+PRIVATE void hook_chain(NETGEN_CONTEXT* ctx, NODE source)
+{
+	long* parms = ctx->parms;
+	register NODE i,j,k;
+	NODE node;
+	NODE sinks_per_source;
+	NODE * sinks;
+	NODE it;
+	NODE chain_length;
+	COST cost;
+	CAPACITY cap;
+	INDEX_LIST handle;
+	CAPACITY supply_per_sink;
+	CAPACITY partial_supply;
+	NODE sort_count;
+	NODE* pred = ctx->pred;
+	NODE* head = ctx->head;
+	NODE* tail = ctx->tail;
+
+	sort_count = 0;
+	node = pred[source];
+	while (node != source) {
+		sort_count++;
+		head[sort_count] = node;
+		node = tail[sort_count] = pred[node];
+	}
+
+	TRACE_BEGIN(PHASE_SINKS);
+	if ((NODES-SOURCES-SINKS) == 0) {
+		sinks_per_source = SINKS/SOURCES + 1;
+	} else { /* changing to handle overflows with large n; Mar 18 -- jc */
+		sinks_per_source = ((double) 2*sort_count*SINKS) / ((double) NODES-SOURCES-SINKS);
+	}
+
+	sinks_per_source = MAX(2, MIN(sinks_per_source, SINKS));
+	sinks = (NODE*) malloc(sinks_per_source * sizeof(NODE));
+	handle = reuse_list(ctx, ctx->candidates, (INDEX)(NODES - SINKS), (INDEX)(NODES - 1));
+	
+	for(i = 0; i < sinks_per_source; i++) {
+		sinks[i] = choose_index(handle, (INDEX)randomi(&ctx->random, 1L, (long)index_size(handle)));
+	}
     
-		if(source == SOURCES && index_size(handle) > 0) {
-			sinks = (NODE*) realloc((void *)sinks, (sinks_per_source + index_size(handle)) * sizeof(NODE));
-			while(index_size(handle) > 0) {
-				j = choose_index(handle, 1);
-				if(B[j] == 0) {
-					sinks[sinks_per_source++] = j;
-				}
+	if(source == SOURCES && index_size(handle) > 0) {
+		sinks = (NODE*) realloc((void *)sinks, (sinks_per_source + index_size(handle)) * sizeof(NODE));
+		while(index_size(handle) > 0) {
+			j = choose_index(handle, 1);
+			if(B[j] == 0) {
+				sinks[sinks_per_source++] = j;
 			}
 		}
-		free_index_list(handle);
-
-		chain_length = sort_count;
-		supply_per_sink = B[source-1] / sinks_per_source;
-		k = pred[source];
-		for(i = 0; i < sinks_per_source; i++) {
-			sort_count++;
-			partial_supply = randomi(1L, (long)supply_per_sink);
-			j = randomi(0L, (long)sinks_per_source - 1);
-			tail[sort_count] = k;
-			head[sort_count] = sinks[i] + 1;
-			B[sinks[i]] -= partial_supply;
-			B[sinks[j]] -= (supply_per_sink - partial_supply);
-			k = source;
-			for(j = randomi(1L, (long)chain_length); j > 0; j--) {
-				k = pred[k];
-			}
+	}
+
+	chain_length = sort_count;
+	supply_per_sink = B[source-1] / sinks_per_source;
+	k = pred[source];
+	for(i = 0; i < sinks_per_source; i++) {
+		sort_count++;
+		partial_supply = randomi(&ctx->random, 1L, (long)supply_per_sink);
+		j = randomi(&ctx->random, 0L, (long)sinks_per_source - 1);
+		tail[sort_count] = k;
+		head[sort_count] = sinks[i] + 1;
+		TAKE_SUPPLY(sinks[i], partial_supply);
+		TAKE_SUPPLY(sinks[j], supply_per_sink - partial_supply);
+		k = source;
+		for(j = randomi(&ctx->random, 1L, (long)chain_length); j > 0; j--) {
+			k = pred[k];
 		}
+	}
 
-		B[sinks[0]] -= (B[source-1] % sinks_per_source);
-		free((void *)sinks);
-
-		sort_skeleton(sort_count);
-		tail[sort_count+1] = 0;
-		for(i = 1; i <= sort_count; ) {
-			handle = make_index_list((INDEX)(SOURCES - TSOURCES + 1), (INDEX)NODES);
-			remove_index(handle, (INDEX)tail[i]);
-			it = tail[i];
-			while(it == tail[i]) {
-				remove_index(handle, (INDEX)head[i]);
-				cap = SUPPLY;
-				if(randomi(1L, 100L) <= CAPACITATED) {
-					cap = MAX(B[source-1], MINCAP);
-				}
-				cost = MAXCOST;
-				if(randomi(1L, 100L) > HICOST) {
-					cost = randomi(MINCOST, MAXCOST);
-				}
-				SAVE_ARC(it,head[i],cost,cap);
-				i++;
+	TAKE_SUPPLY(sinks[0], B[source-1] % sinks_per_source);
+	free((void *)sinks);
+	TRACE_END(PHASE_SINKS);
+
+	TRACE_BEGIN(PHASE_SORT);
+	sort_skeleton(ctx, sort_count);
+	TRACE_END(PHASE_SORT);
+
+	TRACE_BEGIN(PHASE_SKELETON);
+	tail[sort_count+1] = 0;
+	for(i = 1; i <= sort_count; ) {
+		handle = reuse_list(ctx, ctx->candidates, (INDEX)(SOURCES - TSOURCES + 1), (INDEX)NODES);
+		remove_index(handle, (INDEX)tail[i]);
+		it = tail[i];
+		while(it == tail[i]) {
+			remove_index(handle, (INDEX)head[i]);
+			cap = SUPPLY;
+			if(randomi(&ctx->random, 1L, 100L) <= CAPACITATED) {
+				cap = MAX(B[source-1], MINCAP);
 			}
-			pick_head(parms, handle, it);
-			free_index_list(handle);
+			cost = MAXCOST;
+			if(randomi(&ctx->random, 1L, 100L) > HICOST) {
+				cost = randomi(&ctx->random, MINCOST, MAXCOST);
+			}
+			SAVE_ARC(it,head[i],cost,cap);
+			i++;
 		}
+		pick_head(ctx, handle, it);
 	}
+	TRACE_END(PHASE_SKELETON);
+}
 
 
-	/* Add more rubbish edges out of the transshipment sinks. */
-	for(i = NODES - SINKS + 1; i <= NODES - SINKS + TSINKS; i++) {
-		handle = make_index_list((INDEX)(SOURCES - TSOURCES + 1), (INDEX)NODES);
-		remove_index(handle, (INDEX)i);
-		pick_head(parms, handle, i);
-		free_index_list(handle);
+/*** Match a source of an assignment problem with a random sink, and add
+ *** rubbish edges out of it.
+ ***/
+PRIVATE void assign_source(NETGEN_CONTEXT* ctx, NODE source)
+{
+	long* parms = ctx->parms;
+	INDEX_LIST skeleton = ctx->skeleton;
+	INDEX_LIST handle;
+	INDEX index;
+
+	TRACE_BEGIN(PHASE_ASSIGNMENT);
+	index = choose_index(skeleton, (INDEX)randomi(&ctx->random, 1L, (long)index_size(skeleton)));
+	if(ctx->counting) {
+		ctx->plan->heads[source - 1] = index;
+	}
+	SAVE_ARC(source, index, randomi(&ctx->random, MINCOST, MAXCOST), 1);
+	handle = reuse_list(ctx, ctx->candidates, (INDEX)(SOURCES + 1), (INDEX)NODES);
+	remove_index(handle, index);
+	pick_head(ctx, handle, source);
+	TRACE_END(PHASE_ASSIGNMENT);
+}
+
+
+/*** Find the first unit of a shard: the first whose checkpoint has at
+ *** least the shard's share of the arcs before it.
+ ***/
+PRIVATE NODE shard_unit(SHARD_PLAN* plan, int shard, int shards)
+{
+	ARC arcs = plan->checkpoints[plan->units].arc_count;
+	ARC target;
+	NODE low = 0, high = plan->units, middle;
+
+	if(shard <= 0) {
+		return 0;
+	}
+	if(shard >= shards) {
+		return plan->units;
+	}
+
+	target = (ARC)((double)arcs * shard / shards);
+	while(low < high) {
+		middle = low + (high - low) / 2;
+		if(plan->checkpoints[middle].arc_count < target) {
+			low = middle + 1;
+		} else {
+			high = middle;
+		}
 	}
+	return low;
+}
 
-	return arc_count;
+
+/*** Record a change to a sink's supply while planning shards. */
+
+PRIVATE void note_change(NETGEN_CONTEXT* ctx, NODE node, CAPACITY amount)
+{
+	SHARD_PLAN* plan = ctx->plan;
+	CHANGE* changes;
+	ARC space;
+
+	if(plan->change_count == plan->change_space) {
+		space = plan->change_space + plan->change_space / 2 + 16;
+		if((changes = (CHANGE*) realloc((void *)plan->changes, space * sizeof(CHANGE))) == NULL) {
+			ctx->status = ALLOCATION_FAILURE;
+			return;
+		}
+		plan->changes = changes;
+		plan->change_space = space;
+	}
+
+	plan->changes[plan->change_count].node = node;
+	plan->changes[plan->change_count].amount = amount;
+	plan->change_count++;
 }
 
 
-void create_supply(NODE sources, CAPACITY supply)
+/*** Free a plan of shards. */
+
+PRIVATE void free_plan(SHARD_PLAN* plan)
+{
+	if(plan == NULL) {
+		return;
+	}
+
+	free((void *)plan->checkpoints);
+	free((void *)plan->changes);
+	free((void *)plan->heads);
+	free((void *)plan->b);
+	free((void *)plan);
+}
+
+
+/*** Check a seed and a set of parameters before generating.  Returns
+ *** zero if they are valid, BAD_SEED or BAD_PARMS if not.
+ ***/
+long check_parms(long seed, long parms[])
+{
+	if(seed <= 0) {
+		return BAD_SEED;
+	}
+	if((NODES <= 0) || (NODES > DENSITY) || (SOURCES <= 0) || (SINKS <= 0) ||
+      (SOURCES + SINKS > NODES) || (MINCOST > MAXCOST) || (SUPPLY < SOURCES) ||
+      (TSOURCES > SOURCES) || (TSINKS > SINKS) || (HICOST < 0 || HICOST > 100) ||
+      (CAPACITATED < 0 || CAPACITATED > 100) || (MINCAP > MAXCAP)) {
+		return BAD_PARMS;
+	}
+
+	return 0;
+}
+
+
+/*** Make sure the context can hold a network of the given size, in the
+ *** storage choose_storage picked.  Arrays already large enough are kept
+ *** as they are; those of the other storage are freed.  Returns zero on
+ *** success, TOO_BIG if the sizes cannot be addressed, or
+ *** ALLOCATION_FAILURE.
+ ***/
+long reserve_network(NETGEN_CONTEXT* ctx, NODE nodes, ARC arcs)
+{
+	if(nodes > (size_t)-1 / sizeof(NODE) || arcs > (size_t)-1 / sizeof(NODE)) {
+		return TOO_BIG;
+	}
+
+	if(nodes > ctx->node_space) {
+		free_pages((void *)ctx->b);
+		free_pages((void *)ctx->pred);
+		free_pages((void *)ctx->head);
+		free_pages((void *)ctx->tail);
+		ctx->b    = (CAPACITY*) alloc_pages(nodes * sizeof(CAPACITY), ctx->pages);
+		ctx->pred = (NODE*) alloc_pages(nodes * sizeof(NODE), ctx->pages);
+		ctx->head = (NODE*) alloc_pages(nodes * sizeof(NODE), ctx->pages);
+		ctx->tail = (NODE*) alloc_pages(nodes * sizeof(NODE), ctx->pages);
+		if(!ctx->b || !ctx->pred || !ctx->head || !ctx->tail) {
+			ctx->node_space = 0;
+			return ALLOCATION_FAILURE;
+		}
+		ctx->node_space = nodes;
+	}
+
+	if(ctx->narrow ? ctx->from != NULL : ctx->from32 != NULL) {
+		free_pages((void *)ctx->from);
+		free_pages((void *)ctx->to);
+		free_pages((void *)ctx->u);
+		free_pages((void *)ctx->c);
+		free_pages((void *)ctx->from32);
+		free_pages((void *)ctx->to32);
+		free_pages((void *)ctx->u32);
+		free_pages((void *)ctx->c32);
+		ctx->from = ctx->to = NULL;
+		ctx->u = NULL;
+		ctx->c = NULL;
+		ctx->from32 = ctx->to32 = NULL;
+		ctx->u32 = ctx->c32 = NULL;
+		ctx->arc_space = 0;
+	}
+
+	if(arcs > ctx->arc_space && ctx->narrow) {
+		free_pages((void *)ctx->from32);
+		free_pages((void *)ctx->to32);
+		free_pages((void *)ctx->u32);
+		free_pages((void *)ctx->c32);
+		ctx->from32 = (COMPACT_NODE*) alloc_pages(arcs * sizeof(COMPACT_NODE), ctx->pages);
+		ctx->to32   = (COMPACT_NODE*) alloc_pages(arcs * sizeof(COMPACT_NODE), ctx->pages);
+		ctx->u32    = (COMPACT_VALUE*) alloc_pages(arcs * sizeof(COMPACT_VALUE), ctx->pages);
+		ctx->c32    = (COMPACT_VALUE*) alloc_pages(arcs * sizeof(COMPACT_VALUE), ctx->pages);
+		if(!ctx->from32 || !ctx->to32 || !ctx->u32 || !ctx->c32) {
+			ctx->arc_space = 0;
+			return ALLOCATION_FAILURE;
+		}
+		ctx->arc_space = arcs;
+		if(ctx->pages != PAGES_NORMAL && !ctx->fast && !ctx->sink) {
+			spread_pages((void *)ctx->from32, arcs * sizeof(COMPACT_NODE));
+			spread_pages((void *)ctx->to32, arcs * sizeof(COMPACT_NODE));
+			spread_pages((void *)ctx->u32, arcs * sizeof(COMPACT_VALUE));
+			spread_pages((void *)ctx->c32, arcs * sizeof(COMPACT_VALUE));
+		}
+	} else if(arcs > ctx->arc_space) {
+		free_pages((void *)ctx->from);
+		free_pages((void *)ctx->to);
+		free_pages((void *)ctx->u);
+		free_pages((void *)ctx->c);
+		ctx->from = (NODE*) alloc_pages(arcs * sizeof(NODE), ctx->pages);
+		ctx->to   = (NODE*) alloc_pages(arcs * sizeof(NODE), ctx->pages);
+		ctx->u    = (CAPACITY*) alloc_pages(arcs * sizeof(CAPACITY), ctx->pages);
+		ctx->c    = (COST*) alloc_pages(arcs * sizeof(COST), ctx->pages);
+		if(!ctx->from || !ctx->to || !ctx->u || !ctx->c) {
+			ctx->arc_space = 0;
+			return ALLOCATION_FAILURE;
+		}
+		ctx->arc_space = arcs;
+		if(ctx->pages != PAGES_NORMAL && !ctx->fast && !ctx->sink) {
+			spread_pages((void *)ctx->from, arcs * sizeof(NODE));
+			spread_pages((void *)ctx->to, arcs * sizeof(NODE));
+			spread_pages((void *)ctx->u, arcs * sizeof(CAPACITY));
+			spread_pages((void *)ctx->c, arcs * sizeof(COST));
+		}
+	}
+
+	return 0;
+}
+
+
+/*** Decide whether every arc of a problem fits in compact storage: node
+ *** numbers in a COMPACT_NODE, and the capacities (SUPPLY, a supply, or
+ *** one of [MINCAP, MAXCAP]) and costs ([MINCOST, MAXCOST]) in a
+ *** COMPACT_VALUE.
+ ***/
+int compact_fits(long parms[])
+{
+	return (unsigned long)NODES <= UINT_MAX &&
+	       SUPPLY <= INT_MAX && MINCAP >= INT_MIN && MAXCAP <= INT_MAX &&
+	       MINCOST >= INT_MIN && MAXCOST <= INT_MAX;
+}
+
+
+/*** Pick the storage of the next network: compact if the context asks
+ *** for it and the problem fits, the usual 64-bit arrays otherwise.
+ ***/
+void choose_storage(NETGEN_CONTEXT* ctx, long parms[])
+{
+	ctx->narrow = ctx->compact && compact_fits(parms);
+}
+
+
+/*** Copy count arcs of the arrays, from the first given, into arrays of
+ *** the usual types, whatever the storage.  Arrays passed as NULL are
+ *** skipped.
+ ***/
+void copy_arcs(NETGEN_CONTEXT* ctx, ARC first, ARC count, NODE* from, NODE* to, CAPACITY* u, COST* c)
+{
+	ARC a;
+
+	if(!ctx->narrow) {
+		if(from != NULL) {
+			(void)memcpy((void *)from, (void *)(FROM + first), count * sizeof(NODE));
+		}
+		if(to != NULL) {
+			(void)memcpy((void *)to, (void *)(TO + first), count * sizeof(NODE));
+		}
+		if(u != NULL) {
+			(void)memcpy((void *)u, (void *)(U + first), count * sizeof(CAPACITY));
+		}
+		if(c != NULL) {
+			(void)memcpy((void *)c, (void *)(C + first), count * sizeof(COST));
+		}
+		return;
+	}
+
+	for(a = 0; from != NULL && a < count; a++) {
+		from[a] = (NODE)ctx->from32[first + a];
+	}
+	for(a = 0; to != NULL && a < count; a++) {
+		to[a] = (NODE)ctx->to32[first + a];
+	}
+	for(a = 0; u != NULL && a < count; a++) {
+		u[a] = (CAPACITY)ctx->u32[first + a];
+	}
+	for(a = 0; c != NULL && a < count; a++) {
+		c[a] = (COST)ctx->c32[first + a];
+	}
+}
+
+
+/*** Make room for one more arc once the arc arrays are full.  With a
+ *** sink, the block is handed over and the arrays start afresh; without,
+ *** the arrays are enlarged by half, as happens when the skeleton and
+ *** rubbish arcs overrun the requested density.  On failure the context's
+ *** status is set and the arc is dropped.
+ ***/
+PRIVATE int make_room(NETGEN_CONTEXT* ctx)
+{
+	ARC space = ctx->arc_space + ctx->arc_space / 2 + 16;
+	NODE* from;
+	NODE* to;
+	CAPACITY* u;
+	COST* c;
+
+	if(ctx->sink) {
+		if(ctx->status == 0 && ctx->sink(ctx->sink_data, ctx, ctx->arc_count - ctx->arc_base) != 0) {
+			ctx->status = OUTPUT_FAILURE;
+		}
+		ctx->arc_base = ctx->arc_count;
+		return ctx->status == 0;
+	}
+
+	if(space > (size_t)-1 / sizeof(NODE)) {
+		ctx->status = TOO_BIG;
+		return 0;
+	}
+
+	if(ctx->narrow) {
+		return grow_compact(ctx, space);
+	}
+
+	if((from = (NODE*) resize_pages((void *)ctx->from, space * sizeof(NODE), ctx->pages)) != NULL) {
+		ctx->from = from;
+	}
+	if((to = (NODE*) resize_pages((void *)ctx->to, space * sizeof(NODE), ctx->pages)) != NULL) {
+		ctx->to = to;
+	}
+	if((u = (CAPACITY*) resize_pages((void *)ctx->u, space * sizeof(CAPACITY), ctx->pages)) != NULL) {
+		ctx->u = u;
+	}
+	if((c = (COST*) resize_pages((void *)ctx->c, space * sizeof(COST), ctx->pages)) != NULL) {
+		ctx->c = c;
+	}
+	if(!from || !to || !u || !c) {
+		ctx->status = ALLOCATION_FAILURE;
+		return 0;
+	}
+
+	ctx->arc_space = space;
+	return 1;
+}
+
+
+/*** Enlarge the compact arc arrays to the given length, as make_room
+ *** does the usual ones.
+ ***/
+PRIVATE int grow_compact(NETGEN_CONTEXT* ctx, ARC space)
+{
+	COMPACT_NODE* from;
+	COMPACT_NODE* to;
+	COMPACT_VALUE* u;
+	COMPACT_VALUE* c;
+
+	if((from = (COMPACT_NODE*) resize_pages((void *)ctx->from32, space * sizeof(COMPACT_NODE), ctx->pages)) != NULL) {
+		ctx->from32 = from;
+	}
+	if((to = (COMPACT_NODE*) resize_pages((void *)ctx->to32, space * sizeof(COMPACT_NODE), ctx->pages)) != NULL) {
+		ctx->to32 = to;
+	}
+	if((u = (COMPACT_VALUE*) resize_pages((void *)ctx->u32, space * sizeof(COMPACT_VALUE), ctx->pages)) != NULL) {
+		ctx->u32 = u;
+	}
+	if((c = (COMPACT_VALUE*) resize_pages((void *)ctx->c32, space * sizeof(COMPACT_VALUE), ctx->pages)) != NULL) {
+		ctx->c32 = c;
+	}
+	if(!from || !to || !u || !c) {
+		ctx->status = ALLOCATION_FAILURE;
+		return 0;
+	}
+
+	ctx->arc_space = space;
+	return 1;
+}
+
+
+/*** Reset one of the context's index lists to a new range.  An invalid
+ *** range leaves an empty list, as make_index_list's NULL handle did;
+ *** running out of memory is recorded in the context's status.
+ ***/
+PRIVATE INDEX_LIST reuse_list(NETGEN_CONTEXT* ctx, INDEX_LIST handle, INDEX from, INDEX to)
+{
+	if(reset_index_list(handle, from, to) == -2) {
+		ctx->status = ALLOCATION_FAILURE;
+	}
+	return handle;
+}
+
+
+/*** Hand the last block to the sink, if any, and return what netgen()
+ *** should: the number of arcs, or the first error met.
+ ***/
+PRIVATE long finish_network(NETGEN_CONTEXT* ctx)
+{
+	if(ctx->sink && ctx->status == 0 && ctx->arc_count > ctx->arc_base) {
+		if(ctx->sink(ctx->sink_data, ctx, ctx->arc_count - ctx->arc_base) != 0) {
+			ctx->status = OUTPUT_FAILURE;
+		}
+		ctx->arc_base = ctx->arc_count;
+	}
+
+	return ctx->status ? ctx->status : (long)ctx->arc_count;
+}
+
+
+void create_supply(NETGEN_CONTEXT* ctx, NODE sources, CAPACITY supply)
 {
 	CAPACITY supply_per_source = supply / sources;
 	CAPACITY partial_supply;
 	NODE i;
 
 	for(i = 0; i < sources; i++) {
-		B[i] += (partial_supply = randomi(1L, (long)supply_per_source));
-		B[randomi(0L, (long)(sources - 1))] += supply_per_source - partial_supply;
+		B[i] += (partial_supply = randomi(&ctx->random, 1L, (long)supply_per_source));
+		B[randomi(&ctx->random, 0L, (long)(sources - 1))] += supply_per_source - partial_supply;
 	}
 	
-	B[randomi(0L, (long)(sources - 1))] += supply % sources;
+	B[randomi(&ctx->random, 0L, (long)(sources - 1))] += supply % sources;
 }
 
 
-void create_assignment(long parms[])
+/*** Set up an assignment problem: unit supplies and demands, and the
+ *** list of sinks not yet matched with a source by assign_source.
+ ***/
+void create_assignment(NETGEN_CONTEXT* ctx)
 {
-	INDEX_LIST skeleton, handle;
-	INDEX index;
+	long* parms = ctx->parms;
 	NODE source;
 
 	for(source = 0; source < NODES/2; source++) {
@@ -318,23 +1052,16 @@ void create_assignment(long parms[])
 		B[source] = -1;
 	}
 
-	skeleton = make_index_list((INDEX)(SOURCES + 1), (INDEX)NODES);
-	for(source = 1; source <= NODES/2; source++) {
-		index = choose_index(skeleton, (INDEX)randomi(1L, (long)index_size(skeleton)));
-		SAVE_ARC(source, index, randomi(MINCOST, MAXCOST), 1);
-		handle = make_index_list((INDEX)(SOURCES + 1), (INDEX)NODES);
-		remove_index(handle, index);
-		pick_head(parms, handle, source);
-		free_index_list(handle);
-	}
-	free_index_list(skeleton);
+	(void)reuse_list(ctx, ctx->skeleton, (INDEX)(SOURCES + 1), (INDEX)NODES);
 }
 
 
-void sort_skeleton(int sort_count) 		/* Shell sort */
+void sort_skeleton(NETGEN_CONTEXT* ctx, NODE sort_count) 		/* Shell sort */
 {
-	int m,i,j,k;
-	int temp;
+	NODE* head = ctx->head;
+	NODE* tail = ctx->tail;
+	long m,i,j,k;
+	NODE temp;
 
 	m = sort_count;
 	while((m /= 2) != 0) {
@@ -355,75 +1082,154 @@ void sort_skeleton(int sort_count) 		/* Shell sort */
 }
 
 
-void pick_head(long parms[], INDEX_LIST handle, NODE desired_tail)
+void pick_head(NETGEN_CONTEXT* ctx, INDEX_LIST handle, NODE desired_tail)
 {
+	long* parms = ctx->parms;
 	NODE non_sources = NODES - SOURCES + TSOURCES;
 
 /* changing Aug 29 -- jc
   ARC remaining_arcs = DENSITY - arc_count;
 */
-	int remaining_arcs = (int) DENSITY - (int) arc_count;
+	long remaining_arcs = (long) DENSITY - (long) ctx->arc_count;
 
 	INDEX index;
-	int limit;
+	long limit;
 	long upper_bound;
 	CAPACITY cap;
 
 /* changing Aug 29 -- jc
 */
-	nodes_left--;
-	if((2 * (int) nodes_left) >= (int) remaining_arcs) {
+	ctx->nodes_left--;
+	if((2 * (long) ctx->nodes_left) >= remaining_arcs) {
 		return;
 	}
 
-	if((remaining_arcs + non_sources - pseudo_size(handle) - 1) / (nodes_left + 1) >= non_sources - 1) {
+	TRACE_BEGIN(PHASE_PICK_HEAD);
+
+	if((remaining_arcs + non_sources - pseudo_size(handle) - 1) / (ctx->nodes_left + 1) >= non_sources - 1) {
 		limit = non_sources;
 	} else {
-		upper_bound = 2 * (remaining_arcs / (nodes_left + 1) - 1);
+		upper_bound = 2 * (remaining_arcs / (ctx->nodes_left + 1) - 1);
+		TRACE_BEGIN(PHASE_REJECTION);
 		do {
-			limit = randomi(1L, upper_bound);
-			if(nodes_left == 0) {
+			TRACE_COUNT(TRACE_REJECTION_DRAWS, 1);
+			limit = randomi(&ctx->random, 1L, upper_bound);
+			if(ctx->nodes_left == 0) {
 				limit = remaining_arcs;
 			}
 /* changing to handle overflows with large n; Mar 18 -- jc */
-		} while(((double) nodes_left * (non_sources - 1)) < ((double) remaining_arcs - limit));
+		} while(((double) ctx->nodes_left * (non_sources - 1)) < ((double) remaining_arcs - limit));
+		TRACE_END(PHASE_REJECTION);
+	}
+
+	if(ctx->counting) {
+		count_rubbish(ctx, handle, limit);
+		TRACE_END(PHASE_PICK_HEAD);
+		return;
 	}
 
 	for( ; limit > 0; limit--) {
-		index = choose_index(handle, (INDEX)randomi(1L, (long)pseudo_size(handle)));
+		index = choose_index(handle, (INDEX)randomi(&ctx->random, 1L, (long)pseudo_size(handle)));
 		cap = SUPPLY;
-		if(randomi(1L, 100L) <= CAPACITATED) {
-			cap = randomi(MINCAP, MAXCAP);
+		if(randomi(&ctx->random, 1L, 100L) <= CAPACITATED) {
+			cap = randomi(&ctx->random, MINCAP, MAXCAP);
 		}
 
 /* adding Aug 29 -- jc */
 		if((1 <= index) && (index <= NODES)) {
-			SAVE_ARC(desired_tail, index, randomi(MINCOST, MAXCOST), cap);
+			SAVE_ARC(desired_tail, index, randomi(&ctx->random, MINCOST, MAXCOST), cap);
 		}
 	}
+	TRACE_END(PHASE_PICK_HEAD);
 }
 
 
-/*** Print an appropriate error message and then exit with a nonzero code. */
+/*** Count the rubbish arcs pick_head would add, drawing the same random
+ *** numbers without choosing any heads.  Whether a head is found depends
+ *** only on the size of the list, not on the position drawn: the list
+ *** holds at least pseudo_size heads, so a head is found as long as its
+ *** pseudo-size is positive.  When all arcs or none are capacitated, each
+ *** arc takes a fixed count of draws, and the sequence jumps past them.
+ ***/
+PRIVATE void count_rubbish(NETGEN_CONTEXT* ctx, INDEX_LIST handle, long limit)
+{
+	long* parms = ctx->parms;
+	long heads = (long)pseudo_size(handle);
+	long found = limit < heads ? limit : MAX(heads, 0);
 
-void error_exit(long rc)
+	if(limit <= 0) {
+		return;
+	}
+
+	ctx->arc_count += found;
+	if(CAPACITATED == 0 || CAPACITATED == 100) {
+		skip_randomi(&ctx->random, (unsigned long)limit * (CAPACITATED ? 3 : 2) + (unsigned long)found);
+		return;
+	}
+
+	for( ; limit > 0; limit--, found--) {
+		(void)randomi(&ctx->random, 0L, 0L);					/* position of the head */
+		if(randomi(&ctx->random, 1L, 100L) <= CAPACITATED) {
+			(void)randomi(&ctx->random, 0L, 0L);				/* capacity */
+		}
+		if(found > 0) {
+			(void)randomi(&ctx->random, 0L, 0L);				/* cost */
+		}
+	}
+}
+
+
+/*** Estimate the memory, in bytes, that netgen() needs for a problem:
+ *** the network and skeleton arrays plus the two largest index lists
+ *** that can be alive at the same time.  The arc arrays hold every arc,
+ *** or only a block of the given number of arcs when they go to a sink,
+ *** and take half the space when compact storage is asked for and the
+ *** problem fits it.  The output's own buffers, if any, are given as
+ *** extra bytes.
+ ***/
+size_t netgen_footprint(long parms[], ARC block, int compact, size_t extra)
+{
+	size_t nodes = (size_t)NODES + 3;
+	size_t arcs = (size_t)DENSITY;
+	size_t arc_size = 2 * sizeof(NODE) + sizeof(CAPACITY) + sizeof(COST);
+
+	if(block > 0 && (size_t)block < arcs) {
+		arcs = (size_t)block;
+	}
+	if(compact && compact_fits(parms)) {
+		arc_size = 2 * sizeof(COMPACT_NODE) + 2 * sizeof(COMPACT_VALUE);
+	}
+	return arcs * arc_size +
+	       nodes * (3 * sizeof(NODE) + sizeof(CAPACITY)) +
+	       2 * index_list_space((INDEX)1, (INDEX)NODES) + extra;
+}
+
+
+/*** Return an appropriate error message for a netgen() return code. */
+
+const char* error_message(long rc)
 {
 	switch (rc) {
 		case BAD_SEED:
-			fprintf(stderr, "NETGEN requires a positive random seed\n");
-			break;
+			return "NETGEN requires a positive random seed";
 		case TOO_BIG:
-			fprintf(stderr, "Problem too large for generator\n");
-			break;
+			return "Problem too large for generator";
 		case BAD_PARMS:
-			fprintf(stderr, "Inconsistent parameter settings - check the input\n");
-			break;
+			return "Inconsistent parameter settings - check the input";
 		case ALLOCATION_FAILURE:
-			fprintf(stderr, "Memory allocation failure\n");
-			break;
+			return "Memory allocation failure";
+		case OUTPUT_FAILURE:
+			return "Unable to write output file";
 		default:
-			fprintf(stderr, "Internal error\n");
-			break;
+			return "Internal error";
 	}
+}
+
+
+/*** Print an appropriate error message and then exit with a nonzero code. */
+
+void error_exit(long rc)
+{
+	fprintf(stderr, "%s\n", error_message(rc));
 	exit(1000 - (int)rc);
 }
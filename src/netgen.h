@@ -17,6 +17,7 @@
 #define TOO_BIG   -2
 #define BAD_PARMS -3
 #define ALLOCATION_FAILURE -4
+#define OUTPUT_FAILURE -5
 
 #define PROBLEM_PARMS	13				/* aliases for generation parameters           */
 #define NODES	    	parms[0]		/* number of nodes                             */
@@ -39,7 +40,60 @@ typedef unsigned long NODE;		/* node number */
 typedef unsigned long ARC;		/* arc number */
 typedef long CAPACITY;			/* arc capacity */
 typedef long COST;				/* arc cost */
-
+typedef unsigned int COMPACT_NODE;	/* node number, in compact storage */
+typedef int COMPACT_VALUE;		/* capacity or cost, in compact storage */
+
+typedef struct netgen_context NETGEN_CONTEXT;
+typedef struct shard_plan SHARD_PLAN;
+
+typedef int (*ARC_SINK)(void*, NETGEN_CONTEXT*, ARC);	/* consumes the first arcs of the arc arrays */
+
+#define ARC_BLOCK 65536			/* default number of arcs handed to a sink at a time */
+
+#ifndef NETGEN_COMPACT
+#define NETGEN_COMPACT 0		/* nonzero to store arcs in 32 bits by default */
+#endif /* NETGEN_COMPACT */
+
+#ifndef NETGEN_PAGES
+#define NETGEN_PAGES 0			/* PAGES_ mode (pages.h) of large arrays by default */
+#endif /* NETGEN_PAGES */
+
+struct netgen_context {
+	long* parms;				/* parameters of the problem being generated  */
+	long status;				/* first error met while generating, or zero  */
+	RANDOM random;				/* state of the random number sequence        */
+	ARC arc_count;				/* number of arcs generated so far            */
+	ARC arc_base;				/* number of arcs already handed to the sink  */
+	ARC arc_space;				/* allocated length of the arc arrays         */
+	ARC_SINK sink;				/* receives arcs in blocks, or NULL to keep   */
+	void* sink_data;			/* them all in the arc arrays                 */
+	ARC block;					/* arcs per block handed to the sink          */
+	NODE nodes_left;			/* nodes still waiting for their rubbish arcs */
+	NODE node_space;			/* allocated length of the node arrays        */
+	NODE* from;					/* origin of each arc                         */
+	NODE* to;					/* destination                                */
+	CAPACITY* u;				/* capacity                                   */
+	COST* c;					/* cost                                       */
+	int compact;				/* nonzero to store arcs in 32 bits when the  */
+								/* parameters allow it                        */
+	int narrow;					/* set if the arcs are in the arrays below    */
+	COMPACT_NODE* from32;		/* compact storage, used instead of from, to, */
+	COMPACT_NODE* to32;			/* u and c while narrow is set                */
+	COMPACT_VALUE* u32;
+	COMPACT_VALUE* c32;
+	CAPACITY* b;				/* supply (demand) at each node               */
+	NODE* pred;					/* skeleton chains, linked through sources    */
+	NODE* head;					/* skeleton arcs being sorted by tail         */
+	NODE* tail;
+	INDEX_LIST skeleton;		/* index lists reused throughout generation   */
+	INDEX_LIST candidates;
+	int engine;					/* their engine, or zero for the default      */
+	int pages;					/* PAGES_ mode of the network and index lists */
+	int fast;					/* nonzero to generate in the fast mode       */
+	int fast_threads;			/* its threads, all processors if zero        */
+	int counting;				/* nonzero while planning shards              */
+	SHARD_PLAN* plan;			/* checkpoints of the last plan_shards        */
+};
 
 /*** Function prototypes */
 
@@ -48,12 +102,29 @@ typedef long COST;				/* arc cost */
 #include <stdlib.h>
 #include <string.h>
 
-ARC netgen(long, long*);	    				/* C external interface       */
-
-void create_supply(NODE, CAPACITY); 		/* create supply nodes                       */
-void create_assignment(long *);				/* create assignment problem                 */
-void sort_skeleton(int);					/* sorts skeleton chains                     */
-void pick_head(long *, int, NODE); 			/* choose destination nodes for rubbish arcs */
+NETGEN_CONTEXT* make_netgen_context(void);	/* allocates an empty generator context      */
+void free_netgen_context(NETGEN_CONTEXT*);	/* frees a context and the network it holds  */
+void set_arc_sink(NETGEN_CONTEXT*, ARC_SINK, void*, ARC);	/* streams arcs to a sink as generated */
+void set_index_engine(NETGEN_CONTEXT*, int);	/* engine of the context's large index lists */
+void set_fast_mode(NETGEN_CONTEXT*, int);	/* generates in parallel, off if negative    */
+void set_compact_storage(NETGEN_CONTEXT*, int);	/* stores arcs in 32 bits when they fit */
+void set_page_mode(NETGEN_CONTEXT*, int);	/* backs large arrays with huge pages        */
+ARC netgen(NETGEN_CONTEXT*, long, long*);	/* C external interface                      */
+ARC netgen_fast(NETGEN_CONTEXT*, long, long*);	/* parallel generator, not bit-compatible */
+size_t netgen_footprint(long*, ARC, int, size_t);	/* estimated memory needed by a problem */
+long check_parms(long, long*);				/* validates a seed and parameters           */
+long reserve_network(NETGEN_CONTEXT*, NODE, ARC);	/* sizes a context's network storage */
+int compact_fits(long*);					/* can arcs of a problem be stored compact   */
+void choose_storage(NETGEN_CONTEXT*, long*);	/* picks compact or wide storage for it  */
+void copy_arcs(NETGEN_CONTEXT*, ARC, ARC, NODE*, NODE*, CAPACITY*, COST*);	/* widens a run of arcs */
+long plan_shards(NETGEN_CONTEXT*, long, long*);	/* checkpoints a problem for netgen_shard */
+long netgen_shard(NETGEN_CONTEXT*, long, long*, int, int);	/* generates one shard of it  */
+
+void create_supply(NETGEN_CONTEXT*, NODE, CAPACITY); 	/* create supply nodes            */
+void create_assignment(NETGEN_CONTEXT*);	/* set up an assignment problem              */
+void sort_skeleton(NETGEN_CONTEXT*, NODE);	/* sorts skeleton chains                     */
+void pick_head(NETGEN_CONTEXT*, INDEX_LIST, NODE); 	/* choose destination nodes for rubbish arcs */
+const char* error_message(long);			/* describes a netgen() error code           */
 void error_exit(long);						/* print error message and exit              */
 
 #else
@@ -64,35 +135,56 @@ void free();				/* ditto */
 void *memset();				/* ditto */
 void exit();				/* ditto */
 
-ARC netgen();		    	/* C external interface       */
+NETGEN_CONTEXT* make_netgen_context();	/* allocates an empty generator context */
+void free_netgen_context();	/* frees a context and the network it holds   */
+void set_arc_sink();		/* streams arcs to a sink as generated        */
+void set_index_engine();	/* engine of the context's large index lists  */
+void set_fast_mode();		/* generates in parallel, off if negative     */
+void set_compact_storage();	/* stores arcs in 32 bits when they fit       */
+void set_page_mode();		/* backs large arrays with huge pages         */
+ARC netgen();		    	/* C external interface                       */
+ARC netgen_fast();			/* parallel generator, not bit-compatible     */
+unsigned long netgen_footprint(); /* estimated memory needed by a problem       */
+long check_parms();			/* validates a seed and parameters            */
+long reserve_network();		/* sizes a context's network storage          */
+int compact_fits();			/* can arcs of a problem be stored compact    */
+void choose_storage();		/* picks compact or wide storage for it       */
+void copy_arcs();			/* widens a run of arcs                       */
+long plan_shards();			/* checkpoints a problem for netgen_shard     */
+long netgen_shard();		/* generates one shard of it                  */
 
 void create_supply();		/* create supply nodes                        */
-void create_assignment();	/* create assignment problem                  */
+void create_assignment();	/* set up an assignment problem               */
 void sort_skeleton();		/* sorts skeleton chains                      */
 void pick_head();			/* chooses destination nodes for rubbish arcs */
+char* error_message();		/* describes a netgen() error code            */
 void error_exit();			/* print error message and exit               */
 
 #endif /* __STDC__ */
 
-#define MAXNODES 17000	    		/* maximum problem sizes */
-#define MAXARCS 150000
-
-#define FROM arrays_	    		/* aliases for network storage */
-#define TO   arraye_
-#define U    arrayu_
-#define C    arrayc_
-#define B    arrayb_
-
-#ifdef ALLOCATE_NETWORK	    		/* storage definitions */
-#define EXTERN 
-#else
-#define EXTERN extern
-#endif /* ALLOCATE_NETWORK */
-
-EXTERN NODE     FROM[MAXARCS];	/* origin of each arc */
-EXTERN NODE     TO  [MAXARCS];	/* destination */
-EXTERN CAPACITY U   [MAXARCS];	/* capacity */
-EXTERN COST     C   [MAXARCS];	/* cost */
-EXTERN CAPACITY B   [MAXNODES];	/* supply (demand) at each node */
+#define FROM ctx->from	    		/* aliases for network storage, held by a */
+#define TO   ctx->to				/* NETGEN_CONTEXT named ctx               */
+#define U    ctx->u
+#define C    ctx->c
+#define B    ctx->b
+
+#define ARC_FROM(a)	(ctx->narrow ? (NODE)ctx->from32[a] : ctx->from[a])	/* arc a, whatever */
+#define ARC_TO(a)	(ctx->narrow ? (NODE)ctx->to32[a] : ctx->to[a])		/* the storage     */
+#define ARC_U(a)	(ctx->narrow ? (CAPACITY)ctx->u32[a] : ctx->u[a])
+#define ARC_C(a)	(ctx->narrow ? (COST)ctx->c32[a] : ctx->c[a])
+#define STORE_ARC(a, tail, head, cost, capacity)	/* sets arc a in either storage */ \
+  {				\
+    if(ctx->narrow) {		\
+      ctx->from32[a] = (COMPACT_NODE)(tail);	\
+      ctx->to32  [a] = (COMPACT_NODE)(head);	\
+      ctx->c32   [a] = (COMPACT_VALUE)(cost);	\
+      ctx->u32   [a] = (COMPACT_VALUE)(capacity); \
+    } else {			\
+      FROM[a] = tail;		\
+      TO  [a] = head;		\
+      C   [a] = cost;		\
+      U   [a] = capacity;	\
+    }				\
+  }
 
 #endif /* NETGEN_H */
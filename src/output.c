@@ -0,0 +1,210 @@
+/*** output.c - generate a problem into a file in the requested format */
+
+/*** Callers choose how a problem is written through an OUTPUT_OPTIONS,
+ *** and generate_problem runs the generator and the matching writer, so
+ *** that interactive and batch runs support the same output modes.
+ ***/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "output.h"
+#include "dimacs.h"
+#include "binary.h"
+#include "packed.h"
+#include "pages.h"
+#include "trace.h"
+
+/*** Local constants */
+
+#define REPORT_SPACE	4096		/* bytes of a placement report         */
+#define MEGABYTE		1048576.0
+
+/*** Private functions */
+
+static long write_problem(const char*, NETGEN_CONTEXT*, long, long, long*, const OUTPUT_OPTIONS*);
+static void report_placement(FILE*, NETGEN_CONTEXT*, long);
+static char* describe_array(char*, const char*, const void*, size_t);
+
+
+/*** Generate a problem with the given context and write it to the named
+ *** file.  Returns the number of arcs, a netgen() error code, or
+ *** OUTPUT_FAILURE if the file cannot be written.  With a page mode, where
+ *** the large arrays were placed is reported on the standard error.
+ ***/
+long generate_problem(const char* filename, NETGEN_CONTEXT* ctx, long seed, long problem, long parms[], const OUTPUT_OPTIONS* options)
+{
+	long arcs = write_problem(filename, ctx, seed, problem, parms, options);
+
+	if(options->pages != PAGES_NORMAL && arcs >= 0) {
+		report_placement(stderr, ctx, problem);
+	}
+	return arcs;
+}
+
+
+/*** Set up the context as the options ask, then generate and write the
+ *** problem, as generate_problem does.
+ ***/
+static long write_problem(const char* filename, NETGEN_CONTEXT* ctx, long seed, long problem, long parms[], const OUTPUT_OPTIONS* options)
+{
+	FILE* fout;
+	char name[256];
+	long arcs;
+	int rc;
+
+	if(options->engine) {
+		set_index_engine(ctx, options->engine);
+	}
+	set_fast_mode(ctx, !options->fast ? -1 : options->fast_threads > 0 ? options->fast_threads : 0);
+	set_compact_storage(ctx, options->compact);
+	set_page_mode(ctx, options->pages);
+
+	if(options->shards > 1) {
+		if(strlen(filename) + 16 > sizeof(name)) {
+			return OUTPUT_FAILURE;
+		}
+		sprintf(name, "%s.%d", filename, options->shard);
+		if((fout = fopen(name, "w")) == NULL) {
+			return OUTPUT_FAILURE;
+		}
+		TRACE_BEGIN(PHASE_OUTPUT);
+		arcs = write_dimacs_shard(fout, ctx, seed, problem, parms, options->shard, options->shards);
+		TRACE_END(PHASE_OUTPUT);
+		if(fclose(fout) != 0 && arcs >= 0) {
+			arcs = OUTPUT_FAILURE;
+		}
+		return arcs;
+	}
+
+	if(options->format == OUTPUT_STREAM || options->format == OUTPUT_SPILL || options->format == OUTPUT_PIPELINE) {
+		if((fout = fopen(filename, "w")) == NULL) {
+			return OUTPUT_FAILURE;
+		}
+		TRACE_BEGIN(PHASE_OUTPUT);
+		if(options->format == OUTPUT_SPILL) {
+			arcs = spill_dimacs(fout, ctx, seed, problem, parms, options->directory);
+		} else if(options->format == OUTPUT_PIPELINE) {
+			arcs = pipe_dimacs(fout, ctx, seed, problem, parms, options->threads, options->uring);
+		} else {
+			arcs = stream_dimacs(fout, ctx, seed, problem, parms);
+		}
+		TRACE_END(PHASE_OUTPUT);
+		if(fclose(fout) != 0 && arcs >= 0) {
+			arcs = OUTPUT_FAILURE;
+		}
+		return arcs;
+	}
+
+	if((arcs = netgen(ctx, seed, parms)) < 0) {
+		return arcs;
+	}
+
+	TRACE_BEGIN(PHASE_OUTPUT);
+	switch(options->format) {
+		case OUTPUT_MAPPED:
+			rc = write_dimacs_mapped(filename, ctx, seed, problem, options->threads);
+			break;
+		case OUTPUT_BINARY:
+			rc = write_binary(filename, ctx, seed, problem);
+			break;
+		case OUTPUT_PACKED:
+			rc = write_packed(filename, ctx, seed, problem);
+			break;
+		case OUTPUT_GZIP:
+			if(strlen(filename) + 4 > sizeof(name)) {
+				rc = EOF;
+				break;
+			}
+			sprintf(name, "%s.gz", filename);
+			if((fout = fopen(name, "wb")) == NULL) {
+				rc = EOF;
+				break;
+			}
+			rc = write_dimacs_gzip(fout, ctx, seed, problem, options->threads);
+			if(fclose(fout) != 0) {
+				rc = EOF;
+			}
+			break;
+		default:
+			if((fout = fopen(filename, "w")) == NULL) {
+				rc = EOF;
+				break;
+			}
+			rc = write_dimacs(fout, ctx, seed, problem);
+			if(fclose(fout) != 0) {
+				rc = EOF;
+			}
+			break;
+	}
+	TRACE_END(PHASE_OUTPUT);
+
+	return rc == 0 ? arcs : OUTPUT_FAILURE;
+}
+
+
+/*** Print where the large arrays of a context lie: for each, the part
+ *** the problem used and its capacity, which a reused context may keep
+ *** from a larger problem, the pages it got, the part the kernel backs
+ *** with huge pages and the NUMA nodes of a sample of its pages.  The
+ *** report is written at once, so that reports of problems generated in
+ *** parallel do not mix.
+ ***/
+static void report_placement(FILE* fout, NETGEN_CONTEXT* ctx, long problem)
+{
+	char report[REPORT_SPACE];
+	char* p = report;
+	size_t arcs = (size_t)(ctx->arc_count < ctx->arc_space ? ctx->arc_count : ctx->arc_space);
+	size_t nodes = (size_t)ctx->parms[0];
+
+	p += sprintf(p, "Problem %ld placement, %s pages asked for, %d NUMA node%s:\n", problem,
+	             pages_name(ctx->pages), numa_nodes(), numa_nodes() > 1 ? "s" : "");
+	if(ctx->narrow) {
+		p = describe_array(p, "FROM (32-bit)", ctx->from32, arcs * sizeof(COMPACT_NODE));
+		p = describe_array(p, "TO (32-bit)", ctx->to32, arcs * sizeof(COMPACT_NODE));
+		p = describe_array(p, "U (32-bit)", ctx->u32, arcs * sizeof(COMPACT_VALUE));
+		p = describe_array(p, "C (32-bit)", ctx->c32, arcs * sizeof(COMPACT_VALUE));
+	} else {
+		p = describe_array(p, "FROM", ctx->from, arcs * sizeof(NODE));
+		p = describe_array(p, "TO", ctx->to, arcs * sizeof(NODE));
+		p = describe_array(p, "U", ctx->u, arcs * sizeof(CAPACITY));
+		p = describe_array(p, "C", ctx->c, arcs * sizeof(COST));
+	}
+	p = describe_array(p, "B", ctx->b, nodes * sizeof(CAPACITY));
+	p = describe_array(p, "skeleton list", index_list_pool(ctx->skeleton), 0);
+	p = describe_array(p, "candidate list", index_list_pool(ctx->candidates), 0);
+
+	fwrite(report, 1, (size_t)(p - report), fout);
+}
+
+
+/*** Append a line describing an array from alloc_pages to a report,
+ *** with the bytes the problem used of it, or zero if not known.
+ ***/
+static char* describe_array(char* p, const char* name, const void* data, size_t used)
+{
+	PLACEMENT placement;
+	int i;
+
+	describe_pages(data, &placement);
+	if(used > 0) {
+		p += sprintf(p, "  %-15s %9.1f MB used of", name, used / MEGABYTE);
+	} else {
+		p += sprintf(p, "  %-15s %20s", name, "");
+	}
+	p += sprintf(p, " %9.1f MB capacity  %-11s  %9.1f MB in huge pages", placement.bytes / MEGABYTE,
+	             pages_name(placement.backing), placement.huge_bytes / MEGABYTE);
+	if(placement.samples > 0) {
+		p += sprintf(p, ",  pages on node");
+		for(i = 0; i < PAGES_NODES; i++) {
+			if(placement.on_node[i] > 0) {
+				p += sprintf(p, " %d: %lu%%", i, 100 * placement.on_node[i] / placement.samples);
+			}
+		}
+		if(placement.absent > 0) {
+			p += sprintf(p, " untouched: %lu%%", 100 * placement.absent / placement.samples);
+		}
+	}
+	*p++ = '\n';
+	return p;
+}
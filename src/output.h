@@ -0,0 +1,34 @@
+#ifndef OUTPUT_H
+#define OUTPUT_H 1
+
+#include "netgen.h"
+
+/*** Constants Definition ***/
+#define OUTPUT_DIMACS	1		/* DIMACS text through a stdio stream                     */
+#define OUTPUT_MAPPED	2		/* DIMACS text formatted in parallel into a mapped file   */
+#define OUTPUT_STREAM	3		/* DIMACS text printed while generating, arcs not kept    */
+#define OUTPUT_BINARY	4		/* arrays of the network in the format of binary.h        */
+#define OUTPUT_PACKED	5		/* arcs compressed by column, in the format of packed.h   */
+#define OUTPUT_GZIP		6		/* DIMACS text deflated in parallel, to FILE.gz           */
+#define OUTPUT_SPILL	7		/* DIMACS text, the arcs kept on disk until printed       */
+#define OUTPUT_PIPELINE	8		/* DIMACS text written by threads while generating        */
+
+/*** Type Definition ***/
+typedef struct output_options {
+	int format;					/* one of the OUTPUT_ constants                           */
+	int threads;				/* threads used for output, all processors if not positive */
+	int engine;					/* index list engine used to generate, default if zero    */
+	int fast;					/* nonzero to generate in the fast mode of netgen_fast    */
+	int fast_threads;			/* its threads, all processors if not positive            */
+	int shard;					/* shard written, numbered from zero, when shards > 1     */
+	int shards;					/* number of shards the problem is split into             */
+	int compact;				/* nonzero to store the arcs in 32 bits when they fit     */
+	const char* directory;		/* where OUTPUT_SPILL keeps the arcs                      */
+	int pages;					/* PAGES_ mode of large arrays, reported on stderr if set */
+	int uring;					/* nonzero for OUTPUT_PIPELINE to write through io_uring  */
+} OUTPUT_OPTIONS;
+
+/*** Methods Declaration ***/
+long generate_problem(const char*, NETGEN_CONTEXT*, long, long, long*, const OUTPUT_OPTIONS*);	/* generate and write a problem */
+
+#endif /* OUTPUT_H */
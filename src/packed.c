@@ -0,0 +1,646 @@
+/*** packed.c - save a generated network compactly, in blocks decoded apart */
+
+/*** The arcs of a NETGEN network come grouped by tail, most capacities
+ *** are one value (SUPPLY, for the arcs left uncapacitated) and costs lie
+ *** in [MINCOST, MAXCOST], so a packed file stores them by column, in
+ *** blocks of PACKED_BLOCK_ARCS arcs:
+ ***
+ ***	tails		runs of equal tails, each a zigzag varint of the
+ ***				difference from the tail of the previous run and a
+ ***				varint of its length
+ ***	heads		head-1, bit-packed head_bits wide
+ ***	defaults	one bit per arc, set if its capacity is the default
+ ***	costs		cost-cost_base, bit-packed cost_bits wide
+ ***	capacities	capacity-capacity_base of the other arcs, bit-packed
+ ***				capacity_bits wide
+ ***
+ *** Bit-packed columns are arrays of 64-bit words, value i starting at bit
+ *** i*width, and every column starts on a word, so a block decodes with
+ *** the same shift and mask for every value of a column and no branch
+ *** but the word boundary.  Each block starts its runs afresh and is
+ *** found through an index at the end of the file, so blocks can be
+ *** decoded in any order and by several threads.  The supplies, mostly
+ *** zero, come first as zigzag varints.  Widths and bases are taken from
+ *** the arrays, not the parameters, so converted files pack as well.
+ ***/
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "packed.h"
+
+/*** Local macros */
+
+#define WORDS(bits)		(((bits) + 63) / 64)
+#define PAD(n)			(((n) + 7) & ~(uint64_t)7)
+#define ZIGZAG(v)		(((uint64_t)(v) << 1) ^ (uint64_t)((v) < 0 ? -1 : 0))
+#define UNZIGZAG(v)		((int64_t)((v) >> 1) ^ -(int64_t)((v) & 1))
+
+typedef char packed_header_is_256_bytes[sizeof(PACKED_HEADER) == 256 ? 1 : -1];
+
+/*** Internally useful types */
+
+typedef struct packer {
+	FILE* fout;
+	uint64_t place;					/* bytes written so far                 */
+	int failed;
+} PACKER;
+
+typedef struct arc_source {			/* the arcs to pack, a block at a time  */
+	NETGEN_CONTEXT* ctx;			/* whose compact arcs are widened, or   */
+	const NODE* from;				/* NULL for these arrays                */
+	const NODE* to;
+	const CAPACITY* u;
+	const COST* c;
+	NODE* wide_from;				/* a widened block                      */
+	NODE* wide_to;
+	CAPACITY* wide_u;
+	COST* wide_c;
+	const NODE* block_from;			/* the current block                    */
+	const NODE* block_to;
+	const CAPACITY* block_u;
+	const COST* block_c;
+} ARC_SOURCE;
+
+
+/*** Private functions */
+
+static unsigned int width(uint64_t);
+static unsigned char* put_varint(unsigned char*, uint64_t);
+static const unsigned char* get_varint(const unsigned char*, const unsigned char*, uint64_t*);
+static void pack_bits(uint64_t*, unsigned long, unsigned int, uint64_t);
+static void put_bytes(PACKER*, const void*, size_t);
+static int pack_network(const char*, const BINARY_HEADER*, ARC_SOURCE*, const CAPACITY*);
+static int open_source(ARC_SOURCE*, NETGEN_CONTEXT*, const NODE*, const NODE*, const CAPACITY*, const COST*);
+static void read_source(ARC_SOURCE*, ARC, ARC);
+static void close_source(ARC_SOURCE*);
+static size_t pack_block(const PACKED_HEADER*, unsigned char*, const NODE*, const NODE*, const CAPACITY*, const COST*, ARC);
+
+
+/*** Save the network a context holds, generated without a sink, packed
+ *** to the named file.  Returns zero, or EOF if the file cannot be
+ *** written.
+ ***/
+int write_packed(const char* filename, NETGEN_CONTEXT* ctx, long seed, long problem)
+{
+	BINARY_HEADER header;
+	ARC_SOURCE source;
+	int rc;
+
+	if(ctx->parms == NULL || ctx->arc_base != 0) {
+		return EOF;
+	}
+
+	describe_network(&header, ctx, seed, problem);
+	if(open_source(&source, ctx, FROM, TO, U, C) != 0) {
+		return EOF;
+	}
+	rc = pack_network(filename, &header, &source, B);
+	close_source(&source);
+	return rc;
+}
+
+
+/*** Pack arrays of description->arcs arcs and description->nodes nodes
+ *** to the named file, with the kind, flags, seed, problem and parameters
+ *** of the description.  Returns zero, or EOF if the file cannot be
+ *** written.
+ ***/
+int save_packed(const char* filename, const BINARY_HEADER* description, const NODE* from, const NODE* to,
+                const CAPACITY* u, const COST* c, const CAPACITY* b)
+{
+	ARC_SOURCE source;
+
+	open_source(&source, NULL, from, to, u, c);
+	return pack_network(filename, description, &source, b);
+}
+
+
+/*** Map the named packed file and check its header and block index.  On
+ *** success *packed describes the file, to be released by close_packed,
+ *** and zero is returned; otherwise *packed is NULL and the result is
+ *** one of the BINARY_ error codes.
+ ***/
+int open_packed(const char* filename, PACKED_FILE** packed)
+{
+	PACKED_FILE* pp;
+	const PACKED_HEADER* header;
+	const uint64_t* index;
+	struct stat st;
+	void* map;
+	size_t length;
+	unsigned long k;
+	int fd, rc = 0;
+
+	*packed = NULL;
+	if((fd = open(filename, O_RDONLY)) < 0) {
+		return BINARY_UNREADABLE;
+	}
+	if(fstat(fd, &st) != 0) {
+		close(fd);
+		return BINARY_UNREADABLE;
+	}
+	if((size_t)st.st_size < sizeof(PACKED_HEADER)) {
+		close(fd);
+		return BINARY_NOT_NETGEN;
+	}
+	length = (size_t)st.st_size;
+	map = mmap(NULL, length, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if(map == MAP_FAILED) {
+		return BINARY_UNREADABLE;
+	}
+
+	header = (const PACKED_HEADER*)map;
+	index = (const uint64_t*)((const unsigned char*)map + header->index_offset);
+	if(memcmp(header->magic, PACKED_MAGIC, sizeof(PACKED_MAGIC)) != 0) {
+		rc = BINARY_NOT_NETGEN;
+	} else if(header->version != PACKED_VERSION) {
+		rc = BINARY_BAD_VERSION;
+	} else if(header->byte_order != BINARY_BYTE_ORDER || header->header_size != sizeof(PACKED_HEADER)) {
+		rc = BINARY_INCOMPATIBLE;
+	} else if(header->block_arcs == 0 || header->head_bits > 64 || header->cost_bits > 64 || header->capacity_bits > 64 ||
+	          header->blocks != (header->arcs + header->block_arcs - 1) / header->block_arcs ||
+	          header->file_size != length || header->supply_offset > length || header->index_offset % 8 != 0 ||
+	          header->index_offset > length || (length - header->index_offset) / 8 < header->blocks + 1) {
+		rc = BINARY_TRUNCATED;
+	} else {
+		for(k = 0; k <= header->blocks; k++) {
+			if(index[k] % 8 != 0 || index[k] < sizeof(PACKED_HEADER) || index[k] > header->index_offset ||
+			   (k > 0 && index[k] < index[k - 1] + 8)) {
+				rc = BINARY_TRUNCATED;
+				break;
+			}
+		}
+	}
+	if(rc == 0 && (pp = (PACKED_FILE*) calloc(1, sizeof(PACKED_FILE))) == NULL) {
+		rc = BINARY_UNREADABLE;
+	}
+	if(rc != 0) {
+		munmap(map, length);
+		return rc;
+	}
+
+	pp->header = header;
+	pp->nodes = (NODE)header->nodes;
+	pp->arcs = (ARC)header->arcs;
+	pp->blocks = (unsigned long)header->blocks;
+	pp->index = index;
+	pp->base = (const unsigned char*)map;
+	pp->length = length;
+
+	*packed = pp;
+	return 0;
+}
+
+
+/*** Decode block k of a packed file into arrays of at least block_arcs
+ *** arcs, nodes numbered from 1.  Any of the arrays may be NULL to skip
+ *** its column.  Returns the number of arcs of the block, or
+ *** BINARY_TRUNCATED if the block is damaged.
+ ***/
+long unpack_block(const PACKED_FILE* pp, unsigned long k, NODE* from, NODE* to, CAPACITY* u, COST* c)
+{
+	const PACKED_HEADER* header = pp->header;
+	const unsigned char *p, *end, *runs_end;
+	const uint64_t *heads, *defaults, *costs, *capacities;
+	uint32_t run_bytes, exceptions;
+	uint64_t delta, run, tail = 0, mask, v;
+	unsigned long count, words, bit, e;
+	unsigned int w;
+	ARC a, r;
+
+	if(k >= pp->blocks) {
+		return BINARY_TRUNCATED;
+	}
+	p = pp->base + pp->index[k];
+	end = pp->base + pp->index[k + 1];
+	count = (unsigned long)(k + 1 < pp->blocks ? header->block_arcs : header->arcs - (uint64_t)k * header->block_arcs);
+	memcpy(&run_bytes, p, sizeof(run_bytes));
+	memcpy(&exceptions, p + 4, sizeof(exceptions));
+	if(exceptions > count) {
+		return BINARY_TRUNCATED;
+	}
+	words = WORDS(count * header->head_bits) + WORDS(count) + WORDS(count * header->cost_bits) +
+		WORDS((unsigned long)exceptions * header->capacity_bits);
+	if((uint64_t)(end - p) != 8 + PAD((uint64_t)run_bytes) + 8 * (uint64_t)words) {
+		return BINARY_TRUNCATED;
+	}
+	p += 8;
+	runs_end = p + run_bytes;
+	heads = (const uint64_t*)(p + PAD((uint64_t)run_bytes));
+	defaults = heads + WORDS(count * header->head_bits);
+	costs = defaults + WORDS(count);
+	capacities = costs + WORDS(count * header->cost_bits);
+
+	/* Tails */
+	if(from != NULL) {
+		for(a = 0; a < count; a += run) {
+			if((p = get_varint(p, runs_end, &delta)) == NULL || (p = get_varint(p, runs_end, &run)) == NULL ||
+			   run == 0 || run > count - a) {
+				return BINARY_TRUNCATED;
+			}
+			tail += (uint64_t)UNZIGZAG(delta);
+			for(r = a; r < a + run; r++) {
+				from[r] = (NODE)tail;
+			}
+		}
+	}
+
+	/* Heads and costs: one shift and mask per value. */
+	if(to != NULL) {
+		w = header->head_bits;
+		mask = w == 64 ? ~(uint64_t)0 : ((uint64_t)1 << w) - 1;
+		for(a = 0, bit = 0; a < count; a++, bit += w) {
+			v = w == 0 ? 0 : heads[bit >> 6] >> (bit & 63);
+			if((bit & 63) + w > 64) {
+				v |= heads[(bit >> 6) + 1] << (64 - (bit & 63));
+			}
+			to[a] = (NODE)(v & mask) + 1;
+		}
+	}
+	if(c != NULL) {
+		w = header->cost_bits;
+		mask = w == 64 ? ~(uint64_t)0 : ((uint64_t)1 << w) - 1;
+		for(a = 0, bit = 0; a < count; a++, bit += w) {
+			v = w == 0 ? 0 : costs[bit >> 6] >> (bit & 63);
+			if((bit & 63) + w > 64) {
+				v |= costs[(bit >> 6) + 1] << (64 - (bit & 63));
+			}
+			c[a] = (COST)((uint64_t)header->cost_base + (v & mask));
+		}
+	}
+
+	/* Capacities: the default unless the arc's bit is clear. */
+	if(u != NULL) {
+		w = header->capacity_bits;
+		mask = w == 64 ? ~(uint64_t)0 : ((uint64_t)1 << w) - 1;
+		for(a = 0, e = 0, bit = 0; a < count; a++) {
+			if(defaults[a >> 6] >> (a & 63) & 1) {
+				u[a] = (CAPACITY)header->default_capacity;
+				continue;
+			}
+			if(e++ == exceptions) {
+				return BINARY_TRUNCATED;
+			}
+			v = w == 0 ? 0 : capacities[bit >> 6] >> (bit & 63);
+			if((bit & 63) + w > 64) {
+				v |= capacities[(bit >> 6) + 1] << (64 - (bit & 63));
+			}
+			bit += w;
+			u[a] = (CAPACITY)((uint64_t)header->capacity_base + (v & mask));
+		}
+	}
+
+	return (long)count;
+}
+
+
+/*** Decode the supplies of a packed file into an array of its nodes.
+ *** Returns zero, or BINARY_TRUNCATED if they are damaged.
+ ***/
+int unpack_supplies(const PACKED_FILE* pp, CAPACITY* b)
+{
+	const unsigned char* p = pp->base + pp->header->supply_offset;
+	const unsigned char* end = pp->base + pp->header->index_offset;
+	uint64_t v;
+	NODE i;
+
+	for(i = 0; i < pp->nodes; i++) {
+		if((p = get_varint(p, end, &v)) == NULL) {
+			return BINARY_TRUNCATED;
+		}
+		b[i] = (CAPACITY)UNZIGZAG(v);
+	}
+	return 0;
+}
+
+
+/*** Unmap a file opened by open_packed.
+ ***/
+void close_packed(PACKED_FILE* pp)
+{
+	if(pp == NULL) {
+		return;
+	}
+	munmap((void *)pp->base, pp->length);
+	free((void *)pp);
+}
+
+
+/*** Pack a network to the named file, as save_packed does, taking its
+ *** arcs from a source.
+ ***/
+static int pack_network(const char* filename, const BINARY_HEADER* description, ARC_SOURCE* source, const CAPACITY* b)
+{
+	PACKED_HEADER header;
+	PACKER out;
+	unsigned char* buffer;
+	uint64_t* index;
+	int64_t low, high, capacity_high;
+	CAPACITY candidate;
+	unsigned long votes, k;
+	ARC a, count, j;
+	NODE i;
+	size_t length, space;
+	unsigned char* p;
+	const CAPACITY* u;
+	const COST* c;
+
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, PACKED_MAGIC, sizeof(PACKED_MAGIC));
+	header.version = PACKED_VERSION;
+	header.header_size = sizeof(PACKED_HEADER);
+	header.byte_order = BINARY_BYTE_ORDER;
+	header.kind = description->kind;
+	header.flags = description->flags;
+	header.block_arcs = PACKED_BLOCK_ARCS;
+	header.seed = description->seed;
+	header.problem = description->problem;
+	memcpy(header.parms, description->parms, sizeof(header.parms));
+	header.nodes = description->nodes;
+	header.arcs = description->arcs;
+	header.blocks = (header.arcs + PACKED_BLOCK_ARCS - 1) / PACKED_BLOCK_ARCS;
+
+	/* The default capacity is the majority one, if any; then the ranges. */
+	candidate = 0;
+	votes = 0;
+	for(a = 0; a < header.arcs; a += count) {
+		count = header.arcs - a < PACKED_BLOCK_ARCS ? header.arcs - a : PACKED_BLOCK_ARCS;
+		read_source(source, a, count);
+		for(u = source->block_u, j = 0; j < count; j++) {
+			if(votes == 0) {
+				candidate = u[j];
+				votes = 1;
+			} else if(u[j] == candidate) {
+				votes++;
+			} else {
+				votes--;
+			}
+		}
+	}
+	header.default_capacity = candidate;
+	low = high = 0;
+	header.capacity_base = capacity_high = 0;
+	votes = 0;
+	for(a = 0; a < header.arcs; a += count) {
+		count = header.arcs - a < PACKED_BLOCK_ARCS ? header.arcs - a : PACKED_BLOCK_ARCS;
+		read_source(source, a, count);
+		u = source->block_u;
+		c = source->block_c;
+		if(a == 0) {
+			low = high = c[0];
+		}
+		for(j = 0; j < count; j++) {
+			low = c[j] < low ? c[j] : low;
+			high = c[j] > high ? c[j] : high;
+			if(u[j] == candidate) {
+				continue;
+			}
+			if(votes++ == 0 || u[j] < header.capacity_base) {
+				header.capacity_base = u[j];
+			}
+			if(votes == 1 || u[j] > capacity_high) {
+				capacity_high = u[j];
+			}
+		}
+	}
+	header.cost_base = low;
+	header.head_bits = width(header.nodes > 0 ? header.nodes - 1 : 0);
+	header.cost_bits = width((uint64_t)high - (uint64_t)low);
+	header.capacity_bits = width((uint64_t)capacity_high - (uint64_t)header.capacity_base);
+
+	space = 8 + PAD(20 * (size_t)PACKED_BLOCK_ARCS) +
+		8 * (WORDS((size_t)PACKED_BLOCK_ARCS * header.head_bits) + WORDS((size_t)PACKED_BLOCK_ARCS) +
+		     WORDS((size_t)PACKED_BLOCK_ARCS * header.cost_bits) + WORDS((size_t)PACKED_BLOCK_ARCS * header.capacity_bits));
+	buffer = (unsigned char*) malloc(space);
+	index = (uint64_t*) malloc((header.blocks + 1) * sizeof(uint64_t));
+	if(buffer == NULL || index == NULL || (out.fout = fopen(filename, "wb")) == NULL) {
+		free((void *)buffer);
+		free((void *)index);
+		return EOF;
+	}
+	out.place = 0;
+	out.failed = 0;
+
+	/* The header is written again once the places are known. */
+	put_bytes(&out, &header, sizeof(header));
+	header.supply_offset = out.place;
+	for(i = 0; i < header.nodes; ) {
+		for(p = buffer; p < buffer + space - 10 && i < header.nodes; i++) {
+			p = put_varint(p, ZIGZAG(b[i]));
+		}
+		put_bytes(&out, buffer, (size_t)(p - buffer));
+	}
+	memset(buffer, 0, 8);
+	put_bytes(&out, buffer, (size_t)(PAD(out.place) - out.place));
+
+	for(k = 0; k < header.blocks; k++) {
+		a = (ARC)k * PACKED_BLOCK_ARCS;
+		count = header.arcs - a < PACKED_BLOCK_ARCS ? header.arcs - a : PACKED_BLOCK_ARCS;
+		index[k] = out.place;
+		read_source(source, a, count);
+		length = pack_block(&header, buffer, source->block_from, source->block_to, source->block_u, source->block_c, count);
+		put_bytes(&out, buffer, length);
+	}
+	index[header.blocks] = out.place;
+	header.index_offset = out.place;
+	put_bytes(&out, index, (header.blocks + 1) * sizeof(uint64_t));
+	header.file_size = out.place;
+
+	if(fseek(out.fout, 0L, SEEK_SET) != 0) {
+		out.failed = 1;
+	}
+	put_bytes(&out, &header, sizeof(header));
+	if(fclose(out.fout) != 0) {
+		out.failed = 1;
+	}
+	free((void *)buffer);
+	free((void *)index);
+	return out.failed ? EOF : 0;
+}
+
+
+/*** Set up a source of arcs: the given arrays, or those of a context if
+ *** ctx is not NULL, with room to widen a block if it stores them
+ *** compact.  Returns zero, or EOF if the room cannot be allocated.
+ ***/
+static int open_source(ARC_SOURCE* source, NETGEN_CONTEXT* ctx, const NODE* from, const NODE* to,
+                       const CAPACITY* u, const COST* c)
+{
+	memset(source, 0, sizeof(ARC_SOURCE));
+	source->from = from;
+	source->to = to;
+	source->u = u;
+	source->c = c;
+	if(ctx == NULL || !ctx->narrow) {
+		return 0;
+	}
+	source->ctx = ctx;
+	source->wide_from = (NODE*) malloc(PACKED_BLOCK_ARCS * sizeof(NODE));
+	source->wide_to = (NODE*) malloc(PACKED_BLOCK_ARCS * sizeof(NODE));
+	source->wide_u = (CAPACITY*) malloc(PACKED_BLOCK_ARCS * sizeof(CAPACITY));
+	source->wide_c = (COST*) malloc(PACKED_BLOCK_ARCS * sizeof(COST));
+	if(!source->wide_from || !source->wide_to || !source->wide_u || !source->wide_c) {
+		close_source(source);
+		return EOF;
+	}
+	return 0;
+}
+
+
+/*** Point the current block of a source at count arcs from the first. ***/
+static void read_source(ARC_SOURCE* source, ARC first, ARC count)
+{
+	if(source->ctx == NULL) {
+		source->block_from = source->from + first;
+		source->block_to = source->to + first;
+		source->block_u = source->u + first;
+		source->block_c = source->c + first;
+		return;
+	}
+	copy_arcs(source->ctx, first, count, source->wide_from, source->wide_to, source->wide_u, source->wide_c);
+	source->block_from = source->wide_from;
+	source->block_to = source->wide_to;
+	source->block_u = source->wide_u;
+	source->block_c = source->wide_c;
+}
+
+
+/*** Release the room of a source. ***/
+static void close_source(ARC_SOURCE* source)
+{
+	free((void *)source->wide_from);
+	free((void *)source->wide_to);
+	free((void *)source->wide_u);
+	free((void *)source->wide_c);
+	source->wide_from = source->wide_to = NULL;
+	source->wide_u = NULL;
+	source->wide_c = NULL;
+}
+
+
+/*** Bits needed to write a value: zero for zero. */
+
+static unsigned int width(uint64_t v)
+{
+	unsigned int bits = 0;
+
+	while(v != 0) {
+		bits++;
+		v >>= 1;
+	}
+	return bits;
+}
+
+
+/*** Write a varint, seven bits a byte, low bits first. */
+
+static unsigned char* put_varint(unsigned char* p, uint64_t v)
+{
+	while(v >= 0x80) {
+		*p++ = (unsigned char)(v | 0x80);
+		v >>= 7;
+	}
+	*p++ = (unsigned char)v;
+	return p;
+}
+
+
+/*** Read a varint ending before end.  Returns the next position, or
+ *** NULL if the varint runs past end.
+ ***/
+static const unsigned char* get_varint(const unsigned char* p, const unsigned char* end, uint64_t* v)
+{
+	unsigned int shift = 0;
+
+	*v = 0;
+	while(p < end && shift < 64) {
+		*v |= (uint64_t)(*p & 0x7F) << shift;
+		if((*p++ & 0x80) == 0) {
+			return p;
+		}
+		shift += 7;
+	}
+	return NULL;
+}
+
+
+/*** Set value i of a zeroed column of width-bit values. */
+
+static void pack_bits(uint64_t* words, unsigned long i, unsigned int width, uint64_t v)
+{
+	unsigned long bit = i * width;
+
+	if(width == 0) {
+		return;
+	}
+	words[bit >> 6] |= v << (bit & 63);
+	if((bit & 63) + width > 64) {
+		words[(bit >> 6) + 1] |= v >> (64 - (bit & 63));
+	}
+}
+
+
+/*** Append bytes to the file, noting a failed write. */
+
+static void put_bytes(PACKER* out, const void* data, size_t length)
+{
+	if(length > 0 && fwrite(data, 1, length, out->fout) != length) {
+		out->failed = 1;
+	}
+	out->place += length;
+}
+
+
+/*** Encode count arcs into a block.  Returns its length, a multiple of 8.
+ ***/
+static size_t pack_block(const PACKED_HEADER* header, unsigned char* block, const NODE* from, const NODE* to,
+                         const CAPACITY* u, const COST* c, ARC count)
+{
+	unsigned char* p = block + 8;
+	uint64_t *heads, *defaults, *costs, *capacities;
+	uint32_t run_bytes, exceptions = 0;
+	NODE tail = 0;
+	size_t words;
+	ARC a, r;
+
+	for(a = 0; a < count; a = r) {
+		for(r = a + 1; r < count && from[r] == from[a]; r++) {
+		}
+		p = put_varint(p, ZIGZAG((int64_t)(from[a] - tail)));
+		p = put_varint(p, (uint64_t)(r - a));
+		tail = from[a];
+	}
+	run_bytes = (uint32_t)(p - (block + 8));
+	memset(p, 0, (size_t)(PAD((uint64_t)run_bytes) - run_bytes));
+
+	for(a = 0; a < count; a++) {
+		exceptions += u[a] != header->default_capacity;
+	}
+	words = WORDS(count * header->head_bits) + WORDS(count) + WORDS(count * header->cost_bits) +
+		WORDS((size_t)exceptions * header->capacity_bits);
+	heads = (uint64_t*)(block + 8 + PAD((uint64_t)run_bytes));
+	memset(heads, 0, words * 8);
+	defaults = heads + WORDS(count * header->head_bits);
+	costs = defaults + WORDS(count);
+	capacities = costs + WORDS(count * header->cost_bits);
+
+	for(a = 0, r = 0; a < count; a++) {
+		pack_bits(heads, a, header->head_bits, (uint64_t)(to[a] - 1));
+		pack_bits(costs, a, header->cost_bits, (uint64_t)c[a] - (uint64_t)header->cost_base);
+		if(u[a] == header->default_capacity) {
+			defaults[a >> 6] |= (uint64_t)1 << (a & 63);
+		} else {
+			pack_bits(capacities, r++, header->capacity_bits, (uint64_t)u[a] - (uint64_t)header->capacity_base);
+		}
+	}
+
+	memcpy(block, &run_bytes, sizeof(run_bytes));
+	memcpy(block + 4, &exceptions, sizeof(exceptions));
+	return 8 + PAD((uint64_t)run_bytes) + words * 8;
+}
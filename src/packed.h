@@ -0,0 +1,61 @@
+#ifndef PACKED_H
+#define PACKED_H 1
+
+#include <stdint.h>
+
+#include "netgen.h"
+#include "binary.h"
+
+/*** Constants Definition ***/
+#define PACKED_MAGIC		"NETGENZ"	/* first bytes of a file, with the final NUL       */
+#define PACKED_VERSION		1			/* raised whenever the layout changes              */
+#define PACKED_BLOCK_ARCS	4096		/* arcs per block, each block decoded on its own   */
+
+/*** Type Definition ***/
+typedef struct packed_header {			/* 256 bytes at the start of the file              */
+	char magic[8];						/* PACKED_MAGIC                                    */
+	uint32_t version;					/* PACKED_VERSION                                  */
+	uint32_t header_size;				/* sizeof(PACKED_HEADER)                           */
+	uint32_t byte_order;				/* BINARY_BYTE_ORDER in the writer's byte order    */
+	uint32_t kind;						/* ASSIGNMENT, MAXIMUM_FLOW or MINIMUM_COST        */
+	uint32_t flags;						/* BINARY_ flags                                   */
+	uint32_t block_arcs;				/* arcs per block, all blocks but the last full    */
+	uint32_t head_bits;					/* width of a packed head, less one                */
+	uint32_t cost_bits;					/* width of a packed cost, less cost_base          */
+	uint32_t capacity_bits;				/* width of a packed capacity, less capacity_base  */
+	uint32_t unused;
+	int64_t seed;						/* random seed                                     */
+	int64_t problem;					/* problem number                                  */
+	int64_t parms[PROBLEM_PARMS];		/* generation parameters                           */
+	uint64_t nodes;
+	uint64_t arcs;
+	uint64_t blocks;
+	int64_t cost_base;					/* smallest cost                                   */
+	int64_t capacity_base;				/* smallest capacity other than the default        */
+	int64_t default_capacity;			/* capacity marked by a bit instead of stored      */
+	uint64_t supply_offset;				/* supplies, as zigzag varints                     */
+	uint64_t index_offset;				/* blocks+1 offsets: block k lies between entries  */
+										/* k and k+1                                       */
+	uint64_t file_size;
+	uint64_t reserved[2];				/* zero                                            */
+} PACKED_HEADER;
+
+typedef struct packed_file {			/* a file mapped by open_packed                    */
+	const PACKED_HEADER* header;
+	NODE nodes;
+	ARC arcs;
+	unsigned long blocks;
+	const uint64_t* index;
+	const unsigned char* base;
+	size_t length;
+} PACKED_FILE;
+
+/*** Methods Declaration ***/
+int write_packed(const char*, NETGEN_CONTEXT*, long, long);	/* save a generated problem packed */
+int save_packed(const char*, const BINARY_HEADER*, const NODE*, const NODE*, const CAPACITY*, const COST*, const CAPACITY*);	/* pack arrays described by a binary header */
+int open_packed(const char*, PACKED_FILE**);	/* map a packed file and check its header  */
+long unpack_block(const PACKED_FILE*, unsigned long, NODE*, NODE*, CAPACITY*, COST*);	/* decode the arcs of a block */
+int unpack_supplies(const PACKED_FILE*, CAPACITY*);	/* decode the supplies of the nodes */
+void close_packed(PACKED_FILE*);		/* unmap it                                     */
+
+#endif /* PACKED_H */
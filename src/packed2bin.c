@@ -0,0 +1,84 @@
+/*** packed2bin.c - unpack a file of the packed format into the binary format */
+
+/*** Decodes every block of a packed file (packed.h) and saves the arrays
+ *** in the binary format of binary.h, ready to be mapped by a solver.
+ ***/
+
+/*** System Interfaces ***/
+#include <stdio.h>
+#include <string.h>
+
+/*** NETGEN Interfaces ***/
+#include "netgen.h"
+#include "binary.h"
+#include "packed.h"
+
+/*** Local Constants ***/
+#define USAGE "Usage: ./packed2bin PACKED BINARY\n"
+
+
+int
+main(int argc, char **argv)
+{
+	PACKED_FILE* pp;
+	BINARY_HEADER header;
+	NODE* from;
+	NODE* to;
+	CAPACITY* u;
+	COST* c;
+	CAPACITY* b;
+	ARC a, room;
+	unsigned long k;
+	long count;
+	int rc;
+
+	if(argc != 3) {
+		fprintf(stderr, USAGE);
+		exit(EXIT_FAILURE);
+	}
+	if((rc = open_packed(argv[1], &pp)) != 0) {
+		fprintf(stderr, "%s.\n", binary_error(rc));
+		exit(EXIT_FAILURE);
+	}
+
+	room = pp->arcs > 0 ? pp->arcs : 1;
+	from = (NODE*) malloc(room * sizeof(NODE));
+	to = (NODE*) malloc(room * sizeof(NODE));
+	u = (CAPACITY*) malloc(room * sizeof(CAPACITY));
+	c = (COST*) malloc(room * sizeof(COST));
+	b = (CAPACITY*) malloc((pp->nodes > 0 ? pp->nodes : 1) * sizeof(CAPACITY));
+	if(!from || !to || !u || !c || !b) {
+		error_exit(ALLOCATION_FAILURE);
+	}
+
+	for(k = 0, a = 0; k < pp->blocks; k++, a += (ARC)count) {
+		if((count = unpack_block(pp, k, from + a, to + a, u + a, c + a)) < 0) {
+			fprintf(stderr, "%s.\n", binary_error((int)count));
+			exit(EXIT_FAILURE);
+		}
+	}
+	if((rc = unpack_supplies(pp, b)) != 0) {
+		fprintf(stderr, "%s.\n", binary_error(rc));
+		exit(EXIT_FAILURE);
+	}
+
+	memset(&header, 0, sizeof(header));
+	header.kind = pp->header->kind;
+	header.flags = pp->header->flags;
+	header.seed = pp->header->seed;
+	header.problem = pp->header->problem;
+	memcpy(header.parms, pp->header->parms, sizeof(header.parms));
+	header.nodes = pp->nodes;
+	header.arcs = pp->arcs;
+	if(save_binary(argv[2], &header, from, to, u, c, b) != 0) {
+		error_exit(OUTPUT_FAILURE);
+	}
+
+	close_packed(pp);
+	free(from);
+	free(to);
+	free(u);
+	free(c);
+	free(b);
+	exit(EXIT_SUCCESS);
+} /* END OF MAIN */
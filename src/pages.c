@@ -0,0 +1,438 @@
+/*** pages.c - back large arrays with huge pages and spread them over NUMA nodes */
+
+/*** The arc arrays of a large network, its supplies and the node pools of
+ *** its index lists are far larger than what the TLB covers in ordinary
+ *** pages, and choose_index descends through a pool at random positions,
+ *** so nearly every access misses the TLB.  Arrays allocated here can ask
+ *** for huge pages instead:
+ ***
+ ***	PAGES_TRANSPARENT	the array gets a mapping of its own, aligned on
+ ***				a huge page and advised with MADV_HUGEPAGE, which
+ ***				the kernel honours when transparent huge pages are
+ ***				set to "always" or "madvise" and it finds them;
+ ***	PAGES_EXPLICIT		the array is mapped with MAP_HUGETLB from the
+ ***				pool reserved in /proc/sys/vm/nr_hugepages, and
+ ***				falls back to PAGES_TRANSPARENT when the pool is
+ ***				short.
+ ***
+ *** Arrays below PAGES_THRESHOLD, and every array in PAGES_NORMAL, come
+ *** from malloc.  Each array is preceded by a small header recording how
+ *** it was obtained, so that resize_pages and free_pages treat it right
+ *** whatever mode is current when they are called.
+ ***
+ *** On a machine with several NUMA nodes, a page is placed on the node of
+ *** the thread that first touches it.  Arrays filled by several threads
+ *** (the fast mode's arcs, a graph's) are first touched by the threads
+ *** that fill them, as long as nothing touches them before.  An array
+ *** filled by one thread but read by many, as the arcs of an exact
+ *** network are by the parallel writers, is better spread: spread_pages
+ *** touches it in one slice per node, each from a thread bound to that
+ *** node's processors.  describe_pages reports what was obtained: the
+ *** mode, the bytes the kernel backs with huge pages, and the nodes of a
+ *** sample of the pages.
+ ***/
+
+#define _GNU_SOURCE
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "pages.h"
+
+/*** Local macros */
+
+#define HEADER_SIZE		64				/* keeps the array aligned on a cache line */
+#define ROUND_HUGE(n)	(((n) + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1))
+#define MIN(x, y)		((x) < (y) ? (x) : (y))
+#define NODE_DIRECTORY	"/sys/devices/system/node"
+
+/*** Internally useful types */
+
+typedef union region {					/* precedes every array                 */
+	struct {
+		size_t length;					/* bytes mapped, or zero if malloc'd    */
+		size_t bytes;					/* bytes asked for                      */
+		int requested;					/* PAGES_ mode asked for                */
+		int backing;					/* and obtained                         */
+	} r;
+	char pad[HEADER_SIZE];
+} REGION;
+
+typedef struct toucher {
+	char* start;						/* slice first touched by this thread   */
+	size_t bytes;
+	int node;							/* whose processors it runs on          */
+	pthread_t thread;
+	int started;
+} TOUCHER;
+
+
+/*** Private functions */
+
+static REGION* map_region(size_t, int);
+static int node_list(int*, int);
+static int read_list(const char*, int*, int);
+static void* touch_slice(void*);
+static size_t huge_bytes(const void*, size_t);
+
+
+/*** Allocate an array of the given size in a PAGES_ mode, falling back
+ *** from explicit to transparent huge pages and from those to malloc.
+ *** The array is not cleared.  Returns NULL if no memory is found.
+ ***/
+void* alloc_pages(size_t bytes, int mode)
+{
+	REGION* rp = NULL;
+
+	if(bytes > (size_t)-1 - 2 * HUGE_PAGE_SIZE) {
+		return NULL;
+	}
+	if(mode != PAGES_NORMAL && bytes >= PAGES_THRESHOLD) {
+		rp = map_region(bytes, mode);
+	}
+	if(rp == NULL) {
+		if((rp = (REGION*) malloc(HEADER_SIZE + bytes)) == NULL) {
+			return NULL;
+		}
+		rp->r.length = 0;
+		rp->r.backing = PAGES_NORMAL;
+	}
+	rp->r.bytes = bytes;
+	rp->r.requested = mode;
+	return (void *)(rp + 1);
+}
+
+
+/*** Change the size of an array from alloc_pages, keeping its contents
+ *** up to the smaller size, as realloc does.  A NULL array is allocated.
+ *** Returns NULL, leaving the array as it was, if no memory is found.
+ ***/
+void* resize_pages(void* data, size_t bytes, int mode)
+{
+	REGION* rp;
+	REGION* np;
+	void* copy;
+
+	if(data == NULL) {
+		return alloc_pages(bytes, mode);
+	}
+	rp = (REGION*)data - 1;
+
+	if(rp->r.length == 0 && (mode == PAGES_NORMAL || bytes < PAGES_THRESHOLD)) {
+		if(bytes > (size_t)-1 - HEADER_SIZE || (np = (REGION*) realloc((void *)rp, HEADER_SIZE + bytes)) == NULL) {
+			return NULL;
+		}
+		np->r.bytes = bytes;
+		np->r.requested = mode;
+		return (void *)(np + 1);
+	}
+	if(rp->r.length != 0 && HEADER_SIZE + bytes <= rp->r.length) {
+		rp->r.bytes = bytes;
+		return data;
+	}
+
+	if((copy = alloc_pages(bytes, mode)) == NULL) {
+		return NULL;
+	}
+	(void)memcpy(copy, data, bytes < rp->r.bytes ? bytes : rp->r.bytes);
+	free_pages(data);
+	return copy;
+}
+
+
+/*** Free an array from alloc_pages.  A NULL array is ignored. */
+
+void free_pages(void* data)
+{
+	REGION* rp;
+
+	if(data == NULL) {
+		return;
+	}
+	rp = (REGION*)data - 1;
+	if(rp->r.length == 0) {
+		free((void *)rp);
+	} else {
+		(void)munmap((void *)rp, rp->r.length);
+	}
+}
+
+
+/*** Count the NUMA nodes with memory.  Machines without NUMA, or without
+ *** the sysfs files describing it, have one.
+ ***/
+int numa_nodes(void)
+{
+	int nodes[PAGES_NODES];
+	int count = node_list(nodes, PAGES_NODES);
+
+	return count > 0 ? count : 1;
+}
+
+
+/*** First-touch a newly allocated array in one slice per NUMA node, each
+ *** from a thread bound to that node's processors, so that its pages are
+ *** spread over the nodes.  Pages already touched stay where they are.
+ *** Nothing is done on a machine with a single node.
+ ***/
+void spread_pages(void* data, size_t bytes)
+{
+	TOUCHER touchers[PAGES_NODES];
+	int nodes[PAGES_NODES];
+	size_t slice;
+	int count, i;
+
+	if(data == NULL || bytes < PAGES_THRESHOLD || (count = node_list(nodes, PAGES_NODES)) <= 1) {
+		return;
+	}
+
+	slice = (bytes / (size_t)count + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+	for(i = 0; i < count; i++) {
+		touchers[i].start = (char*)data + (size_t)i * slice;
+		touchers[i].bytes = (size_t)i * slice >= bytes ? 0 : MIN(slice, bytes - (size_t)i * slice);
+		touchers[i].node = nodes[i];
+		touchers[i].started = pthread_create(&touchers[i].thread, NULL, touch_slice, (void *)&touchers[i]) == 0;
+	}
+	for(i = 0; i < count; i++) {
+		if(touchers[i].started) {
+			pthread_join(touchers[i].thread, NULL);
+		} else {
+			touch_slice((void *)&touchers[i]);
+		}
+	}
+}
+
+
+/*** Find where an array from alloc_pages is: the mode it was obtained
+ *** in, the bytes the kernel backs with huge pages (left at zero for a
+ *** malloc'd array, whose heap mapping holds much else), and the nodes
+ *** of up to PAGES_SAMPLES of its pages, evenly spread.  Untouched pages
+ *** have no node yet and are counted as absent.  Node lookups need the
+ *** move_pages system call; without it no page is sampled.
+ ***/
+void describe_pages(const void* data, PLACEMENT* placement)
+{
+	const REGION* rp;
+	void* pages[PAGES_SAMPLES];
+	int status[PAGES_SAMPLES];
+	size_t page = (size_t)sysconf(_SC_PAGESIZE);
+	size_t first, last, step;
+	unsigned long count, k;
+
+	memset(placement, 0, sizeof(PLACEMENT));
+	if(data == NULL) {
+		return;
+	}
+	rp = (const REGION*)data - 1;
+	placement->bytes = rp->r.bytes;
+	placement->requested = rp->r.requested;
+	placement->backing = rp->r.backing;
+	if(rp->r.bytes == 0) {
+		return;
+	}
+
+	if(rp->r.backing == PAGES_EXPLICIT) {
+		placement->huge_bytes = rp->r.bytes;
+	} else if(rp->r.length != 0) {
+		placement->huge_bytes = huge_bytes(rp, rp->r.length);
+	}
+
+	first = (size_t)data & ~(page - 1);
+	last = ((size_t)data + rp->r.bytes - 1) & ~(page - 1);
+	count = (unsigned long)((last - first) / page + 1);
+	if(count > PAGES_SAMPLES) {
+		count = PAGES_SAMPLES;
+	}
+	step = count > 1 ? (last - first) / page / (count - 1) : 0;
+	for(k = 0; k < count; k++) {
+		pages[k] = (void *)(first + k * step * page);
+	}
+#ifdef SYS_move_pages
+	if(syscall(SYS_move_pages, 0, count, pages, NULL, status, 0) != 0) {
+		return;
+	}
+	placement->samples = count;
+	for(k = 0; k < count; k++) {
+		if(status[k] < 0) {
+			placement->absent++;
+		} else if(status[k] < PAGES_NODES) {
+			placement->on_node[status[k]]++;
+		}
+	}
+#else
+	(void)pages;
+	(void)status;
+#endif
+}
+
+
+/*** Return the name of a PAGES_ mode. */
+
+const char* pages_name(int mode)
+{
+	switch(mode) {
+		case PAGES_TRANSPARENT:
+			return "transparent";
+		case PAGES_EXPLICIT:
+			return "explicit";
+		default:
+			return "normal";
+	}
+}
+
+
+/*** Map a region for an array of the given size, aligned on a huge page:
+ *** from the huge page pool for PAGES_EXPLICIT, if it has room, else as
+ *** anonymous memory advised for transparent huge pages.  Returns NULL if
+ *** no mapping can be made.
+ ***/
+static REGION* map_region(size_t bytes, int mode)
+{
+	size_t length = ROUND_HUGE(HEADER_SIZE + bytes);
+	char* base;
+	char* start;
+	REGION* rp;
+
+#ifdef MAP_HUGETLB
+	if(mode == PAGES_EXPLICIT) {
+		base = (char*) mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+		if(base != (char*)MAP_FAILED) {
+			rp = (REGION*)base;
+			rp->r.length = length;
+			rp->r.backing = PAGES_EXPLICIT;
+			return rp;
+		}
+	}
+#endif
+
+	/* Map a huge page more than needed and trim it to an aligned start. */
+	base = (char*) mmap(NULL, length + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if(base == (char*)MAP_FAILED) {
+		return NULL;
+	}
+	start = (char*)ROUND_HUGE((size_t)base);
+	if(start > base) {
+		(void)munmap((void *)base, (size_t)(start - base));
+	}
+	(void)munmap((void *)(start + length), (size_t)(base + HUGE_PAGE_SIZE - start));
+
+	rp = (REGION*)start;
+	rp->r.length = length;
+	rp->r.backing = PAGES_NORMAL;
+#ifdef MADV_HUGEPAGE
+	if(madvise((void *)start, length, MADV_HUGEPAGE) == 0) {
+		rp->r.backing = PAGES_TRANSPARENT;
+	}
+#endif
+	return rp;
+}
+
+
+/*** Read the NUMA nodes with memory, up to the given number.  Returns
+ *** their count, or zero if the machine does not describe them.
+ ***/
+static int node_list(int* nodes, int most)
+{
+	return read_list(NODE_DIRECTORY "/has_memory", nodes, most);
+}
+
+
+/*** Read a list in the kernel's format ("0-3,8,10-11") from the named
+ *** file, up to the given number of values.  Returns their count, or
+ *** zero if the file cannot be read.
+ ***/
+static int read_list(const char* filename, int* values, int most)
+{
+	FILE* fin;
+	char line[1024];
+	char* p;
+	long low, high;
+	int count = 0;
+
+	if((fin = fopen(filename, "r")) == NULL) {
+		return 0;
+	}
+	p = fgets(line, sizeof(line), fin);
+	fclose(fin);
+	if(p == NULL) {
+		return 0;
+	}
+
+	while(*p >= '0' && *p <= '9') {
+		low = high = strtol(p, &p, 10);
+		if(*p == '-') {
+			high = strtol(p + 1, &p, 10);
+		}
+		for( ; low <= high && count < most; low++) {
+			values[count++] = (int)low;
+		}
+		if(*p == ',') {
+			p++;
+		}
+	}
+	return count;
+}
+
+
+/*** Thread body: bind to the processors of a node, then touch every page
+ *** of a slice.  The touch writes a zero, which a new array holds anyway.
+ ***/
+static void* touch_slice(void* arg)
+{
+	TOUCHER* toucher = (TOUCHER*)arg;
+	char filename[128];
+	int cpus[CPU_SETSIZE];
+	cpu_set_t set;
+	size_t page = (size_t)sysconf(_SC_PAGESIZE);
+	size_t offset;
+	int count, i;
+
+	snprintf(filename, sizeof(filename), NODE_DIRECTORY "/node%d/cpulist", toucher->node);
+	if((count = read_list(filename, cpus, CPU_SETSIZE)) > 0) {
+		CPU_ZERO(&set);
+		for(i = 0; i < count; i++) {
+			CPU_SET(cpus[i], &set);
+		}
+		(void)pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+	}
+
+	for(offset = 0; offset < toucher->bytes; offset += page) {
+		((volatile char*)toucher->start)[offset] = 0;
+	}
+	return NULL;
+}
+
+
+/*** Add up the huge pages the kernel reports in /proc/self/smaps for
+ *** the mappings that hold the given bytes, at most those bytes, since
+ *** the kernel may have merged a mapping with its neighbours.  Returns
+ *** zero if the file cannot be read.
+ ***/
+static size_t huge_bytes(const void* data, size_t bytes)
+{
+	FILE* fin;
+	char line[256];
+	unsigned long low, high, kilobytes;
+	size_t start = (size_t)data, end = (size_t)data + bytes;
+	size_t total = 0;
+	int inside = 0;
+
+	if((fin = fopen("/proc/self/smaps", "r")) == NULL) {
+		return 0;
+	}
+	while(fgets(line, sizeof(line), fin) != NULL) {
+		if(sscanf(line, "%lx-%lx ", &low, &high) == 2) {
+			inside = low < end && high > start;
+		} else if(inside && sscanf(line, "AnonHugePages: %lu kB", &kilobytes) == 1) {
+			total += (size_t)kilobytes * 1024;
+		}
+	}
+	fclose(fin);
+	return total < bytes ? total : bytes;
+}
@@ -0,0 +1,39 @@
+#ifndef PAGES_H
+#define PAGES_H 1
+
+#include <stddef.h>
+
+/*** Constants Definition ***/
+#define PAGES_NORMAL		0			/* malloc, as any other array                      */
+#define PAGES_TRANSPARENT	1			/* a mapping of its own, advised to the kernel for */
+										/* transparent huge pages                          */
+#define PAGES_EXPLICIT		2			/* huge pages from the reserved pool (MAP_HUGETLB),*/
+										/* else as PAGES_TRANSPARENT                       */
+
+#define HUGE_PAGE_SIZE		(2UL << 20)	/* size of a huge page, and the alignment of a     */
+										/* mapping                                         */
+#define PAGES_THRESHOLD		HUGE_PAGE_SIZE	/* arrays smaller than this come from malloc   */
+#define PAGES_SAMPLES		256			/* pages whose node describe_pages looks up        */
+#define PAGES_NODES			16			/* NUMA nodes told apart by describe_pages         */
+
+/*** Type Definition ***/
+typedef struct placement {				/* where an array's memory actually is             */
+	size_t bytes;						/* bytes asked for                                 */
+	int requested;						/* PAGES_ mode asked for                           */
+	int backing;						/* PAGES_ mode obtained                            */
+	size_t huge_bytes;					/* bytes the kernel backs with huge pages          */
+	unsigned long samples;				/* pages looked up, evenly spread                  */
+	unsigned long absent;				/* of which not touched yet                        */
+	unsigned long on_node[PAGES_NODES];	/* and how many are on each node                   */
+} PLACEMENT;
+
+/*** Methods Declaration ***/
+void* alloc_pages(size_t, int);			/* allocate an array in a PAGES_ mode, as malloc   */
+void* resize_pages(void*, size_t, int);	/* resize it, as realloc                           */
+void free_pages(void*);					/* free it, as free                                */
+int numa_nodes(void);					/* NUMA nodes of the machine, at least one         */
+void spread_pages(void*, size_t);		/* first-touch a new array from every NUMA node    */
+void describe_pages(const void*, PLACEMENT*);	/* find where an array is               */
+const char* pages_name(int);			/* name of a PAGES_ mode                           */
+
+#endif /* PAGES_H */
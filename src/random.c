@@ -7,41 +7,164 @@
 /*** Note that every variable used here must have at least 31 bits
  *** of precision, exclusive of sign.  Long integers should be enough.
  *** The generator is the congruential:  i = 7**5 * i mod (2^31-1).
+ ***
+ *** The state of a sequence is kept by the caller in a RANDOM, so that
+ *** independent sequences can be drawn concurrently.
+ ***
+ *** The product of the multiplier and a state fits in 64 bits, and as the
+ *** modulus is the Mersenne prime 2^31-1, it is reduced by adding its bits
+ *** above the 31st to those below, then subtracting the modulus once if
+ *** need be.  This gives exactly the numbers of the original 16-bit hi/lo
+ *** arithmetic, for any seed whose product does not overflow.
  ***/
 
 #include "random.h"
+#include "trace.h"
 
-static long saved_seed;
+/*** Local constants */
+
+#define LEAP_LANES      8			/* states advanced side by side by fill_randomi */
+#define LEAP_MULTIPLIER 1457850878UL	/* 7**40 mod (2^31-1): LEAP_LANES steps at once */
+
+/*** Local macros */
+
+#define FOLD(x) (((x) & MODULUS) + ((x) >> 31))	/* congruent to x mod 2^31-1 */
 
 
 /*** set_randomi - initialize constants and seed */
 
-void set_randomi(long seed)
+void set_randomi(RANDOM* state, long seed)
 {
-	saved_seed = seed;
+	state->seed = seed;
 }
 
 
 /*** randomi - generate a random integer in the interval [a,b] (b >= a >= 0) */
 
-long randomi(long a, long b)
+long randomi(RANDOM* state, long a, long b)
 {
-	register long hi, lo;
+	unsigned long long x = FOLD((unsigned long long)state->seed * MULTIPLIER);
 
-	hi = MULTIPLIER * (saved_seed >> 16);
-	lo = MULTIPLIER * (saved_seed & 0xffff);
-	hi += (lo>>16);
-	lo &= 0xffff;
-	lo += (hi>>15);
-	hi &= 0x7fff;
-	lo -= MODULUS;
-	if((saved_seed = (hi<<16) + lo) < 0) {
-		saved_seed += MODULUS;
-	}
+	TRACE_COUNT(TRACE_RANDOM_DRAWS, 1);
+	state->seed = (long)(x >= MODULUS ? x - MODULUS : x);
 
 	if(b <= a) {
 		return b;
 	}
 	
-	return a + saved_seed % (b - a + 1);
+	return a + state->seed % (b - a + 1);
+}
+
+
+/*** fill_randomi - store the next count numbers of the sequence, before
+ *** any range reduction, and advance the state past them.  Given state
+ *** s, randomi(a,b) returns RANGE_RANDOMI(s', a, b) for the next state s'.
+ ***
+ *** After the first LEAP_LANES numbers, which are found one by one, each
+ *** number is the one LEAP_LANES places before it times the multiplier
+ *** raised to that power, so the lanes have no dependence on each other
+ *** and the compiler may vectorize the loop.  The leap needs reduced
+ *** states, which all states are from the first one below the modulus.
+ ***/
+void fill_randomi(RANDOM* state, long buffer[], unsigned long count)
+{
+	unsigned long long x;
+	unsigned long i;
+	int k;
+
+	TRACE_COUNT(TRACE_RANDOM_DRAWS, count);
+	for(i = 0; i < count && (i < LEAP_LANES || buffer[i - LEAP_LANES] >= MODULUS); i++) {
+		x = FOLD((unsigned long long)state->seed * MULTIPLIER);
+		buffer[i] = state->seed = (long)(x >= MODULUS ? x - MODULUS : x);
+	}
+	if(i == count) {
+		return;
+	}
+
+	for( ; i + LEAP_LANES <= count; i += LEAP_LANES) {
+		for(k = 0; k < LEAP_LANES; k++) {
+			x = (unsigned long long)buffer[i + k - LEAP_LANES] * LEAP_MULTIPLIER;
+			x = FOLD(FOLD(x));
+			buffer[i + k] = (long)(x >= MODULUS ? x - MODULUS : x);
+		}
+	}
+	state->seed = buffer[i - 1];
+	for( ; i < count; i++) {
+		x = FOLD((unsigned long long)state->seed * MULTIPLIER);
+		buffer[i] = state->seed = (long)(x >= MODULUS ? x - MODULUS : x);
+	}
+}
+
+
+/*** skip_randomi - advance the state past count numbers of the sequence
+ *** at once, multiplying it by the multiplier raised to that power.  The
+ *** power is found by repeated squaring, in time logarithmic in count.
+ ***/
+void skip_randomi(RANDOM* state, unsigned long count)
+{
+	unsigned long long power = MULTIPLIER;
+	unsigned long long result = 1;
+	unsigned long long x;
+
+	TRACE_COUNT(TRACE_RANDOM_SKIPS, count);
+	if(count > 0 && state->seed >= MODULUS) {	/* reduce the seed first */
+		(void)randomi(state, 0L, 0L);
+		count--;
+	}
+
+	for( ; count > 0; count >>= 1) {
+		if(count & 1) {
+			x = FOLD(FOLD(result * power));
+			result = x >= MODULUS ? x - MODULUS : x;
+		}
+		x = FOLD(FOLD(power * power));
+		power = x >= MODULUS ? x - MODULUS : x;
+	}
+
+	x = FOLD(FOLD((unsigned long long)state->seed * result));
+	state->seed = (long)(x >= MODULUS ? x - MODULUS : x);
+}
+
+
+/*** Counter-based streams, used by the fast mode of the generator.
+ ***
+ *** The congruential sequence above can only be drawn in order, which ties
+ *** every random choice of a network to a single thread.  A stream instead
+ *** hashes a key, made from the seed, a node and a purpose, with the count
+ *** of numbers already drawn from it (the SplitMix64 construction), so
+ *** that any number of streams can be drawn independently and each one
+ *** gives the same numbers whichever thread draws it.
+ ***/
+
+#define GOLDEN_GAMMA 0x9e3779b97f4a7c15ULL
+
+static unsigned long long mix(unsigned long long z)
+{
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return z ^ (z >> 31);
+}
+
+
+/*** set_stream - key a stream by seed, node and purpose */
+
+void set_stream(RANDOM_STREAM* stream, long seed, unsigned long node, int purpose)
+{
+	stream->key = mix(mix((unsigned long long)seed * GOLDEN_GAMMA + (unsigned long long)purpose) ^ (unsigned long long)node);
+	stream->counter = 0;
+}
+
+
+/*** streami - draw the next integer of a stream in the interval [a,b] (b >= a >= 0) */
+
+long streami(RANDOM_STREAM* stream, long a, long b)
+{
+	unsigned long long z = mix(stream->key + ++stream->counter * GOLDEN_GAMMA);
+
+	TRACE_COUNT(TRACE_STREAM_DRAWS, 1);
+	if(b <= a) {
+		return b;
+	}
+
+	return a + (long)(z % (unsigned long long)(b - a + 1));
 }
@@ -5,8 +5,25 @@
 #define MULTIPLIER 16807
 #define MODULUS    2147483647
 
+/*** Macro Definition ***/
+#define RANGE_RANDOMI(s, a, b) ((b) <= (a) ? (b) : (a) + (s) % ((b) - (a) + 1))	/* randomi's value for state s */
+
+/*** Type Definition ***/
+typedef struct random_state {
+	long seed;					/* last number of the congruential sequence */
+} RANDOM;
+
+typedef struct random_stream {
+	unsigned long long key;		/* mix of the seed, node and purpose        */
+	unsigned long long counter;	/* numbers drawn so far                     */
+} RANDOM_STREAM;
+
 /*** Methods Declaration ***/
-void set_randomi(long);		/* initialize constants and seed                                 */
-long randomi(long, long );	/* generate a random integer in the interval [a,b] (b >= a >= 0) */
+void set_randomi(RANDOM*, long);		/* initialize constants and seed                                 */
+long randomi(RANDOM*, long, long );	/* generate a random integer in the interval [a,b] (b >= a >= 0) */
+void fill_randomi(RANDOM*, long*, unsigned long);	/* store the next states of the sequence in bulk */
+void skip_randomi(RANDOM*, unsigned long);	/* jump over numbers of the sequence                      */
+void set_stream(RANDOM_STREAM*, long, unsigned long, int);	/* key a counter-based stream            */
+long streami(RANDOM_STREAM*, long, long);	/* draw from it in the interval [a,b] (b >= a >= 0)      */
 
 #endif /* RANDOM_H */
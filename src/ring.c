@@ -0,0 +1,240 @@
+/*** ring.c - pass blocks of arcs from the generator to writer threads */
+
+/*** The generator and the threads that format and write its arcs meet
+ *** in a bounded ring of blocks, without locks.  Every slot carries a
+ *** sequence number that says whose turn it is (after D. Vyukov's bounded
+ *** queue):
+ ***
+ ***	sequence == position		the slot is free for the block at that
+ ***					position, which the producer fills;
+ ***	sequence == position + 1	it holds that block, which the consumer
+ ***					that wins tail from position takes;
+ ***	sequence == position + slots	it was released, and is free for the
+ ***					block one turn of the ring later.
+ ***
+ *** Only the producer moves head, so publishing is a copy and a release
+ *** store; consumers race for tail with a compare-and-swap.  Consumers
+ *** may release blocks in any order, since each slot waits only for its
+ *** own block.  A side that finds nothing to do polls a few times, then
+ *** yields the processor, then naps, so that waiting costs little when
+ *** the other side is slow.
+ ***
+ *** The consumers format blocks in parallel, but the file wants them in
+ *** order: place_block hands out the offsets of the blocks' text in
+ *** publishing order, each consumer waiting for the block before its own
+ *** to be measured.  Only that sum is serialized; the writes themselves
+ *** go to their offsets in any order.
+ ***/
+
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "ring.h"
+
+/*** Local macros */
+
+#define LOAD(x)			__atomic_load_n(&(x), __ATOMIC_ACQUIRE)
+#define STORE(x, v)		__atomic_store_n(&(x), (v), __ATOMIC_RELEASE)
+#define CLAIM(x, old)	__atomic_compare_exchange_n(&(x), &(old), (old) + 1, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)
+
+/*** Private functions */
+
+static void wait_turn(int*);
+
+
+/*** Allocate a ring of the given number of blocks, each holding up to
+ *** space arcs and text_space bytes of their lines.  Returns zero, or
+ *** EOF if out of memory, the ring then being freed.
+ ***/
+int open_ring(RING* ring, unsigned long slots, ARC space, size_t text_space)
+{
+	BLOCK* block;
+	unsigned long i;
+
+	memset(ring, 0, sizeof(RING));
+	if((ring->blocks = (BLOCK*) calloc((size_t)slots, sizeof(BLOCK))) == NULL) {
+		return EOF;
+	}
+	ring->slots = slots;
+	ring->space = space;
+
+	for(i = 0; i < slots; i++) {
+		block = &ring->blocks[i];
+		block->sequence = i;
+		block->view.from = (NODE*) malloc(space * sizeof(NODE));
+		block->view.to = (NODE*) malloc(space * sizeof(NODE));
+		block->view.u = (CAPACITY*) malloc(space * sizeof(CAPACITY));
+		block->view.c = (COST*) malloc(space * sizeof(COST));
+		block->view.arc_space = space;
+		block->text = (char*) malloc(text_space);
+		if(!block->view.from || !block->view.to || !block->view.u || !block->view.c || !block->text) {
+			free_ring(ring);
+			return EOF;
+		}
+	}
+	return 0;
+}
+
+
+/*** Arc sink: copy the first arcs of the arc arrays into the next slots
+ *** of the ring given as data, as many blocks as they take, once they are
+ *** free, and publish them.  The copy is always 64-bit, whatever the
+ *** context's storage.  Returns zero, or EOF if a consumer has failed.
+ ***/
+int ring_arcs(void* data, NETGEN_CONTEXT* ctx, ARC arcs)
+{
+	RING* ring = (RING*)data;
+	unsigned long position;
+	BLOCK* block;
+	ARC first, count;
+	int spins;
+
+	for(first = 0; first < arcs; first += count) {
+		count = arcs - first < ring->space ? arcs - first : ring->space;
+		position = ring->head;
+		block = &ring->blocks[position % ring->slots];
+		spins = 0;
+		while(LOAD(block->sequence) != position) {
+			if(ring_failed(ring)) {
+				return EOF;
+			}
+			wait_turn(&spins);
+		}
+		if(ring_failed(ring)) {
+			return EOF;
+		}
+
+		copy_arcs(ctx, first, count, block->view.from, block->view.to, block->view.u, block->view.c);
+		block->arcs = count;
+		block->position = position;
+		STORE(block->sequence, position + 1);
+		STORE(ring->head, position + 1);
+	}
+	return 0;
+}
+
+
+/*** Tell the consumers that the producer has published its last block. */
+
+void close_ring(RING* ring)
+{
+	STORE(ring->closed, 1);
+}
+
+
+/*** Take the next published block, waiting for the producer if need be
+ *** and wait is set.  Returns NULL once the ring is closed and every
+ *** block taken, or if none is published yet and wait is not set.
+ ***/
+BLOCK* take_block(RING* ring, int wait)
+{
+	unsigned long position;
+	BLOCK* block;
+	long ahead;
+	int spins = 0;
+
+	for(;;) {
+		position = LOAD(ring->tail);
+		block = &ring->blocks[position % ring->slots];
+		ahead = (long)(LOAD(block->sequence) - (position + 1));
+		if(ahead == 0) {
+			if(CLAIM(ring->tail, position)) {
+				return block;
+			}
+		} else if(ahead < 0) {
+			/* Nothing published there yet: done, or wait for the producer. */
+			if(!wait || (LOAD(ring->closed) && position == LOAD(ring->head))) {
+				return NULL;
+			}
+			wait_turn(&spins);
+		}
+	}
+}
+
+
+/*** Record that a block's text takes length bytes, once every block
+ *** published before it has been placed.  Returns the number of bytes
+ *** of text before the block.
+ ***/
+size_t place_block(RING* ring, BLOCK* block, size_t length)
+{
+	size_t offset;
+	int spins = 0;
+
+	while(LOAD(ring->turn) != block->position) {
+		wait_turn(&spins);
+	}
+	offset = ring->placed;
+	ring->placed = offset + length;
+	STORE(ring->turn, block->position + 1);
+	return offset;
+}
+
+
+/*** Give a block's slot back to the producer. */
+
+void release_block(RING* ring, BLOCK* block)
+{
+	STORE(block->sequence, block->position + ring->slots);
+}
+
+
+/*** Note that a consumer cannot go on: the producer's next block is
+ *** refused, which stops generation.  Consumers still take and place the
+ *** blocks already published, so that none of them waits forever.
+ ***/
+void fail_ring(RING* ring)
+{
+	STORE(ring->failed, 1);
+}
+
+
+/*** Whether a consumer has called fail_ring. */
+
+int ring_failed(RING* ring)
+{
+	return LOAD(ring->failed);
+}
+
+
+/*** Free the blocks of a ring. */
+
+void free_ring(RING* ring)
+{
+	unsigned long i;
+
+	if(ring->blocks != NULL) {
+		for(i = 0; i < ring->slots; i++) {
+			free((void *)ring->blocks[i].view.from);
+			free((void *)ring->blocks[i].view.to);
+			free((void *)ring->blocks[i].view.u);
+			free((void *)ring->blocks[i].view.c);
+			free((void *)ring->blocks[i].text);
+		}
+	}
+	free((void *)ring->blocks);
+	ring->blocks = NULL;
+}
+
+
+/*** Wait a little before polling again: spin at first, then yield the
+ *** processor, then nap.
+ ***/
+static void wait_turn(int* spins)
+{
+	struct timespec nap;
+
+	if(*spins < RING_SPINS) {
+		(*spins)++;
+	} else if(*spins < RING_SPINS + RING_YIELDS) {
+		(*spins)++;
+		sched_yield();
+	} else {
+		nap.tv_sec = 0;
+		nap.tv_nsec = RING_NAP;
+		nanosleep(&nap, NULL);
+	}
+}
@@ -0,0 +1,46 @@
+#ifndef RING_H
+#define RING_H 1
+
+#include <stddef.h>
+
+#include "netgen.h"
+
+/*** Constants Definition ***/
+#define RING_SPINS		64			/* polls of a slot before yielding the processor   */
+#define RING_YIELDS		1024		/* yields before sleeping between polls            */
+#define RING_NAP		50000L		/* nanoseconds slept between polls after that      */
+
+/*** Type Definition ***/
+typedef struct block {				/* a block of arcs on its way to the output        */
+	unsigned long sequence;			/* state of its slot, see ring.c                   */
+	unsigned long position;			/* its place in the stream of blocks               */
+	ARC arcs;						/* arcs it holds                                   */
+	NETGEN_CONTEXT view;			/* the arcs, where ARC_FROM and the others find    */
+									/* them                                            */
+	char* text;						/* their lines, formatted by a consumer            */
+} BLOCK;
+
+typedef struct ring {				/* blocks passed from one producer to consumers    */
+	BLOCK* blocks;
+	unsigned long slots;			/* number of blocks                                */
+	ARC space;						/* arcs each block holds                           */
+	unsigned long head;				/* next position the producer fills                */
+	unsigned long tail;				/* next position a consumer takes                  */
+	unsigned long turn;				/* next position to be placed                      */
+	size_t placed;					/* bytes of the blocks placed so far               */
+	int closed;						/* set once the producer has published its last    */
+	int failed;						/* set if a consumer cannot go on                  */
+} RING;
+
+/*** Methods Declaration ***/
+int open_ring(RING*, unsigned long, ARC, size_t);	/* blocks of arcs, and text space for each */
+int ring_arcs(void*, NETGEN_CONTEXT*, ARC);	/* arc sink publishing a block             */
+void close_ring(RING*);				/* tell consumers no block will follow             */
+BLOCK* take_block(RING*, int);		/* next published block, NULL once none is left    */
+size_t place_block(RING*, BLOCK*, size_t);	/* bytes before a block, in publishing order */
+void release_block(RING*, BLOCK*);	/* give a block back to the producer               */
+void fail_ring(RING*);				/* stop the producer at its next block             */
+int ring_failed(RING*);				/* whether fail_ring was called                    */
+void free_ring(RING*);				/* free the blocks                                 */
+
+#endif /* RING_H */
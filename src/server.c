@@ -0,0 +1,571 @@
+/*** server.c - generate problems on request over a Unix domain socket */
+
+/*** A test farm that needs thousands of small instances pays more for
+ *** starting the generator, answering its prompts and creating files than
+ *** for generating.  run_server stays resident instead, and takes requests
+ *** on a Unix domain socket, one line each:
+ ***
+ ***	FORMAT DELIVERY SEED PROBLEM P1 ... P13
+ ***				generate a problem, where FORMAT is dimacs,
+ ***				binary or packed and DELIVERY is stream or shm;
+ ***	stats			report the latencies seen so far;
+ ***	stop			stop accepting connections, and exit once the
+ ***				open ones are closed.
+ ***
+ *** A problem is answered "ok ARCS BYTES MICROSECONDS", the time being
+ *** what generating and writing took, and the instance follows.  With
+ *** stream, its BYTES bytes come next on the connection.  With shm, the
+ *** line comes with a file descriptor (SCM_RIGHTS) of a sealed memory
+ *** file holding them, which the client maps and closes.  A failure is
+ *** answered "error CODE MESSAGE", CODE being the netgen() error code
+ *** (netgen.h), or SERVER_MALFORMED (-100) for a line that is not a
+ *** request, and the connection stays usable.  A connection may carry
+ *** any number of requests, answered in order.
+ ***
+ *** Each worker thread accepts a connection and serves it to the end,
+ *** with a generator context of its own that is kept from one request to
+ *** the next, so the arrays and index lists of the network are only
+ *** allocated when a problem outgrows them.  Instances are written by
+ *** generate_problem into a memory file, through its /proc/self/fd name,
+ *** in any output mode the server was started with; streamed ones are
+ *** then sent with sendfile, without a copy through user space.
+ ***
+ *** Every request is logged on the standard output as a line of JSON
+ *** with its times: generating and writing, delivering, and in all.  The
+ *** server also keeps a histogram of each, with four buckets per power of
+ *** two microseconds, from which stats estimates percentiles.
+ ***/
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "server.h"
+
+/*** Local constants */
+
+#define DELIVER_STREAM	1			/* instance sent on the connection      */
+#define DELIVER_SHM		2			/* instance sent as a memory file       */
+#define MEMORY_NAME		"netgen"	/* name of the memory files, for /proc  */
+#define REQUEST_STATS	-1			/* request lines that are not problems  */
+#define REQUEST_STOP	-2
+#define STATS_SPACE		1024		/* bytes of a stats reply               */
+
+/*** Internally useful types */
+
+typedef struct server {
+	int listener;					/* the listening socket                 */
+	const OUTPUT_OPTIONS* output;	/* how instances are written            */
+	pthread_mutex_t lock;			/* guards the fields below and the log  */
+	unsigned long requests;			/* problems requested                   */
+	unsigned long failures;			/* of which not delivered               */
+	unsigned long arcs;				/* arcs and bytes delivered             */
+	unsigned long bytes;
+	LATENCY generate;				/* generating and writing               */
+	LATENCY deliver;				/* sending to the client                */
+	LATENCY total;					/* from the request line to the end     */
+} SERVER;
+
+typedef struct server_worker {
+	SERVER* server;
+	NETGEN_CONTEXT* ctx;			/* kept from one request to the next    */
+	int memory;						/* memory file for streamed instances   */
+	pthread_t thread;
+	int started;
+} WORKER;
+
+typedef struct request {
+	int format;						/* OUTPUT_ constant, or REQUEST_        */
+	const char* format_name;
+	int delivery;					/* DELIVER_ constant                    */
+	long seed;
+	long problem;
+	long parms[PROBLEM_PARMS];
+} REQUEST;
+
+
+/*** Private functions */
+
+static void* serve(void*);
+static void serve_connection(WORKER*, int);
+static int parse_request(const char*, const OUTPUT_OPTIONS*, REQUEST*);
+static int serve_problem(WORKER*, int, REQUEST*);
+static int send_all(int, const char*, size_t);
+static int send_memory(int, const char*, size_t, int);
+static void record(SERVER*, REQUEST*, long, unsigned long, unsigned long, unsigned long, unsigned long);
+static void note_latency(LATENCY*, unsigned long);
+static unsigned long percentile(const LATENCY*, double);
+static char* put_latency(char*, const char*, const LATENCY*);
+static unsigned long since(const struct timespec*);
+static void stop_server(int);
+
+/*** Local variables */
+
+static int stopping = -1;			/* listener shut down by stop_server    */
+
+
+/*** Serve requests on a Unix domain socket created at the given path,
+ *** with the given number of worker threads (all online processors if not
+ *** positive), each owning a generator context.  Instances are written
+ *** with the given output options; dimacs requests use their DIMACS mode
+ *** if they name one.  Runs until a stop request, SIGINT or SIGTERM, then
+ *** removes the socket.  Returns zero, or EOF if the server cannot start.
+ ***/
+int run_server(const char* path, int threads, const OUTPUT_OPTIONS* output)
+{
+	struct sockaddr_un address;
+	struct sigaction action;
+	struct stat status;
+	SERVER server;
+	WORKER* workers;
+	int i, started = 0;
+
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	if(strlen(path) >= sizeof(address.sun_path)) {
+		return EOF;
+	}
+	strcpy(address.sun_path, path);
+
+	/* A socket left by an earlier server would make bind fail. */
+	if(stat(path, &status) == 0 && S_ISSOCK(status.st_mode)) {
+		(void)unlink(path);
+	}
+	memset(&server, 0, sizeof(server));
+	server.output = output;
+	if((server.listener = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)) < 0) {
+		return EOF;
+	}
+	if(bind(server.listener, (struct sockaddr*)&address, sizeof(address)) != 0 ||
+	   listen(server.listener, SERVER_BACKLOG) != 0) {
+		close(server.listener);
+		return EOF;
+	}
+
+	/* Clients that hang up must not kill the server; signals stop it. */
+	memset(&action, 0, sizeof(action));
+	action.sa_handler = SIG_IGN;
+	sigaction(SIGPIPE, &action, NULL);
+	stopping = server.listener;
+	action.sa_handler = stop_server;
+	sigaction(SIGINT, &action, NULL);
+	sigaction(SIGTERM, &action, NULL);
+
+	if(threads <= 0) {
+		threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+	}
+	if(threads <= 0) {
+		threads = 1;
+	}
+	if((workers = (WORKER*) calloc((size_t)threads, sizeof(WORKER))) == NULL) {
+		close(server.listener);
+		(void)unlink(path);
+		return EOF;
+	}
+	pthread_mutex_init(&server.lock, NULL);
+	for(i = 0; i < threads; i++) {
+		workers[i].server = &server;
+		workers[i].ctx = make_netgen_context();
+		workers[i].memory = memfd_create(MEMORY_NAME, MFD_CLOEXEC);
+		if(workers[i].ctx != NULL && workers[i].memory >= 0) {
+			workers[i].started = pthread_create(&workers[i].thread, NULL, serve, (void *)&workers[i]) == 0;
+			started += workers[i].started;
+		}
+	}
+	if(started > 0) {
+		fprintf(stderr, "Serving on %s with %d threads.\n", path, started);
+	}
+
+	for(i = 0; i < threads; i++) {
+		if(workers[i].started) {
+			pthread_join(workers[i].thread, NULL);
+		}
+		free_netgen_context(workers[i].ctx);
+		if(workers[i].memory >= 0) {
+			close(workers[i].memory);
+		}
+	}
+	stopping = -1;
+	close(server.listener);
+	(void)unlink(path);
+	pthread_mutex_destroy(&server.lock);
+	free((void *)workers);
+	return started > 0 ? 0 : EOF;
+}
+
+
+/*** Body of a worker thread: serve connections until the listener is
+ *** shut down.
+ ***/
+static void* serve(void* arg)
+{
+	WORKER* worker = (WORKER*)arg;
+	int connection;
+
+	for(;;) {
+		if((connection = accept4(worker->server->listener, NULL, NULL, SOCK_CLOEXEC)) < 0) {
+			if(errno == EINTR || errno == ECONNABORTED) {
+				continue;
+			}
+			break;
+		}
+		serve_connection(worker, connection);
+		close(connection);
+	}
+	return NULL;
+}
+
+
+/*** Answer the requests of a connection until the client closes it. */
+
+static void serve_connection(WORKER* worker, int connection)
+{
+	SERVER* server = worker->server;
+	REQUEST request;
+	char line[SERVER_LINE];
+	char reply[STATS_SPACE];
+	char* p;
+	FILE* fin;
+	int fd;
+
+	if((fd = dup(connection)) < 0 || (fin = fdopen(fd, "r")) == NULL) {
+		if(fd >= 0) {
+			close(fd);
+		}
+		return;
+	}
+
+	while(fgets(line, sizeof(line), fin) != NULL) {
+		if(parse_request(line, server->output, &request) != 0) {
+			p = reply + sprintf(reply, "error %d %s\n", SERVER_MALFORMED, "Malformed request");
+		} else if(request.format == REQUEST_STATS) {
+			pthread_mutex_lock(&server->lock);
+			p = reply + sprintf(reply, "stats {\"requests\":%lu,\"failures\":%lu,\"arcs\":%lu,\"bytes\":%lu",
+			                    server->requests, server->failures, server->arcs, server->bytes);
+			p = put_latency(p, "generate_us", &server->generate);
+			p = put_latency(p, "deliver_us", &server->deliver);
+			p = put_latency(p, "total_us", &server->total);
+			pthread_mutex_unlock(&server->lock);
+			p += sprintf(p, "}\n");
+		} else if(request.format == REQUEST_STOP) {
+			stop_server(0);
+			p = reply + sprintf(reply, "ok\n");
+		} else {
+			if(serve_problem(worker, connection, &request) != 0) {
+				break;
+			}
+			continue;
+		}
+		if(send_all(connection, reply, (size_t)(p - reply)) != 0) {
+			break;
+		}
+	}
+	fclose(fin);
+}
+
+
+/*** Parse a request line.  Returns zero, or EOF if it is malformed. */
+
+static int parse_request(const char* line, const OUTPUT_OPTIONS* output, REQUEST* request)
+{
+	char format[16], delivery[16];
+	int used, i;
+
+	memset(request, 0, sizeof(REQUEST));
+	if(sscanf(line, "%15s", format) != 1) {
+		return EOF;
+	}
+	if(strcmp(format, "stats") == 0 || strcmp(format, "stop") == 0) {
+		request->format = format[1] == 't' && format[2] == 'a' ? REQUEST_STATS : REQUEST_STOP;
+		return 0;
+	}
+
+	if(sscanf(line, "%15s %15s %ld %ld%n", format, delivery, &request->seed, &request->problem, &used) != 4) {
+		return EOF;
+	}
+	for(i = 0; i < PROBLEM_PARMS; i++) {
+		line += used;
+		if(sscanf(line, "%ld%n", &request->parms[i], &used) != 1) {
+			return EOF;
+		}
+	}
+
+	if(strcmp(format, "dimacs") == 0) {
+		/* Any DIMACS mode the server was started with; gzip names its own file. */
+		switch(output->format) {
+			case OUTPUT_MAPPED:
+			case OUTPUT_STREAM:
+			case OUTPUT_SPILL:
+			case OUTPUT_PIPELINE:
+				request->format = output->format;
+				break;
+			default:
+				request->format = OUTPUT_DIMACS;
+				break;
+		}
+		request->format_name = "dimacs";
+	} else if(strcmp(format, "binary") == 0) {
+		request->format = OUTPUT_BINARY;
+		request->format_name = "binary";
+	} else if(strcmp(format, "packed") == 0) {
+		request->format = OUTPUT_PACKED;
+		request->format_name = "packed";
+	} else {
+		return EOF;
+	}
+
+	if(strcmp(delivery, "stream") == 0) {
+		request->delivery = DELIVER_STREAM;
+	} else if(strcmp(delivery, "shm") == 0) {
+		request->delivery = DELIVER_SHM;
+	} else {
+		return EOF;
+	}
+	return 0;
+}
+
+
+/*** Generate a requested problem into a memory file and deliver it.
+ *** Returns zero, or EOF if the connection is lost.
+ ***/
+static int serve_problem(WORKER* worker, int connection, REQUEST* request)
+{
+	SERVER* server = worker->server;
+	OUTPUT_OPTIONS options = *server->output;
+	struct timespec start, delivering;
+	struct stat status;
+	char name[64], reply[128];
+	unsigned long generate;
+	long arcs;
+	off_t offset = 0;
+	ssize_t sent;
+	int fd, length, rc = 0;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	if(request->delivery == DELIVER_SHM) {
+		fd = memfd_create(MEMORY_NAME, MFD_CLOEXEC | MFD_ALLOW_SEALING);
+	} else {
+		fd = worker->memory;
+	}
+	options.format = request->format;
+	options.shards = 0;
+	sprintf(name, "/proc/self/fd/%d", fd);
+
+	if(fd < 0) {
+		arcs = ALLOCATION_FAILURE;
+	} else if((arcs = generate_problem(name, worker->ctx, request->seed, request->problem, request->parms, &options)) >= 0 &&
+	          fstat(fd, &status) != 0) {
+		arcs = OUTPUT_FAILURE;
+	}
+	generate = since(&start);
+	clock_gettime(CLOCK_MONOTONIC, &delivering);
+
+	if(arcs < 0) {
+		length = sprintf(reply, "error %ld %s\n", arcs, error_message(arcs));
+		rc = send_all(connection, reply, (size_t)length);
+	} else {
+		length = sprintf(reply, "ok %ld %lu %lu\n", arcs, (unsigned long)status.st_size, generate);
+		if(request->delivery == DELIVER_SHM) {
+			/* Freeze the instance: the client may trust its size and contents. */
+			(void)fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL);
+			rc = send_memory(connection, reply, (size_t)length, fd);
+		} else if((rc = send_all(connection, reply, (size_t)length)) == 0) {
+			while(offset < status.st_size) {
+				if((sent = sendfile(connection, fd, &offset, (size_t)(status.st_size - offset))) <= 0) {
+					if(sent < 0 && errno == EINTR) {
+						continue;
+					}
+					rc = EOF;
+					break;
+				}
+			}
+		}
+	}
+
+	if(request->delivery == DELIVER_SHM && fd >= 0) {
+		close(fd);
+	}
+	record(server, request, arcs, arcs >= 0 && rc == 0 ? (unsigned long)status.st_size : 0, generate, since(&delivering),
+	       since(&start));
+	return rc;
+}
+
+
+/*** Send a buffer whole.  Returns zero, or EOF if the connection is lost. */
+
+static int send_all(int connection, const char* data, size_t length)
+{
+	ssize_t sent;
+
+	while(length > 0) {
+		if((sent = send(connection, data, length, MSG_NOSIGNAL)) < 0) {
+			if(errno == EINTR) {
+				continue;
+			}
+			return EOF;
+		}
+		data += sent;
+		length -= (size_t)sent;
+	}
+	return 0;
+}
+
+
+/*** Send a reply line with a file descriptor attached.  Returns zero, or
+ *** EOF if the connection is lost.
+ ***/
+static int send_memory(int connection, const char* line, size_t length, int fd)
+{
+	union {
+		struct cmsghdr header;
+		char space[CMSG_SPACE(sizeof(int))];
+	} control;
+	struct cmsghdr* cmsg;
+	struct msghdr message;
+	struct iovec part;
+	ssize_t sent;
+
+	memset(&message, 0, sizeof(message));
+	memset(&control, 0, sizeof(control));
+	part.iov_base = (void *)line;
+	part.iov_len = length;
+	message.msg_iov = &part;
+	message.msg_iovlen = 1;
+	message.msg_control = control.space;
+	message.msg_controllen = sizeof(control.space);
+	cmsg = CMSG_FIRSTHDR(&message);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+	memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+
+	while((sent = sendmsg(connection, &message, MSG_NOSIGNAL)) < 0 && errno == EINTR)
+		;
+	if(sent < 0) {
+		return EOF;
+	}
+	/* The descriptor went with the first byte; send the rest plainly. */
+	return send_all(connection, line + sent, length - (size_t)sent);
+}
+
+
+/*** Add a request to the metrics and log it as a line of JSON. */
+
+static void record(SERVER* server, REQUEST* request, long arcs, unsigned long bytes, unsigned long generate,
+                   unsigned long deliver, unsigned long total)
+{
+	pthread_mutex_lock(&server->lock);
+	server->requests++;
+	if(arcs < 0 || bytes == 0) {
+		server->failures++;
+	} else {
+		server->arcs += (unsigned long)arcs;
+		server->bytes += bytes;
+	}
+	note_latency(&server->generate, generate);
+	note_latency(&server->deliver, deliver);
+	note_latency(&server->total, total);
+
+	printf("{\"problem\":%ld,\"format\":\"%s\",\"delivery\":\"%s\",\"arcs\":%ld,\"bytes\":%lu,"
+	       "\"generate_us\":%lu,\"deliver_us\":%lu,\"total_us\":%lu,\"status\":\"%s\"}\n",
+	       request->problem, request->format_name, request->delivery == DELIVER_SHM ? "shm" : "stream", arcs, bytes,
+	       generate, deliver, total, arcs < 0 ? error_message(arcs) : bytes == 0 ? "not delivered" : "ok");
+	fflush(stdout);
+	pthread_mutex_unlock(&server->lock);
+}
+
+
+/*** Add a latency to a histogram.  Values below four microseconds have a
+ *** bucket each; above, each power of two is split into four buckets.
+ ***/
+static void note_latency(LATENCY* latency, unsigned long us)
+{
+	int e = 0, bucket;
+
+	if(us < 4) {
+		bucket = (int)us;
+	} else {
+		while((us >> e) >= 8) {
+			e++;
+		}
+		bucket = 4 * (e + 1) + (int)((us >> e) & 3);
+	}
+	latency->count++;
+	latency->total += (double)us;
+	if(us > latency->maximum) {
+		latency->maximum = us;
+	}
+	latency->buckets[bucket < LATENCY_BUCKETS ? bucket : LATENCY_BUCKETS - 1]++;
+}
+
+
+/*** Estimate a percentile of a histogram: the upper bound of the bucket
+ *** it falls in, or the largest value seen if that is lower.
+ ***/
+static unsigned long percentile(const LATENCY* latency, double fraction)
+{
+	unsigned long seen = 0, bound;
+	int bucket;
+
+	for(bucket = 0; bucket < LATENCY_BUCKETS; bucket++) {
+		seen += latency->buckets[bucket];
+		if(seen > 0 && (double)seen >= fraction * (double)latency->count) {
+			break;
+		}
+	}
+	if(bucket < 3) {
+		bound = (unsigned long)bucket;
+	} else {
+		/* One below the lower bound of the next bucket. */
+		bound = ((4UL + (unsigned long)((bucket + 1) % 4)) << ((bucket + 1) / 4 - 1)) - 1;
+	}
+	return bound < latency->maximum ? bound : latency->maximum;
+}
+
+
+/*** Append a histogram's count, mean and percentiles to a stats reply,
+ *** as a JSON member.
+ ***/
+static char* put_latency(char* p, const char* name, const LATENCY* latency)
+{
+	return p + sprintf(p, ",\"%s\":{\"mean\":%.0f,\"p50\":%lu,\"p90\":%lu,\"p99\":%lu,\"max\":%lu}", name,
+	                   latency->count > 0 ? latency->total / (double)latency->count : 0.0, percentile(latency, 0.50),
+	                   percentile(latency, 0.90), percentile(latency, 0.99), latency->maximum);
+}
+
+
+/*** Microseconds elapsed since a time of the monotonic clock. */
+
+static unsigned long since(const struct timespec* start)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (unsigned long)((now.tv_sec - start->tv_sec) * 1000000L + (now.tv_nsec - start->tv_nsec) / 1000L);
+}
+
+
+/*** Stop accepting connections: the workers' accept calls fail, and
+ *** each worker ends once its connection is closed.  Also the handler of
+ *** SIGINT and SIGTERM, which is why the listener is in a static variable.
+ ***/
+static void stop_server(int signal)
+{
+	(void)signal;
+	if(stopping >= 0) {
+		shutdown(stopping, SHUT_RDWR);
+	}
+}
@@ -0,0 +1,25 @@
+#ifndef SERVER_H
+#define SERVER_H 1
+
+#include "output.h"
+
+/*** Constants Definition ***/
+#define SERVER_BACKLOG		64		/* connections waiting to be accepted              */
+#define SERVER_LINE			512		/* longest request line                            */
+#define SERVER_MALFORMED	-100	/* error code of a line that is not a request,     */
+									/* apart from netgen()'s                           */
+#define LATENCY_BUCKETS		256		/* buckets of a latency histogram: four per power  */
+									/* of two microseconds                             */
+
+/*** Type Definition ***/
+typedef struct latency {			/* distribution of a latency, in microseconds      */
+	unsigned long count;
+	double total;
+	unsigned long maximum;
+	unsigned long buckets[LATENCY_BUCKETS];
+} LATENCY;
+
+/*** Methods Declaration ***/
+int run_server(const char*, int, const OUTPUT_OPTIONS*);	/* serve requests on a Unix socket until stopped */
+
+#endif /* SERVER_H */
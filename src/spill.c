@@ -0,0 +1,176 @@
+/*** spill.c - keep the arcs of a problem on disk while it is generated */
+
+/*** A problem larger than the memory at hand can still be generated
+ *** once: an arc sink appends each block of arcs to a temporary file, in
+ *** the storage the context uses (compact or not), and the blocks are
+ *** read back in order once the problem is complete, into the context's
+ *** own arc arrays, so that any writer of a block can print them.  Only
+ *** the node arrays, the index lists and one block of arcs stay in
+ *** memory.
+ ***
+ *** Each block is its arc count followed by its FROM, TO, U and C arrays.
+ *** The file is only ever written and then read from start to end, with
+ *** large buffers, so the disk sees sequential transfers.  It is unlinked
+ *** as soon as it is created: nothing is left behind if the generator
+ *** stops, and closing the file frees the space.
+ ***/
+
+#define _FILE_OFFSET_BITS 64
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "spill.h"
+
+/*** Private functions */
+
+static int put_array(SPILL*, const void*, size_t, ARC);
+static int get_array(SPILL*, void*, size_t, ARC);
+
+
+/*** Create an empty spill file in the named directory.  Returns zero, or
+ *** EOF if it cannot be created.
+ ***/
+int open_spill(SPILL* spill, const char* directory)
+{
+	char* name;
+	int fd;
+
+	memset(spill, 0, sizeof(SPILL));
+	if((name = (char*) malloc(strlen(directory) + sizeof(SPILL_TEMPLATE) + 1)) == NULL) {
+		return EOF;
+	}
+	sprintf(name, "%s/%s", directory, SPILL_TEMPLATE);
+	fd = mkstemp(name);
+	if(fd >= 0) {
+		(void)unlink(name);
+	}
+	free((void *)name);
+	if(fd < 0) {
+		return EOF;
+	}
+
+	spill->buffer = (char*) malloc(SPILL_BUFFER);
+	if(spill->buffer == NULL || (spill->file = fdopen(fd, "w+b")) == NULL) {
+		free((void *)spill->buffer);
+		spill->buffer = NULL;
+		close(fd);
+		return EOF;
+	}
+	setvbuf(spill->file, spill->buffer, _IOFBF, SPILL_BUFFER);
+	return 0;
+}
+
+
+/*** Arc sink: append the first arcs of the arc arrays to the spill file
+ *** given as data.  Returns zero, or EOF on a write error.
+ ***/
+int spill_arcs(void* data, NETGEN_CONTEXT* ctx, ARC arcs)
+{
+	SPILL* spill = (SPILL*)data;
+	int rc;
+
+	spill->narrow = ctx->narrow;
+	if(fwrite(&arcs, sizeof(ARC), 1, spill->file) != 1) {
+		return EOF;
+	}
+	if(ctx->narrow) {
+		rc = put_array(spill, ctx->from32, sizeof(COMPACT_NODE), arcs) |
+		     put_array(spill, ctx->to32, sizeof(COMPACT_NODE), arcs) |
+		     put_array(spill, ctx->u32, sizeof(COMPACT_VALUE), arcs) |
+		     put_array(spill, ctx->c32, sizeof(COMPACT_VALUE), arcs);
+	} else {
+		rc = put_array(spill, ctx->from, sizeof(NODE), arcs) |
+		     put_array(spill, ctx->to, sizeof(NODE), arcs) |
+		     put_array(spill, ctx->u, sizeof(CAPACITY), arcs) |
+		     put_array(spill, ctx->c, sizeof(COST), arcs);
+	}
+	if(rc != 0) {
+		return EOF;
+	}
+
+	spill->arcs += arcs;
+	spill->blocks++;
+	return 0;
+}
+
+
+/*** Finish writing the spill file and go back to its start.  Returns
+ *** zero, or EOF if the last blocks cannot be written.
+ ***/
+int rewind_spill(SPILL* spill)
+{
+	if(fflush(spill->file) != 0 || fseeko(spill->file, 0, SEEK_SET) != 0) {
+		return EOF;
+	}
+#ifdef POSIX_FADV_SEQUENTIAL
+	(void)posix_fadvise(fileno(spill->file), 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+	return 0;
+}
+
+
+/*** Read the next block of the spill file into the arc arrays of the
+ *** context that wrote it, which must still have the storage and room
+ *** it had then.  Returns the number of arcs read, zero at the end of the
+ *** file, or EOF if the file is short or does not fit.
+ ***/
+long read_spill(SPILL* spill, NETGEN_CONTEXT* ctx)
+{
+	ARC arcs;
+	int rc;
+
+	if(fread(&arcs, sizeof(ARC), 1, spill->file) != 1) {
+		return feof(spill->file) ? 0 : EOF;
+	}
+	if(arcs > ctx->arc_space || spill->narrow != ctx->narrow) {
+		return EOF;
+	}
+
+	if(ctx->narrow) {
+		rc = get_array(spill, ctx->from32, sizeof(COMPACT_NODE), arcs) |
+		     get_array(spill, ctx->to32, sizeof(COMPACT_NODE), arcs) |
+		     get_array(spill, ctx->u32, sizeof(COMPACT_VALUE), arcs) |
+		     get_array(spill, ctx->c32, sizeof(COMPACT_VALUE), arcs);
+	} else {
+		rc = get_array(spill, ctx->from, sizeof(NODE), arcs) |
+		     get_array(spill, ctx->to, sizeof(NODE), arcs) |
+		     get_array(spill, ctx->u, sizeof(CAPACITY), arcs) |
+		     get_array(spill, ctx->c, sizeof(COST), arcs);
+	}
+	return rc != 0 ? EOF : (long)arcs;
+}
+
+
+/*** Close the spill file, which removes it, and free its buffer. */
+
+void close_spill(SPILL* spill)
+{
+	if(spill->file != NULL) {
+		fclose(spill->file);
+	}
+	free((void *)spill->buffer);
+	spill->file = NULL;
+	spill->buffer = NULL;
+}
+
+
+/*** Write an array of count elements of the given size.  Returns zero,
+ *** or EOF on a write error.
+ ***/
+static int put_array(SPILL* spill, const void* data, size_t size, ARC count)
+{
+	return fwrite(data, size, count, spill->file) == count ? 0 : EOF;
+}
+
+
+/*** Read an array of count elements of the given size.  Returns zero,
+ *** or EOF if the file is short.
+ ***/
+static int get_array(SPILL* spill, void* data, size_t size, ARC count)
+{
+	return fread(data, size, count, spill->file) == count ? 0 : EOF;
+}
@@ -0,0 +1,28 @@
+#ifndef SPILL_H
+#define SPILL_H 1
+
+#include <stdio.h>
+
+#include "netgen.h"
+
+/*** Constants Definition ***/
+#define SPILL_TEMPLATE	"netgen-spill-XXXXXX"	/* name of the file in its directory          */
+#define SPILL_BUFFER	(1 << 22)	/* bytes buffered for each write or read of the file  */
+
+/*** Type Definition ***/
+typedef struct spill {				/* arcs kept on disk while a problem is generated  */
+	FILE* file;						/* unlinked temporary file, read and written       */
+	char* buffer;					/* its stdio buffer, SPILL_BUFFER bytes            */
+	ARC arcs;						/* arcs spilled so far                             */
+	ARC blocks;						/* blocks they came in                             */
+	int narrow;						/* set if spilled from compact storage             */
+} SPILL;
+
+/*** Methods Declaration ***/
+int open_spill(SPILL*, const char*);	/* create the file in a directory             */
+int spill_arcs(void*, NETGEN_CONTEXT*, ARC);	/* arc sink appending a block to the file */
+int rewind_spill(SPILL*);				/* get ready to read the blocks back          */
+long read_spill(SPILL*, NETGEN_CONTEXT*);	/* next block, into the context's arc arrays */
+void close_spill(SPILL*);				/* close the file, which removes it           */
+
+#endif /* SPILL_H */
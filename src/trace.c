@@ -0,0 +1,324 @@
+/*** trace.c - counters and phase timing of the generator */
+
+/*** Every thread that reaches an instrumented point gets its own record,
+ *** so that the hooks take no lock: counters, and the calls, total time
+ *** and self time (less the phases nested in it) of each phase.  The
+ *** coarse phases, which run once or a few times per problem, are also
+ *** kept as trace events; the fine ones (a call of pick_head, say) are
+ *** only summed, as there may be millions of them.  write_trace merges
+ *** the records of all threads into one JSON object, in the format read
+ *** by chrome://tracing and Perfetto, with the summary under "netgen".
+ ***
+ *** Without NETGEN_TRACE the hooks are not called at all and write_trace
+ *** only reports that nothing was recorded.
+ ***/
+
+#include <stdio.h>
+
+#include "trace.h"
+
+#ifdef NETGEN_TRACE
+
+#include <stdlib.h>
+#include <time.h>
+#include <pthread.h>
+
+/*** Local constants */
+#define TRACE_NESTING	16				/* deepest nesting of phases timed        */
+#define TRACE_EVENTS	65536			/* largest number of events kept a thread */
+
+/*** Internally useful types */
+typedef struct trace_event {
+	int phase;
+	unsigned long long start;			/* nanoseconds, monotonic clock */
+	unsigned long long duration;
+} TRACE_EVENT;
+
+typedef struct trace {
+	unsigned long counts[TRACE_COUNTERS];
+	unsigned long calls[TRACE_PHASES];
+	unsigned long long total[TRACE_PHASES];		/* nanoseconds in the phase          */
+	unsigned long long self[TRACE_PHASES];		/* same, less the phases nested in it */
+	int depth;									/* phases entered and not yet left   */
+	int stack[TRACE_NESTING];
+	unsigned long long started[TRACE_NESTING];
+	unsigned long long nested[TRACE_NESTING];	/* time of the phases nested in each */
+	TRACE_EVENT* events;
+	unsigned long event_count;
+	unsigned long event_space;
+	unsigned long dropped;						/* events beyond TRACE_EVENTS        */
+	int thread;
+	struct trace* next;
+} TRACE;
+
+/*** Phase names, and whether they are kept as events */
+static const struct {
+	const char* name;
+	int event;
+} phases[TRACE_PHASES] = {
+	{ "network", 1 },
+	{ "supply", 1 },
+	{ "chains", 1 },
+	{ "sinks", 0 },
+	{ "sort_skeleton", 0 },
+	{ "skeleton_arcs", 0 },
+	{ "assignment", 0 },
+	{ "transshipment_sinks", 0 },
+	{ "pick_head", 0 },
+	{ "rejection_loop", 0 },
+	{ "fast_plan", 1 },
+	{ "fast_arcs", 1 },
+	{ "output", 1 }
+};
+
+static const char* counters[TRACE_COUNTERS] = {
+	"random_draws",
+	"random_skips",
+	"stream_draws",
+	"list_resets",
+	"list_choices",
+	"list_removals",
+	"tree_nodes",
+	"tree_steps",
+	"tree_depth",
+	"rejection_draws"
+};
+
+static __thread TRACE* local;			/* record of the calling thread  */
+static TRACE* traces;					/* records of all threads        */
+static int thread_count;
+static unsigned long long epoch;		/* time of the first record      */
+static pthread_mutex_t trace_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/*** Private functions */
+static unsigned long long now(void);
+static TRACE* current(void);
+
+
+/*** Add to a counter of the calling thread; the tree depth is a maximum. ***/
+void trace_count(int counter, unsigned long n)
+{
+	TRACE* tp = current();
+
+	if(tp == NULL) {
+		return;
+	}
+	if(counter == TRACE_TREE_DEPTH) {
+		if(n > tp->counts[counter]) {
+			tp->counts[counter] = n;
+		}
+		return;
+	}
+	tp->counts[counter] += n;
+}
+
+
+/*** Record a descent of an interval tree through depth levels. ***/
+void trace_descent(unsigned long depth)
+{
+	trace_count(TRACE_TREE_STEPS, depth);
+	trace_count(TRACE_TREE_DEPTH, depth);
+}
+
+
+/*** Enter a phase.  Phases nested deeper than TRACE_NESTING are ignored. ***/
+void trace_begin(int phase)
+{
+	TRACE* tp = current();
+
+	if(tp == NULL) {
+		return;
+	}
+	if(tp->depth < TRACE_NESTING) {
+		tp->stack[tp->depth] = phase;
+		tp->nested[tp->depth] = 0;
+		tp->started[tp->depth] = now();
+	}
+	tp->depth++;
+}
+
+
+/*** Leave the phase entered last. ***/
+void trace_end(int phase)
+{
+	TRACE* tp = current();
+	TRACE_EVENT* events;
+	unsigned long long elapsed;
+	int d;
+
+	if(tp == NULL || tp->depth == 0) {
+		return;
+	}
+	d = --tp->depth;
+	if(d >= TRACE_NESTING || tp->stack[d] != phase) {
+		return;
+	}
+
+	elapsed = now() - tp->started[d];
+	tp->calls[phase]++;
+	tp->total[phase] += elapsed;
+	tp->self[phase] += elapsed - tp->nested[d];
+	if(d > 0) {
+		tp->nested[d - 1] += elapsed;
+	}
+
+	if(!phases[phase].event) {
+		return;
+	}
+	if(tp->event_count == tp->event_space) {
+		if(tp->event_space == TRACE_EVENTS ||
+		   (events = (TRACE_EVENT*) realloc(tp->events, (tp->event_space ? 2 * tp->event_space : 64) * sizeof(TRACE_EVENT))) == NULL) {
+			tp->dropped++;
+			return;
+		}
+		tp->events = events;
+		tp->event_space = tp->event_space ? 2 * tp->event_space : 64;
+	}
+	tp->events[tp->event_count].phase = phase;
+	tp->events[tp->event_count].start = tp->started[d];
+	tp->events[tp->event_count].duration = elapsed;
+	tp->event_count++;
+}
+
+
+int trace_enabled(void)
+{
+	return 1;
+}
+
+
+/*** Save the records of all threads to the named file as one JSON object:
+ *** the phases kept as events under "traceEvents", and the counters and
+ *** phase totals, summed over the threads, under "netgen".  Call it once
+ *** the threads are done.  Returns zero, or EOF if the file cannot be
+ *** written.
+ ***/
+int write_trace(const char* filename)
+{
+	FILE* fout;
+	unsigned long counts[TRACE_COUNTERS] = { 0 };
+	unsigned long calls[TRACE_PHASES] = { 0 };
+	unsigned long long total[TRACE_PHASES] = { 0 };
+	unsigned long long self[TRACE_PHASES] = { 0 };
+	unsigned long dropped = 0;
+	const char* separator = "";
+	TRACE* tp;
+	unsigned long e;
+	int i;
+
+	if((fout = fopen(filename, "w")) == NULL) {
+		return EOF;
+	}
+
+	pthread_mutex_lock(&trace_lock);
+	fprintf(fout, "{\"traceEvents\": [");
+	for(tp = traces; tp; tp = tp->next) {
+		for(e = 0; e < tp->event_count; e++) {
+			fprintf(fout, "%s\n  {\"name\": \"%s\", \"cat\": \"netgen\", \"ph\": \"X\", \"pid\": 1, \"tid\": %d, \"ts\": %.3f, \"dur\": %.3f}",
+				separator, phases[tp->events[e].phase].name, tp->thread,
+				(tp->events[e].start - epoch) / 1e3, tp->events[e].duration / 1e3);
+			separator = ",";
+		}
+		for(i = 0; i < TRACE_COUNTERS; i++) {
+			if(i == TRACE_TREE_DEPTH) {
+				counts[i] = tp->counts[i] > counts[i] ? tp->counts[i] : counts[i];
+			} else {
+				counts[i] += tp->counts[i];
+			}
+		}
+		for(i = 0; i < TRACE_PHASES; i++) {
+			calls[i] += tp->calls[i];
+			total[i] += tp->total[i];
+			self[i] += tp->self[i];
+		}
+		dropped += tp->dropped;
+	}
+
+	fprintf(fout, "\n],\n\"displayTimeUnit\": \"ms\",\n\"netgen\": {\"threads\": %d, \"dropped_events\": %lu,\n  \"counters\": {",
+		thread_count, dropped);
+	for(i = 0; i < TRACE_COUNTERS; i++) {
+		fprintf(fout, "%s\"%s\": %lu", i ? ", " : "", counters[i], counts[i]);
+	}
+	fprintf(fout, "},\n  \"phases\": {");
+	for(i = 0; i < TRACE_PHASES; i++) {
+		fprintf(fout, "%s\n    \"%s\": {\"calls\": %lu, \"seconds\": %.6f, \"self_seconds\": %.6f}",
+			i ? "," : "", phases[i].name, calls[i], total[i] / 1e9, self[i] / 1e9);
+	}
+	fprintf(fout, "\n  }\n}}\n");
+	pthread_mutex_unlock(&trace_lock);
+
+	return fclose(fout) == 0 ? 0 : EOF;
+}
+
+
+/*** Monotonic time in nanoseconds. ***/
+static unsigned long long now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long)ts.tv_sec * 1000000000ULL + (unsigned long long)ts.tv_nsec;
+}
+
+
+/*** The record of the calling thread, made on first use.  NULL if it
+ *** cannot be allocated, in which case the thread is not instrumented.
+ ***/
+static TRACE* current(void)
+{
+	TRACE* tp;
+
+	if(local != NULL) {
+		return local;
+	}
+	if((tp = (TRACE*) calloc(1, sizeof(TRACE))) == NULL) {
+		return NULL;
+	}
+
+	pthread_mutex_lock(&trace_lock);
+	if(traces == NULL) {
+		epoch = now();
+	}
+	tp->thread = thread_count++;
+	tp->next = traces;
+	traces = tp;
+	pthread_mutex_unlock(&trace_lock);
+
+	return local = tp;
+}
+
+#else
+
+void trace_count(int counter, unsigned long n)
+{
+	(void)counter;
+	(void)n;
+}
+
+void trace_descent(unsigned long depth)
+{
+	(void)depth;
+}
+
+void trace_begin(int phase)
+{
+	(void)phase;
+}
+
+void trace_end(int phase)
+{
+	(void)phase;
+}
+
+int trace_enabled(void)
+{
+	return 0;
+}
+
+int write_trace(const char* filename)
+{
+	(void)filename;
+	return EOF;
+}
+
+#endif /* NETGEN_TRACE */
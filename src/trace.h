@@ -0,0 +1,61 @@
+#ifndef TRACE_H
+#define TRACE_H 1
+
+/*** Instrumentation of the generator, compiled in with -DNETGEN_TRACE
+ *** (make TRACE=1).  Without it every macro below expands to nothing.
+ ***/
+
+/*** Constants Definition ***/
+#define TRACE_RANDOM_DRAWS		0		/* numbers drawn by randomi and fill_randomi  */
+#define TRACE_RANDOM_SKIPS		1		/* numbers jumped over by skip_randomi        */
+#define TRACE_STREAM_DRAWS		2		/* numbers drawn by streami                   */
+#define TRACE_LIST_RESETS		3		/* index lists made or reset                  */
+#define TRACE_LIST_CHOICES		4		/* calls of choose_index                      */
+#define TRACE_LIST_REMOVALS		5		/* calls of remove_index                      */
+#define TRACE_TREE_NODES		6		/* interval tree nodes allocated              */
+#define TRACE_TREE_STEPS		7		/* interval tree levels descended             */
+#define TRACE_TREE_DEPTH		8		/* deepest descent of an interval tree        */
+#define TRACE_REJECTION_DRAWS	9		/* limits drawn by pick_head's rejection loop */
+#define TRACE_COUNTERS			10
+
+#define PHASE_NETWORK			0		/* a whole call of netgen()                   */
+#define PHASE_SUPPLY			1		/* supplies spread over the sources           */
+#define PHASE_CHAINS			2		/* transshipment nodes chained to the sources */
+#define PHASE_SINKS				3		/* sinks assigned to the end of the chains    */
+#define PHASE_SORT				4		/* sort_skeleton                              */
+#define PHASE_SKELETON			5		/* skeleton arcs saved, with their rubbish    */
+#define PHASE_ASSIGNMENT		6		/* a source of an assignment problem          */
+#define PHASE_TRANSSHIPMENT		7		/* a transshipment sink                       */
+#define PHASE_PICK_HEAD			8		/* pick_head                                  */
+#define PHASE_REJECTION			9		/* the rejection loop drawing its limit       */
+#define PHASE_FAST_PLAN			10		/* serial plan of the fast mode               */
+#define PHASE_FAST_ARCS			11		/* parallel arcs of the fast mode             */
+#define PHASE_OUTPUT			12		/* a problem written to its file              */
+#define TRACE_PHASES			13
+
+/*** Macro Definition ***/
+#ifdef NETGEN_TRACE
+#define TRACE_COUNT(counter, n)	trace_count((counter), (unsigned long)(n))
+#define TRACE_BEGIN(phase)		trace_begin(phase)
+#define TRACE_END(phase)		trace_end(phase)
+#define TRACE_DESCENT_START		unsigned long trace_depth = 0
+#define TRACE_DESCENT_STEP		(trace_depth++)
+#define TRACE_DESCENT_END		trace_descent(trace_depth)
+#else
+#define TRACE_COUNT(counter, n)
+#define TRACE_BEGIN(phase)
+#define TRACE_END(phase)
+#define TRACE_DESCENT_START
+#define TRACE_DESCENT_STEP
+#define TRACE_DESCENT_END
+#endif /* NETGEN_TRACE */
+
+/*** Methods Declaration ***/
+void trace_count(int, unsigned long);	/* add to a counter of the calling thread     */
+void trace_begin(int);					/* enter a phase in the calling thread        */
+void trace_end(int);					/* leave it                                   */
+void trace_descent(unsigned long);		/* record the depth of a tree descent         */
+int trace_enabled(void);				/* nonzero if compiled with NETGEN_TRACE      */
+int write_trace(const char*);			/* save the summary and trace events as JSON  */
+
+#endif /* TRACE_H */
@@ -0,0 +1,329 @@
+/*** writes.c - positioned writes kept in flight while the caller works on */
+
+/*** A writer thread of the pipelined output formats a block, hands its
+ *** text to the kernel and goes on with the next block.  Where io_uring
+ *** is available, the writes are queued on a small ring of the thread's
+ *** own and complete in the background; the thread only waits when
+ *** WRITES_DEPTH of them are in flight, or at the end.  Elsewhere, or if
+ *** the kernel refuses to set up a ring, each write is made at once with
+ *** pwrite and is done by the time queue_write returns.  The caller sees
+ *** the same interface either way: every queued write is later returned
+ *** by reap_write, with the tag it was given, once its buffer is free.
+ ***
+ *** The ring is set up with the raw system calls, so no library is
+ *** needed.  A write the kernel completes short or with an error is
+ *** finished with pwrite.
+ ***/
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "writes.h"
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define WRITES_URING 1
+#endif
+#endif
+
+#ifdef WRITES_URING
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#endif /* WRITES_URING */
+
+/*** Local constants */
+
+#define PENDING_FREE	0			/* entry unused                         */
+#define PENDING_FLIGHT	1			/* write submitted to the kernel        */
+#define PENDING_DONE	2			/* write finished, not yet reaped       */
+
+/*** Local macros */
+
+#define LOAD(x)			__atomic_load_n(&(x), __ATOMIC_ACQUIRE)
+#define STORE(x, v)		__atomic_store_n(&(x), (v), __ATOMIC_RELEASE)
+
+/*** Private functions */
+
+static int write_fully(int, const char*, size_t, off_t);
+#ifdef WRITES_URING
+static int setup_uring(WRITES*);
+static int submit_uring(WRITES*, int);
+static int complete_uring(WRITES*, int);
+#endif /* WRITES_URING */
+
+
+/*** Get ready to write to a file descriptor, through io_uring if asked
+ *** and available, else with pwrite.
+ ***/
+void open_writes(WRITES* writes, int fd, int uring)
+{
+	memset(writes, 0, sizeof(WRITES));
+	writes->fd = fd;
+	writes->ring_fd = -1;
+#ifdef WRITES_URING
+	if(uring) {
+		writes->uring = setup_uring(writes) == 0;
+	}
+#else
+	(void)uring;
+#endif /* WRITES_URING */
+}
+
+
+/*** Queue the write of length bytes at an offset of the file.  The data
+ *** must stay untouched until reap_write returns the tag.  Fewer than
+ *** WRITES_DEPTH writes may be queued and not reaped.  Returns zero, or
+ *** EOF if no entry is free.
+ ***/
+int queue_write(WRITES* writes, const char* data, size_t length, off_t offset, void* tag)
+{
+	PENDING* pending;
+	int i;
+
+	for(i = 0; i < WRITES_DEPTH && writes->pending[i].state != PENDING_FREE; i++)
+		;
+	if(i == WRITES_DEPTH) {
+		return EOF;
+	}
+	pending = &writes->pending[i];
+	pending->data = data;
+	pending->length = length;
+	pending->offset = offset;
+	pending->tag = tag;
+	writes->queued++;
+
+#ifdef WRITES_URING
+	if(writes->uring && submit_uring(writes, i) == 0) {
+		pending->state = PENDING_FLIGHT;
+		return 0;
+	}
+#endif /* WRITES_URING */
+	if(write_fully(writes->fd, data, length, offset) != 0) {
+		writes->failed = 1;
+	}
+	pending->state = PENDING_DONE;
+	return 0;
+}
+
+
+/*** Return the tag of a queued write that has finished, freeing its
+ *** entry.  If none has and wait is set, wait for one.  Returns NULL if
+ *** none is queued, or none has finished and wait is not set.
+ ***/
+void* reap_write(WRITES* writes, int wait)
+{
+	PENDING* pending;
+	int i;
+
+	if(writes->queued == 0) {
+		return NULL;
+	}
+	for(;;) {
+		for(i = 0; i < WRITES_DEPTH; i++) {
+			pending = &writes->pending[i];
+			if(pending->state == PENDING_DONE) {
+				pending->state = PENDING_FREE;
+				writes->queued--;
+				return pending->tag;
+			}
+		}
+#ifdef WRITES_URING
+		if(writes->uring && complete_uring(writes, wait) > 0) {
+			continue;
+		}
+#endif /* WRITES_URING */
+		return NULL;
+	}
+}
+
+
+/*** Wait for every queued write and release the ring.  The tags of the
+ *** writes not reaped are lost.  Returns zero, or EOF if any write failed.
+ ***/
+int close_writes(WRITES* writes)
+{
+	while(reap_write(writes, 1) != NULL)
+		;
+#ifdef WRITES_URING
+	if(writes->sqes != NULL) {
+		munmap(writes->sqes, writes->sqes_size);
+	}
+	if(writes->cq != NULL && writes->cq != writes->sq) {
+		munmap(writes->cq, writes->cq_size);
+	}
+	if(writes->sq != NULL) {
+		munmap(writes->sq, writes->sq_size);
+	}
+	if(writes->ring_fd >= 0) {
+		close(writes->ring_fd);
+	}
+#endif /* WRITES_URING */
+	writes->sq = writes->cq = writes->sqes = NULL;
+	writes->ring_fd = -1;
+	writes->uring = 0;
+	return writes->failed ? EOF : 0;
+}
+
+
+/*** Write length bytes at an offset, however many calls it takes.
+ *** Returns zero, or EOF on an error.
+ ***/
+static int write_fully(int fd, const char* data, size_t length, off_t offset)
+{
+	ssize_t done;
+
+	while(length > 0) {
+		if((done = pwrite(fd, data, length, offset)) < 0) {
+			if(errno == EINTR) {
+				continue;
+			}
+			return EOF;
+		}
+		data += done;
+		length -= (size_t)done;
+		offset += done;
+	}
+	return 0;
+}
+
+
+#ifdef WRITES_URING
+
+/*** Set up an io_uring instance of WRITES_DEPTH entries and map its
+ *** queues.  Returns zero, or EOF if the kernel does not allow it, the
+ *** queue then being left to pwrite.
+ ***/
+static int setup_uring(WRITES* writes)
+{
+	struct io_uring_params params;
+	char* sq;
+	char* cq;
+	int fd;
+
+	memset(&params, 0, sizeof(params));
+	if((fd = (int)syscall(__NR_io_uring_setup, WRITES_DEPTH, &params)) < 0) {
+		return EOF;
+	}
+	writes->ring_fd = fd;
+
+	writes->sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+	writes->cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+	if(params.features & IORING_FEAT_SINGLE_MMAP) {
+		writes->sq_size = writes->cq_size = writes->sq_size > writes->cq_size ? writes->sq_size : writes->cq_size;
+	}
+	sq = (char*) mmap(NULL, writes->sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+	if(sq == MAP_FAILED) {
+		close(fd);
+		writes->ring_fd = -1;
+		return EOF;
+	}
+	writes->sq = sq;
+	if(params.features & IORING_FEAT_SINGLE_MMAP) {
+		cq = sq;
+	} else if((cq = (char*) mmap(NULL, writes->cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING)) == MAP_FAILED) {
+		close_writes(writes);
+		return EOF;
+	}
+	writes->cq = cq;
+	writes->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+	writes->sqes = mmap(NULL, writes->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+	if(writes->sqes == MAP_FAILED) {
+		writes->sqes = NULL;
+		close_writes(writes);
+		return EOF;
+	}
+
+	writes->sq_tail = (unsigned*)(sq + params.sq_off.tail);
+	writes->sq_mask = (unsigned*)(sq + params.sq_off.ring_mask);
+	writes->sq_array = (unsigned*)(sq + params.sq_off.array);
+	writes->cq_head = (unsigned*)(cq + params.cq_off.head);
+	writes->cq_tail = (unsigned*)(cq + params.cq_off.tail);
+	writes->cq_mask = (unsigned*)(cq + params.cq_off.ring_mask);
+	writes->cqes = cq + params.cq_off.cqes;
+	return 0;
+}
+
+
+/*** Submit the write of a pending entry.  Returns zero, or EOF if the
+ *** kernel refuses it.
+ ***/
+static int submit_uring(WRITES* writes, int entry)
+{
+	PENDING* pending = &writes->pending[entry];
+	struct io_uring_sqe* sqe;
+	unsigned tail = *writes->sq_tail;
+	unsigned index = tail & *writes->sq_mask;
+	long rc;
+
+	sqe = &((struct io_uring_sqe*)writes->sqes)[index];
+	memset(sqe, 0, sizeof(*sqe));
+	sqe->opcode = IORING_OP_WRITE;
+	sqe->fd = writes->fd;
+	sqe->addr = (uint64_t)(uintptr_t)pending->data;
+	sqe->len = (uint32_t)pending->length;
+	sqe->off = (uint64_t)pending->offset;
+	sqe->user_data = (uint64_t)entry;
+	writes->sq_array[index] = index;
+	STORE(*writes->sq_tail, tail + 1);
+
+	do {
+		rc = syscall(__NR_io_uring_enter, writes->ring_fd, 1, 0, 0, NULL, 0);
+	} while(rc < 0 && errno == EINTR);
+	if(rc == 1) {
+		return 0;
+	}
+	/* Not consumed: take the entry back and leave the write to pwrite. */
+	STORE(*writes->sq_tail, tail);
+	return EOF;
+}
+
+
+/*** Collect the completions the kernel has posted, waiting for one if
+ *** asked and none is there, and finish the writes it made short.
+ *** Returns the number of writes completed.
+ ***/
+static int complete_uring(WRITES* writes, int wait)
+{
+	struct io_uring_cqe* cqe;
+	PENDING* pending;
+	unsigned head;
+	int completed = 0;
+	size_t done;
+
+	for(;;) {
+		head = *writes->cq_head;
+		if(head != LOAD(*writes->cq_tail)) {
+			break;
+		}
+		if(!wait || syscall(__NR_io_uring_enter, writes->ring_fd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0) < 0) {
+			if(wait && errno == EINTR) {
+				continue;
+			}
+			return 0;
+		}
+	}
+
+	while(head != LOAD(*writes->cq_tail)) {
+		cqe = &((struct io_uring_cqe*)writes->cqes)[head & *writes->cq_mask];
+		pending = &writes->pending[cqe->user_data];
+		done = cqe->res > 0 ? (size_t)cqe->res : 0;
+		if(done < pending->length &&
+		   write_fully(writes->fd, pending->data + done, pending->length - done, pending->offset + (off_t)done) != 0) {
+			writes->failed = 1;
+		}
+		pending->state = PENDING_DONE;
+		completed++;
+		head++;
+		STORE(*writes->cq_head, head);
+	}
+	return completed;
+}
+
+#endif /* WRITES_URING */
@@ -0,0 +1,48 @@
+#ifndef WRITES_H
+#define WRITES_H 1
+
+#include <stddef.h>
+#include <sys/types.h>
+
+/*** Constants Definition ***/
+#define WRITES_DEPTH	4			/* writes a queue keeps in flight at most          */
+
+/*** Type Definition ***/
+typedef struct pending {			/* a write queued and not yet reaped               */
+	const char* data;
+	size_t length;
+	off_t offset;
+	void* tag;						/* returned by reap_write once it is done          */
+	int state;						/* free, in flight or done, see writes.c           */
+} PENDING;
+
+typedef struct writes {				/* positioned writes to a file, made in the        */
+									/* background where the kernel allows              */
+	int fd;
+	int uring;						/* set if the writes go through io_uring           */
+	int ring_fd;					/* the io_uring instance, if so                    */
+	void* sq;						/* its mapped submission and completion queues     */
+	size_t sq_size;
+	void* cq;
+	size_t cq_size;
+	void* sqes;						/* and submission entries                          */
+	size_t sqes_size;
+	unsigned* sq_tail;
+	unsigned* sq_mask;
+	unsigned* sq_array;
+	unsigned* cq_head;
+	unsigned* cq_tail;
+	unsigned* cq_mask;
+	void* cqes;
+	PENDING pending[WRITES_DEPTH];
+	int queued;						/* writes queued and not yet reaped                */
+	int failed;						/* set if a write could not be made                */
+} WRITES;
+
+/*** Methods Declaration ***/
+void open_writes(WRITES*, int, int);	/* writes to a file, on io_uring if asked and available */
+int queue_write(WRITES*, const char*, size_t, off_t, void*);	/* write bytes at an offset */
+void* reap_write(WRITES*, int);		/* tag of a finished write, waiting if asked       */
+int close_writes(WRITES*);			/* finish every write; EOF if any failed           */
+
+#endif /* WRITES_H */